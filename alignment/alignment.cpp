@@ -20,6 +20,17 @@
 #include "utils/timeutil.h" //for getRealTime()
 #include "utils/progress.h" //for progress_display
 #include "alignmentsummary.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__ && !defined WIN64
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define ALN_CACHE_MMAP
+#endif
 
 #include <Eigen/LU>
 #ifdef USE_BOOST
@@ -74,6 +85,8 @@ Alignment::Alignment()
     seq_type = SEQ_UNKNOWN;
     STATE_UNKNOWN = 126;
     pars_lower_bound = NULL;
+    pattern_index_released = false;
+    seq_states_stride = seq_states_nptn = seq_states_nseq = 0;
 }
 
 string &Alignment::getSeqName(int i) {
@@ -528,41 +541,62 @@ Alignment::Alignment(char *filename, char *sequence_type, InputType &intype, str
     seq_type = SEQ_UNKNOWN;
     STATE_UNKNOWN = 126;
     pars_lower_bound = NULL;
+    pattern_index_released = false;
+    seq_states_stride = seq_states_nptn = seq_states_nseq = 0;
     double readStart = getRealTime();
     cout << "Reading alignment file " << filename << " ... ";
     intype = detectInputFile(filename);
 
-    try {
-        if (intype == IN_NEXUS) {
-            cout << "Nexus format detected" << endl;
-            readNexus(filename);
-        } else if (intype == IN_FASTA) {
-            cout << "Fasta format detected" << endl;
-            readFasta(filename, sequence_type);
-        } else if (intype == IN_PHYLIP) {
-            cout << "Phylip format detected" << endl;
-            if (Params::getInstance().phylip_sequential_format)
-                readPhylipSequential(filename, sequence_type);
+    // the counts format of PoMo depends on the model and is always read from the file
+    string cache_file, cache_key;
+    bool cached = false;
+    if (Params::getInstance().aln_cache && intype != IN_COUNTS && intype != IN_OTHER) {
+        cache_file = string(filename) + ".alncache";
+        cache_key = getAlignmentCacheKey(filename);
+        cached = readAlignmentCache(cache_file, cache_key);
+    }
+
+    if (cached) {
+        cout << "Binary cache " << cache_file << " loaded" << endl;
+    } else {
+        try {
+            if (intype == IN_NEXUS) {
+                cout << "Nexus format detected" << endl;
+                readNexus(filename);
+            } else if (intype == IN_FASTA) {
+                cout << "Fasta format detected" << endl;
+                readFasta(filename, sequence_type);
+            } else if (intype == IN_PHYLIP) {
+                cout << "Phylip format detected" << endl;
+                if (Params::getInstance().phylip_sequential_format)
+                    readPhylipSequential(filename, sequence_type);
+                else
+                    readPhylip(filename, sequence_type);
+            } else if (intype == IN_COUNTS) {
+                cout << "Counts format (PoMo) detected" << endl;
+                readCountsFormat(filename, sequence_type);
+            } else if (intype == IN_CLUSTAL) {
+                cout << "Clustal format detected" << endl;
+                readClustal(filename, sequence_type);
+            } else if (intype == IN_MSF) {
+                cout << "MSF format detected" << endl;
+                readMSF(filename, sequence_type);
+            } else {
+                outError("Unknown sequence format, please use PHYLIP, FASTA, CLUSTAL, MSF, or NEXUS format");
+            }
+        } catch (ios::failure) {
+            outError(ERR_READ_INPUT);
+        } catch (const char *str) {
+            outError(str);
+        } catch (string str) {
+            outError(str);
+        }
+        if (!cache_key.empty()) {
+            if (writeAlignmentCache(cache_file, cache_key))
+                cout << "Alignment cache written to " << cache_file << endl;
             else
-                readPhylip(filename, sequence_type);
-        } else if (intype == IN_COUNTS) {
-            cout << "Counts format (PoMo) detected" << endl;
-            readCountsFormat(filename, sequence_type);
-        } else if (intype == IN_CLUSTAL) {
-            cout << "Clustal format detected" << endl;
-            readClustal(filename, sequence_type);
-        } else if (intype == IN_MSF) {
-            cout << "MSF format detected" << endl;
-            readMSF(filename, sequence_type);
-        } else {
-            outError("Unknown sequence format, please use PHYLIP, FASTA, CLUSTAL, MSF, or NEXUS format");
+                outWarning("Cannot write alignment cache " + cache_file);
         }
-    } catch (ios::failure) {
-        outError(ERR_READ_INPUT);
-    } catch (const char *str) {
-        outError(str);
-    } catch (string str) {
-        outError(str);
     }
     if (verbose_mode >= VB_MED) {
         cout << "Time to read input file was " << (getRealTime() - readStart) << " sec." << endl;
@@ -608,6 +642,8 @@ Alignment::Alignment(NxsDataBlock *data_block, char *sequence_type, string model
     seq_type = SEQ_UNKNOWN;
     STATE_UNKNOWN = 126;
     pars_lower_bound = NULL;
+    pattern_index_released = false;
+    seq_states_stride = seq_states_nptn = seq_states_nseq = 0;
     
     extractDataBlock(data_block);
     if (verbose_mode >= VB_DEBUG)
@@ -733,6 +769,222 @@ int Alignment::readNexus(char *filename) {
     return 1;
 }
 
+/*
+    Binary alignment cache (--aln-cache): ALN_CACHE_MAGIC, cache key (uint32 length + bytes),
+    int32 seq_type, int32 num_states, uint32 STATE_UNKNOWN, uint64 #sequences, #sites and #patterns,
+    the sequence names (uint32 length + bytes), int32 site_pattern of all sites,
+    int32 frequency, flag, num_chars and const_char of all patterns, then the states
+    of all patterns one after another, so that they are copied into the patterns as they are.
+*/
+const char ALN_CACHE_MAGIC[8] = {'I', 'Q', 'A', 'L', 'N', 'C', '0', '1'};
+
+/** number of bytes read at once when hashing the input alignment, a multiple of 8 */
+const size_t ALN_CACHE_HASH_BLOCK = 1 << 20;
+
+string Alignment::getAlignmentCacheKey(char *filename) {
+    // 64-bit FNV-1a over 8-byte words, only the tail of the file byte by byte
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t file_size = 0;
+    vector<char> buffer(ALN_CACHE_HASH_BLOCK);
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in)
+        outError(ERR_READ_INPUT, filename);
+    while (in) {
+        in.read(&buffer[0], buffer.size());
+        size_t len = in.gcount();
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, &buffer[i], sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < len; i++)
+            hash = (hash ^ (unsigned char)buffer[i]) * prime;
+        file_size += len;
+    }
+    ostringstream key;
+    key << "size=" << file_size << " hash=" << hex << hash << dec
+        << " seqtype=" << sequence_type
+        << " sequential=" << Params::getInstance().phylip_sequential_format;
+    return key.str();
+}
+
+/** read a fixed-size value from the binary alignment cache, advancing pos, FALSE if truncated */
+template <class T>
+static bool readCacheValue(const char *data, size_t size, size_t &pos, T &value) {
+    if (pos + sizeof(T) > size)
+        return false;
+    memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+bool Alignment::readAlignmentCache(string cache_file, string &cache_key) {
+    if (!fileExists(cache_file))
+        return false;
+    size_t size;
+    const char *data;
+#ifdef ALN_CACHE_MMAP
+    int fd = open(cache_file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size = st.st_size;
+    void *mem = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+    // the patterns are copied front to back exactly once
+    madvise(mem, size, MADV_SEQUENTIAL);
+    data = (const char*)mem;
+#else
+    string content;
+    try {
+        ifstream in;
+        in.exceptions(ios::failbit | ios::badbit);
+        in.open(cache_file.c_str(), ios::in | ios::binary);
+        in.seekg(0, ios::end);
+        content.resize(in.tellg());
+        in.seekg(0, ios::beg);
+        in.read(&content[0], content.size());
+        in.close();
+    } catch (ios::failure &) {
+        return false;
+    }
+    size = content.size();
+    data = content.data();
+#endif
+    bool success = parseAlignmentCache(data, size, cache_key);
+#ifdef ALN_CACHE_MMAP
+    munmap(mem, size);
+#endif
+    return success;
+}
+
+bool Alignment::parseAlignmentCache(const char *data, size_t size, string &cache_key) {
+    size_t pos = sizeof(ALN_CACHE_MAGIC);
+    if (size < pos || memcmp(data, ALN_CACHE_MAGIC, pos) != 0)
+        return false;
+    uint32_t key_len;
+    if (!readCacheValue(data, size, pos, key_len) || pos + key_len > size ||
+        cache_key.compare(0, string::npos, data + pos, key_len) != 0)
+        return false;
+    pos += key_len;
+    int32_t type, nstates;
+    uint32_t unknown;
+    uint64_t nseq, nsite, nptn;
+    if (!readCacheValue(data, size, pos, type) || !readCacheValue(data, size, pos, nstates) ||
+        !readCacheValue(data, size, pos, unknown) || !readCacheValue(data, size, pos, nseq) ||
+        !readCacheValue(data, size, pos, nsite) || !readCacheValue(data, size, pos, nptn))
+        return false;
+    StrVector names;
+    for (uint64_t seq = 0; seq < nseq; seq++) {
+        uint32_t name_len;
+        if (!readCacheValue(data, size, pos, name_len) || pos + name_len > size)
+            return false;
+        names.push_back(string(data + pos, name_len));
+        pos += name_len;
+    }
+    const size_t PATTERN_INFO_SIZE = 4 * sizeof(int32_t);
+    if (size - pos != nsite * sizeof(int32_t) + nptn * (PATTERN_INFO_SIZE + nseq * sizeof(StateType)))
+        return false;
+    // a cache that does not map every site to a valid pattern is treated as stale
+    IntVector sites(nsite);
+    for (size_t site = 0; site < nsite; site++, pos += sizeof(int32_t)) {
+        int32_t ptn;
+        memcpy(&ptn, data + pos, sizeof(ptn));
+        if (ptn < 0 || (uint64_t)ptn >= nptn)
+            return false;
+        sites[site] = ptn;
+    }
+
+    seq_type = (SeqType)type;
+    if (sequence_type.compare(0, 5, "CODON") == 0 || sequence_type.compare(0, 5, "NT2AA") == 0)
+        initCodon(&sequence_type[5]);
+    num_states = nstates;
+    STATE_UNKNOWN = unknown;
+    seq_names = names;
+    site_pattern.swap(sites);
+    const char *info = data + pos;
+    const char *states = info + nptn * PATTERN_INFO_SIZE;
+    clear();
+    clearSequenceStates();
+    resize(nptn);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        Pattern &pat = at(ptn);
+        int32_t fields[4];
+        memcpy(fields, info + ptn * PATTERN_INFO_SIZE, PATTERN_INFO_SIZE);
+        pat.frequency = fields[0];
+        pat.flag = fields[1];
+        pat.num_chars = fields[2];
+        pat.const_char = fields[3];
+        pat.resize(nseq);
+        memcpy(&pat[0], states + ptn * nseq * sizeof(StateType), nseq * sizeof(StateType));
+    }
+    // as after buildPattern(), the index is only rebuilt if patterns are added later
+    pattern_index.clear();
+    pattern_index_released = true;
+    clearSequenceStates();
+    return true;
+}
+
+bool Alignment::writeAlignmentCache(string cache_file, string &cache_key) {
+    string cache_tmp = cache_file + ".tmp";
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(cache_tmp.c_str(), ios::out | ios::binary);
+        out.write(ALN_CACHE_MAGIC, sizeof(ALN_CACHE_MAGIC));
+        uint32_t key_len = cache_key.length();
+        out.write((char*)&key_len, sizeof(key_len));
+        out.write(cache_key.c_str(), key_len);
+        int32_t type = seq_type, nstates = num_states;
+        uint32_t unknown = STATE_UNKNOWN;
+        uint64_t nseq = getNSeq(), nsite = getNSite(), nptn = getNPattern();
+        out.write((char*)&type, sizeof(type));
+        out.write((char*)&nstates, sizeof(nstates));
+        out.write((char*)&unknown, sizeof(unknown));
+        out.write((char*)&nseq, sizeof(nseq));
+        out.write((char*)&nsite, sizeof(nsite));
+        out.write((char*)&nptn, sizeof(nptn));
+        for (auto name = seq_names.begin(); name != seq_names.end(); name++) {
+            uint32_t name_len = name->length();
+            out.write((char*)&name_len, sizeof(name_len));
+            out.write(name->c_str(), name_len);
+        }
+        for (auto site = site_pattern.begin(); site != site_pattern.end(); site++) {
+            int32_t ptn = *site;
+            out.write((char*)&ptn, sizeof(ptn));
+        }
+        for (iterator pat = begin(); pat != end(); pat++) {
+            int32_t fields[4] = {pat->frequency, pat->flag, pat->num_chars, pat->const_char};
+            out.write((char*)fields, sizeof(fields));
+        }
+        for (iterator pat = begin(); pat != end(); pat++)
+            out.write((char*)&(*pat)[0], nseq * sizeof(StateType));
+        out.close();
+    } catch (ios::failure &) {
+        std::remove(cache_tmp.c_str());
+        return false;
+    }
+    if (std::rename(cache_tmp.c_str(), cache_file.c_str()) != 0) {
+        // rename does not replace an existing file on all platforms
+        if (std::remove(cache_file.c_str()) != 0)
+            return false;
+        if (std::rename(cache_tmp.c_str(), cache_file.c_str()) != 0)
+            return false;
+    }
+    return true;
+}
+
 void Alignment::computeUnknownState() {
     switch (seq_type) {
     case SEQ_DNA: STATE_UNKNOWN = 18; break;
@@ -1105,8 +1357,9 @@ bool Alignment::addPatternLazy(Pattern &pat, int site, int freq, bool& gaps_only
             cout << "Site " << site << " contains only gaps or ambiguous characters" << endl;
         }
     }
-    PatternIntMap::iterator pat_it = pattern_index.find(pat);
+    PatternIntMap::iterator pat_it = getPatternIndex().find(pat);
     if (pat_it == pattern_index.end()) { // not found
+        clearSequenceStates();
         pat.frequency = freq;
         //We don't do computeConst(pat); here, that's why
         //there's a "Lazy" in this member function's name!
@@ -1141,6 +1394,120 @@ void Alignment::updatePatterns(size_t oldPatternCount) {
     }
 }
 
+void Alignment::buildSequenceStates() {
+#ifdef _OPENMP
+#pragma omp critical(seq_states)
+#endif
+    {
+    size_t nptn = size(), nseq = getNSeq();
+    if (seq_states_nptn != nptn || seq_states_nseq != nseq) {
+        clearSequenceStates();
+        // a state must fit into a char, as for the converted sequences of AlignmentSummary
+        bool fits = (nptn > 0 && nseq > 0 && STATE_UNKNOWN <= 127);
+        for (iterator it = begin(); fits && it != end(); it++)
+            for (Pattern::iterator state = it->begin(); state != it->end(); state++)
+                if (*state > 127) {
+                    fits = false;
+                    break;
+                }
+        if (fits) {
+            // rows are padded to whole cache lines
+            seq_states_stride = ((nptn + 63) / 64) * 64;
+            seq_states.resize(nseq * seq_states_stride);
+            // transpose tiles of a cache line of patterns, so that each row is written a line at a time
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+            for (size_t tile = 0; tile < nptn; tile += PATTERN_TILE_SITES) {
+                size_t tile_end = min(tile + PATTERN_TILE_SITES, nptn);
+                for (size_t ptn = tile; ptn < tile_end; ptn++) {
+                    const StateType *pat = at(ptn).data();
+                    for (size_t seq = 0; seq < nseq; seq++)
+                        seq_states[seq * seq_states_stride + ptn] = pat[seq];
+                }
+            }
+            seq_states_nptn = nptn;
+            seq_states_nseq = nseq;
+        }
+    }
+    }
+}
+
+void Alignment::clearSequenceStates() {
+    vector<char>().swap(seq_states);
+    seq_states_stride = seq_states_nptn = seq_states_nseq = 0;
+}
+
+void Alignment::releasePatternIndex() {
+    PatternIntMap().swap(pattern_index);
+    pattern_index_released = true;
+}
+
+PatternIntMap &Alignment::getPatternIndex() {
+    // the flag is always read inside the critical section, a thread that finds it
+    // cleared is then guaranteed to see the complete index built by another thread
+#ifdef _OPENMP
+#pragma omp critical(pattern_index)
+#endif
+    if (pattern_index_released) {
+        pattern_index.clear();
+        for (size_t ptn = 0; ptn < size(); ptn++)
+            pattern_index.insert(make_pair(at(ptn), (int)ptn));
+        pattern_index_released = false;
+    }
+    return pattern_index;
+}
+
+void Alignment::benchmarkPatternStorage(int num_reps) {
+    size_t nptn = size(), nseq = getNSeq();
+    cout << "Benchmarking pattern storage with " << num_reps << " repetitions ("
+        << nseq << " sequences, " << nptn << " patterns, " << getNSite() << " sites)" << endl;
+
+    double start_time = getRealTime();
+    for (int rep = 0; rep < num_reps; rep++) {
+        Alignment boot_aln;
+        boot_aln.createBootstrapAlignment(this);
+    }
+    double bench_time = getRealTime() - start_time;
+    cout << "Bootstrap resampling:    " << bench_time * 1000.0 / num_reps << " ms per replicate" << endl;
+
+    start_time = getRealTime();
+    for (int rep = 0; rep < num_reps; rep++) {
+        clearSequenceStates();
+        buildSequenceStates();
+    }
+    bench_time = getRealTime() - start_time;
+    cout << "Sequence-state matrix:   " << bench_time * 1000.0 / num_reps << " ms per build";
+    if (seq_states.empty())
+        cout << " (not built, states do not fit into a char)";
+    cout << endl;
+
+    // reading all tips in the order of the likelihood kernels, once through the patterns and once through the matrix
+    for (int flat = 0; flat <= 1; flat++) {
+        if (flat && seq_states.empty())
+            break;
+        size_t sum = 0;
+        start_time = getRealTime();
+        for (int rep = 0; rep < num_reps; rep++) {
+            for (size_t seq = 0; seq < nseq; seq++) {
+                const char *states = getSequenceStates(seq);
+                for (size_t ptn = 0; ptn < nptn; ptn++)
+                    sum += flat ? states[ptn] : at(ptn)[seq];
+            }
+        }
+        bench_time = getRealTime() - start_time;
+        cout << (flat ? "Tip states from matrix:  " : "Tip states from patterns:") << " "
+            << bench_time * 1000.0 / num_reps << " ms per pass over all tips (checksum " << sum << ")" << endl;
+    }
+
+    // heap blocks of the patterns include the vector header, the Pattern fields and the malloc header
+    double pattern_mb = (double)nptn * (nseq * sizeof(StateType) + sizeof(Pattern) + 16) / 1048576.0;
+    cout << "Memory of patterns:      " << pattern_mb << " MB" << endl;
+    cout << "Memory of pattern index: " << (pattern_index_released ? 0.0 : pattern_mb) << " MB"
+        << (pattern_index_released ? " (released after loading)" : "") << endl;
+    cout << "Memory of state matrix:  " << (double)nseq * seq_states_stride / 1048576.0 << " MB" << endl;
+}
+
 void Alignment::addConstPatterns(char *freq_const_patterns) {
 	IntVector vec;
 	convert_int_vec(freq_const_patterns, vec);
@@ -1252,6 +1619,7 @@ void Alignment::ungroupSitePattern()
 {
 	vector<Pattern> stored_pat = (*this);
 	clear();
+	clearSequenceStates();
 	for (size_t i = 0; i < getNSite(); ++i) {
 		Pattern pat = stored_pat[getPatternID(i)];
 		pat.frequency = 1;
@@ -1266,6 +1634,7 @@ void Alignment::regroupSitePattern(int groups, IntVector& site_group)
 	vector<Pattern> stored_pat = (*this);
 	IntVector stored_site_pattern = site_pattern;
 	clear();
+	clearSequenceStates();
 	site_pattern.clear();
 	site_pattern.resize(stored_site_pattern.size(), -1);
 	size_t count = 0;
@@ -1838,7 +2207,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     //initStateSpace(seq_type);
     
     // now convert to patterns
-    int site, seq, num_gaps_only = 0;
+    int num_gaps_only = 0;
 
     char char_to_state[NUM_CHAR];
     char AA_to_state[NUM_CHAR];
@@ -1849,74 +2218,44 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     } else
         buildStateMap(char_to_state, seq_type);
 
-    Pattern pat;
-    pat.resize(nseq);
     int step = ((seq_type == SEQ_CODON || nt2aa) ? 3 : 1);
     if (nsite % step != 0)
     	outError("Number of sites is not multiple of 3");
-    site_pattern.resize(nsite/step, -1);
+    int num_sites = nsite/step;
+    site_pattern.resize(num_sites, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     int num_error = 0;
-    
+
+    // blocks are built in rounds of a few per thread, so that at most one round
+    // of block-local patterns is kept besides the patterns of the alignment
+    int num_chunks = (num_sites + PATTERN_CHUNK_SITES - 1) / PATTERN_CHUNK_SITES;
+    int round_size = 1;
+#ifdef _OPENMP
+    round_size = omp_get_max_threads() * 4;
+#endif
+    vector<PatternChunk> chunks(min(round_size, num_chunks));
+
     progress_display progress(nsite, "Constructing alignment", "examined", "site");
-    for (site = 0; site < nsite; site+=step) {
-        for (seq = 0; seq < nseq; seq++) {
-            //char state = convertState(sequences[seq][site], seq_type);
-            char state = char_to_state[(int)(sequences[seq][site])];
-            if (seq_type == SEQ_CODON || nt2aa) {
-            	// special treatment for codon
-            	char state2 = char_to_state[(int)(sequences[seq][site+1])];
-            	char state3 = char_to_state[(int)(sequences[seq][site+2])];
-            	if (state < 4 && state2 < 4 && state3 < 4) {
-//            		state = non_stop_codon[state*16 + state2*4 + state3];
-            		state = state*16 + state2*4 + state3;
-            		if (genetic_code[(int)state] == '*') {
-                        err_str << "Sequence " << seq_names[seq] << " has stop codon " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1 << endl;
-                        num_error++;
-                        state = STATE_UNKNOWN;
-            		} else if (nt2aa) {
-                        state = AA_to_state[(int)genetic_code[(int)state]];
-                    } else {
-                        state = non_stop_codon[(int)state];
-                    }
-            	} else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
-            		state = STATE_INVALID;
-            	} else {
-            		if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
-            			ostringstream warn_str;
-                        warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1;
-                        outWarning(warn_str.str());
-            		}
-            		state = STATE_UNKNOWN;
-            	}
-            }
-            if (state == STATE_INVALID) {
-                if (num_error < 100) {
-                    err_str << "Sequence " << seq_names[seq] << " has invalid character " << sequences[seq][site];
-                    if (seq_type == SEQ_CODON)
-                        err_str << sequences[seq][site+1] << sequences[seq][site+2];
-                    err_str << " at site " << site+1 << endl;
-                } else if (num_error == 100)
-                    err_str << "...many more..." << endl;
-                num_error++;
-            }
-            pat[seq] = state;
+    for (int round = 0; round < num_chunks; round += round_size) {
+        int round_end = min(round + round_size, num_chunks);
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (int chunk = round; chunk < round_end; chunk++) {
+            buildPatternChunk(sequences, chunk*PATTERN_CHUNK_SITES, min((chunk+1)*PATTERN_CHUNK_SITES, num_sites),
+                              step, char_to_state, AA_to_state, nt2aa, chunks[chunk-round]);
         }
-        if (!num_error)
-        {
-            bool gaps_only;
-            addPatternLazy(pat, site/step, 1, gaps_only);
-            num_gaps_only += gaps_only ? 1 : 0;
+        for (int chunk = round; chunk < round_end; chunk++) {
+            mergePatternChunk(chunks[chunk-round], chunk*PATTERN_CHUNK_SITES, err_str, num_error, num_gaps_only);
+            progress += (double)(min((chunk+1)*PATTERN_CHUNK_SITES, num_sites) - chunk*PATTERN_CHUNK_SITES) * step;
         }
-        progress += step;
     }
     progress.done();
     updatePatterns(0);
+    // all patterns are known, so the second copy of them in the index is not needed anymore
+    releasePatternIndex();
     if (num_gaps_only) {
         cout << "WARNING: " << num_gaps_only << " sites contain only gaps or ambiguous characters." << endl;
     }
@@ -1926,6 +2265,131 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     return 1;
 }
 
+void Alignment::buildPatternChunk(StrVector &sequences, int first_site, int last_site, int step,
+                                  char *char_to_state, char *AA_to_state, bool nt2aa, PatternChunk &chunk)
+{
+    size_t nseq = sequences.size();
+    // characters of a tile of sites in column-major order, so that
+    // each site is read contiguously instead of one cache line per sequence
+    vector<char> tile(nseq * PATTERN_TILE_SITES * step);
+    PatternIntMap chunk_index;
+    Pattern pat;
+    pat.resize(nseq);
+    chunk.site_pattern.resize(last_site - first_site);
+
+    for (int tile_site = first_site; tile_site < last_site; tile_site += PATTERN_TILE_SITES) {
+        int tile_end = min(tile_site + PATTERN_TILE_SITES, last_site);
+        int num_cols = (tile_end - tile_site) * step;
+        for (size_t seq = 0; seq < nseq; seq++) {
+            const char *row = sequences[seq].data() + (size_t)tile_site * step;
+            for (int col = 0; col < num_cols; col++)
+                tile[col * nseq + seq] = row[col];
+        }
+        for (int site = tile_site; site < tile_end; site++) {
+            const char *column = &tile[(site - tile_site) * step * nseq];
+            for (size_t seq = 0; seq < nseq; seq++) {
+                char state = char_to_state[(int)(column[seq])];
+                if (step == 3) {
+                    // special treatment for codon
+                    char state2 = char_to_state[(int)(column[nseq + seq])];
+                    char state3 = char_to_state[(int)(column[2*nseq + seq])];
+                    if (state < 4 && state2 < 4 && state3 < 4) {
+                        state = state*16 + state2*4 + state3;
+                        if (genetic_code[(int)state] == '*') {
+                            if (chunk.errors.size() < 100)
+                                chunk.errors.push_back("Sequence " + seq_names[seq] + " has stop codon " +
+                                    column[seq] + column[nseq + seq] + column[2*nseq + seq] +
+                                    " at site " + convertIntToString(site*step+1) + "\n");
+                            chunk.num_error++;
+                            state = STATE_UNKNOWN;
+                        } else if (nt2aa) {
+                            state = AA_to_state[(int)genetic_code[(int)state]];
+                        } else {
+                            state = non_stop_codon[(int)state];
+                        }
+                    } else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
+                        state = STATE_INVALID;
+                    } else {
+                        if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
+                            chunk.warnings.push_back("Sequence " + seq_names[seq] + " has ambiguous character " +
+                                column[seq] + column[nseq + seq] + column[2*nseq + seq] +
+                                " at site " + convertIntToString(site*step+1));
+                        }
+                        state = STATE_UNKNOWN;
+                    }
+                }
+                if (state == STATE_INVALID) {
+                    if (chunk.errors.size() < 100) {
+                        string err = "Sequence " + seq_names[seq] + " has invalid character " + column[seq];
+                        if (seq_type == SEQ_CODON)
+                            err = err + column[nseq + seq] + column[2*nseq + seq];
+                        chunk.errors.push_back(err + " at site " + convertIntToString(site*step+1) + "\n");
+                    }
+                    chunk.num_error++;
+                }
+                pat[seq] = state;
+            }
+            if (chunk.num_error)
+                continue;
+            PatternIntMap::iterator pat_it = chunk_index.find(pat);
+            if (pat_it == chunk_index.end()) {
+                pat.frequency = 1;
+                chunk.patterns.push_back(pat);
+                chunk_index[pat] = chunk.patterns.size()-1;
+                chunk.gaps_only.push_back(pat.computeGapChar(num_states, STATE_UNKNOWN) == nseq);
+                chunk.site_pattern[site - first_site] = chunk.patterns.size()-1;
+            } else {
+                chunk.patterns[pat_it->second].frequency++;
+                chunk.site_pattern[site - first_site] = pat_it->second;
+            }
+        }
+    }
+}
+
+void Alignment::mergePatternChunk(PatternChunk &chunk, int first_site, ostream &err_str,
+                                  int &num_error, int &num_gaps_only)
+{
+    for (auto &warn : chunk.warnings)
+        outWarning(warn);
+    for (int i = 0; i < chunk.num_error; i++, num_error++) {
+        if (num_error < 100) {
+            if (i < chunk.errors.size())
+                err_str << chunk.errors[i];
+        } else if (num_error == 100)
+            err_str << "...many more..." << endl;
+    }
+    if (num_error) {
+        chunk.clear();
+        return;
+    }
+    // patterns new to the alignment are appended in order of first occurrence, as for addPatternLazy()
+    IntVector pattern_ids(chunk.patterns.size());
+    for (size_t i = 0; i < chunk.patterns.size(); i++) {
+        Pattern &pat = chunk.patterns[i];
+        PatternIntMap::iterator pat_it = getPatternIndex().find(pat);
+        if (pat_it == pattern_index.end()) {
+            clearSequenceStates();
+            push_back(pat);
+            pattern_index[back()] = size()-1;
+            pattern_ids[i] = size()-1;
+        } else {
+            at(pat_it->second).frequency += pat.frequency;
+            pattern_ids[i] = pat_it->second;
+        }
+    }
+    for (size_t i = 0; i < chunk.site_pattern.size(); i++) {
+        int ptn = chunk.site_pattern[i];
+        site_pattern[first_site + i] = pattern_ids[ptn];
+        if (chunk.gaps_only[ptn]) {
+            num_gaps_only++;
+            if (verbose_mode >= VB_DEBUG) {
+                cout << "Site " << first_site + i << " contains only gaps or ambiguous characters" << endl;
+            }
+        }
+    }
+    chunk.clear();
+}
+
 void processSeq(string &sequence, string &line, int line_num) {
     for (string::iterator it = line.begin(); it != line.end(); it++) {
         if ((*it) <= ' ') continue;
@@ -1978,6 +2442,9 @@ void Alignment::doReadPhylip(char *filename, char *sequence_type, StrVector &seq
 
             seq_names.resize(nseq, "");
             sequences.resize(nseq, "");
+            // avoid growing the sequences geometrically, which may double their memory
+            for (auto &sequence : sequences)
+                sequence.reserve(nsite);
 
         } else { // read sequence contents
             if (seq_names[seq_id] == "") { // cut out the sequence name
@@ -2059,6 +2526,9 @@ void Alignment::doReadPhylipSequential(char *filename, char *sequence_type, StrV
 
             seq_names.resize(nseq, "");
             sequences.resize(nseq, "");
+            // avoid growing the sequences geometrically, which may double their memory
+            for (auto &sequence : sequences)
+                sequence.reserve(nsite);
 
         } else { // read sequence contents
             if (seq_id >= nseq)
@@ -2127,7 +2597,13 @@ void Alignment::doReadFasta(char *filename, char *sequence_type, StrVector &sequ
                 string::size_type pos = line.find_first_of("\n\r");
                 seq_names.push_back(line.substr(1, pos-1));
                 trimString(seq_names.back());
+                // aligned sequences have the length of the first one, so reserve
+                // it instead of growing them geometrically
+                if (sequences.size() == 1)
+                    sequences.front().shrink_to_fit();
                 sequences.push_back("");
+                if (sequences.size() > 1)
+                    sequences.back().reserve(sequences.front().length());
                 continue;
             }
             // read sequence contents
@@ -3143,6 +3619,7 @@ void Alignment::extractSubAlignment(Alignment *aln, IntVector &seq_id, int min_t
     }
     site_pattern.resize(aln->getNSite(), -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     size_t removed_sites = 0;
     VerboseMode save_mode = verbose_mode;
@@ -3206,6 +3683,7 @@ void Alignment::extractPatterns(Alignment *aln, IntVector &ptn_id) {
     }
     site_pattern.resize(aln->getNSite(), -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     int site = 0;
     VerboseMode save_mode = verbose_mode;
@@ -3246,6 +3724,7 @@ void Alignment::extractPatternFreqs(Alignment *aln, IntVector &ptn_freq) {
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
     site_pattern.resize(accumulate(ptn_freq.begin(), ptn_freq.end(), 0), -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     int site = 0;
     VerboseMode save_mode = verbose_mode;
@@ -3285,6 +3764,7 @@ void Alignment::extractSites(Alignment *aln, IntVector &site_id) {
     }
     site_pattern.resize(site_id.size(), -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     VerboseMode save_mode = verbose_mode;
     verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
@@ -3369,6 +3849,7 @@ void Alignment::convertToCodonOrAA(Alignment *aln, char *gene_code_id, bool nt2a
 
     site_pattern.resize(aln->getNSite()/3, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     int step = ((seq_type == SEQ_CODON || nt2aa) ? 3 : 1);
 
@@ -3657,6 +4138,7 @@ void Alignment::createBootstrapAlignment(Alignment *aln, IntVector* pattern_freq
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
     site_pattern.resize(nsite, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
 
     // 2016-07-05: copy variables for PoMo
@@ -3918,6 +4400,7 @@ void Alignment::buildFromPatternFreq(Alignment & aln, IntVector new_pattern_freq
     site_pattern.resize(nsite, -1);
 
     clear();
+    clearSequenceStates();
     pattern_index.clear();
 
     int site = 0;
@@ -3970,6 +4453,7 @@ void Alignment::createGapMaskedAlignment(Alignment *masked_aln, Alignment *aln)
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
     site_pattern.resize(nsite, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     IntVector name_map;
     for (StrVector::iterator it = seq_names.begin(); it != seq_names.end(); it++) {
@@ -4055,6 +4539,7 @@ void Alignment::copyAlignment(Alignment *aln) {
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
     site_pattern.resize(nsite, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     VerboseMode save_mode = verbose_mode;
     verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
@@ -4139,7 +4624,7 @@ void Alignment::getUnobservedConstPatterns(ASCType ASC_type, vector<Pattern> &un
                 if (!isStopCodon(state)) {
                     Pattern pat;
                     pat.resize(getNSeq(), state);
-                    if (pattern_index.find(pat) == pattern_index.end()) {
+                    if (getPatternIndex().find(pat) == pattern_index.end()) {
                         // constant pattern is unobserved
                         unobserved_ptns.push_back(pat);
                     }
@@ -4213,6 +4698,7 @@ Alignment::~Alignment()
     non_stop_codon = nullptr;
     delete [] pars_lower_bound;
     pars_lower_bound = nullptr;
+    clearSequenceStates();
     for (auto it = site_state_freq.rbegin(); it != site_state_freq.rend(); ++it) {
         delete [] (*it);
     }
@@ -4223,11 +4709,14 @@ Alignment::~Alignment()
 double Alignment::computeObsDist(int seq1, int seq2) {
     int diff_pos = 0, total_pos = 0;
     total_pos = getNSite() - num_variant_sites; // initialize with number of constant sites
+    const char *states1 = getSequenceStates(seq1);
+    const char *states2 = getSequenceStates(seq2);
     for (iterator it = begin(); it != end(); it++) {
         if ((*it).isConst())
             continue;
-        int state1 = convertPomoState((*it)[seq1]);
-        int state2 = convertPomoState((*it)[seq2]);
+        size_t ptn = it - begin();
+        int state1 = convertPomoState(states1 ? states1[ptn] : (*it)[seq1]);
+        int state2 = convertPomoState(states2 ? states2[ptn] : (*it)[seq2]);
         if  (state1 < num_states && state2 < num_states) {
             total_pos += (*it).frequency;
             if (state1 != state2 )
@@ -5448,7 +5937,7 @@ void Alignment::multinomialProb(Alignment refAlign, double &prob)
     double fac = logFac(nsite);
     int index;
     for ( iterator it = begin(); it != end() ; it++) {
-        PatternIntMap::iterator pat_it = refAlign.pattern_index.find((*it));
+        PatternIntMap::iterator pat_it = refAlign.getPatternIndex().find((*it));
         if ( pat_it == refAlign.pattern_index.end() ) //not found ==> error
             outError("Pattern in the current alignment is not found in the reference alignment!");
         sumFac += logFac((*it).frequency);
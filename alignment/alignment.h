@@ -84,6 +84,48 @@ typedef unordered_map<vector<StateType>, int, hashPattern> PatternIntMap;
 typedef map<vector<StateType>, int> PatternIntMap;
 #endif
 
+/** number of sites per block of Alignment::buildPattern(), the unit of work of a thread */
+#define PATTERN_CHUNK_SITES 4096
+
+/** number of sites transposed together into column-major order by Alignment::buildPattern() */
+#define PATTERN_TILE_SITES 64
+
+/**
+    patterns of a block of consecutive sites, built by one thread in Alignment::buildPattern()
+    and then merged into the alignment in site order
+*/
+struct PatternChunk {
+    /** distinct patterns of the block in order of first occurrence, with their frequencies in the block */
+    vector<Pattern> patterns;
+
+    /** TRUE for each pattern containing only gaps or unknown characters */
+    BoolVector gaps_only;
+
+    /** pattern ID within the block of each site */
+    IntVector site_pattern;
+
+    /** number of invalid characters and stop codons */
+    int num_error;
+
+    /** messages of the first errors */
+    StrVector errors;
+
+    /** warnings about ambiguous codons */
+    StrVector warnings;
+
+    PatternChunk() { num_error = 0; }
+
+    /** free all memory */
+    void clear() {
+        vector<Pattern>().swap(patterns);
+        BoolVector().swap(gaps_only);
+        IntVector().swap(site_pattern);
+        num_error = 0;
+        errors.clear();
+        warnings.clear();
+    }
+};
+
 
 constexpr int EXCLUDE_GAP   = 1; // exclude gaps
 constexpr int EXCLUDE_INVAR = 2; // exclude invariant sites
@@ -199,7 +241,76 @@ public:
      */
     int readNexus(char *filename);
 
+    /**
+            key validating the binary alignment cache of an input file (--aln-cache):
+            size and 64-bit hash of the file content, sequence_type and the options that affect reading it
+            @param filename input alignment file
+            @return the key
+     */
+    string getAlignmentCacheKey(char *filename);
+
+    /**
+            load patterns, frequencies, site_pattern and sequence names from the binary
+            alignment cache, which is memory-mapped if supported
+            @param cache_file cache file name
+            @param cache_key key of the input file, see getAlignmentCacheKey()
+            @return TRUE if loaded, FALSE if the cache is missing, of another version or stale
+     */
+    bool readAlignmentCache(string cache_file, string &cache_key);
+
+    /**
+            load the alignment from the content of a binary alignment cache, called by readAlignmentCache()
+            @param data file content
+            @param size file size
+            @param cache_key key of the input file
+            @return TRUE if loaded, FALSE if the content does not match the key or is truncated
+     */
+    bool parseAlignmentCache(const char *data, size_t size, string &cache_key);
+
+    /**
+            write the binary alignment cache of the alignment just read
+            @param cache_file cache file name
+            @param cache_key key of the input file, see getAlignmentCacheKey()
+            @return TRUE if successful, FALSE if an I/O error occurred
+     */
+    bool writeAlignmentCache(string cache_file, string &cache_key);
+
+    /**
+            detect the sequence type and build the site patterns from the sequences.
+            Blocks of PATTERN_CHUNK_SITES sites are converted and compressed into
+            patterns by several threads and then merged in site order, so the result
+            does not depend on the number of threads
+            @param sequences the sequences
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param nseq number of sequences
+            @param nsite number of sites
+            @return 1 on success
+     */
     int buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite);
+
+    /**
+            convert a block of sites into patterns, called by buildPattern()
+            @param sequences the sequences
+            @param first_site first site of the block, counted in codons for codon data
+            @param last_site site after the last one of the block
+            @param step number of characters per site (3 for codons)
+            @param char_to_state map from characters to states
+            @param AA_to_state map from amino acids to states for NT2AA translation
+            @param nt2aa TRUE to translate DNA to amino acids
+            @param[out] chunk patterns of the block
+     */
+    void buildPatternChunk(StrVector &sequences, int first_site, int last_site, int step,
+                           char *char_to_state, char *AA_to_state, bool nt2aa, PatternChunk &chunk);
+
+    /**
+            add the patterns of a block to the alignment and free the block, called by buildPattern()
+            @param chunk patterns of the block
+            @param first_site first site of the block
+            @param err_str error messages
+            @param[in,out] num_error number of errors so far, patterns are not added once it is positive
+            @param[in,out] num_gaps_only number of sites with only gaps so far
+     */
+    void mergePatternChunk(PatternChunk &chunk, int first_site, ostream &err_str, int &num_error, int &num_gaps_only);
     
     /**
             do-read the alignment in PHYLIP format (interleaved)
@@ -313,6 +424,46 @@ public:
     /** lower bound of sum parsimony scores for remaining pattern in ordered_pattern */
     UINT *pars_lower_bound;
 
+    /**
+        build the states of all sequences at all patterns in one aligned matrix with a row per
+        sequence, so that a tip is read contiguously instead of through one heap block per pattern.
+        Nothing is done if the matrix is up to date or some state does not fit into a char.
+        Thread-safe, called whenever partial likelihoods are set up
+    */
+    void buildSequenceStates();
+
+    /**
+        @param seq sequence ID
+        @return states of sequence seq at all patterns, NULL if the matrix is not built
+    */
+    inline const char *getSequenceStates(int seq) const {
+        return ((size_t)seq < seq_states_nseq) ? &seq_states[seq * seq_states_stride] : NULL;
+    }
+
+    /** free the matrix of getSequenceStates(), called whenever patterns are added, removed or replaced */
+    void clearSequenceStates();
+
+    /**
+        free the pattern index, a second copy of all patterns that is only needed
+        while patterns are added. It is rebuilt on demand by getPatternIndex()
+    */
+    void releasePatternIndex();
+
+    /**
+        @return hash map from pattern to index in the vector of patterns, rebuilt if it was released.
+        The rebuild is thread-safe, so worker threads may look up patterns concurrently,
+        but adding patterns through the returned map is not
+    */
+    PatternIntMap &getPatternIndex();
+
+    /**
+        time bootstrap resampling, building the sequence-state matrix and reading all tip
+        states through patterns and through the matrix, print the memory of the pattern storage
+        and exit (--bench-aln)
+        @param num_reps number of repetitions
+    */
+    void benchmarkPatternStorage(int num_reps);
+
     /** order pattern by number of character states and return in ptn_order
         @param pat_type either PAT_INFORMATIVE or 0
     */
@@ -1027,6 +1178,18 @@ protected:
             hash map from pattern to index in the vector of patterns (the alignment)
      */
     PatternIntMap pattern_index;
+
+    /** TRUE if pattern_index was freed by releasePatternIndex() */
+    bool pattern_index_released;
+
+    /** states of all sequences at all patterns, see getSequenceStates(), empty if not built */
+    vector<char> seq_states;
+
+    /** distance between the rows of consecutive sequences in seq_states */
+    size_t seq_states_stride;
+
+    /** number of patterns and sequences seq_states was built for */
+    size_t seq_states_nptn, seq_states_nseq;
     
     /**
             alisim: caching ntfreq if it has already randomly initialized
@@ -170,6 +170,7 @@ void MaAlignment::generateExpectedAlignment(MaAlignment *aln, double &prob)
 	num_states = aln->num_states;
 	site_pattern.resize(nsite, -1);
 	clear();
+	clearSequenceStates();
 	pattern_index.clear();
 	VerboseMode save_mode = verbose_mode; 
 	verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
@@ -226,7 +227,7 @@ void MaAlignment::generateExpectedAlignment(MaAlignment *aln, double &prob)
 	int index;
 	for ( Alignment::iterator objectIt = objectAlign.begin(); objectIt != objectAlign.end() ; objectIt++)
 	{
-		PatternIntMap::iterator pat_it = pattern_index.find((*objectIt));
+		PatternIntMap::iterator pat_it = getPatternIndex().find((*objectIt));
 		if ( pat_it == pattern_index.end() ) //not found ==> error
 			outError("Pattern in the object alignment is not found in the reference alignment!");
 		sumFac += logFac((*objectIt).frequency);
@@ -200,6 +200,7 @@ void SuperAlignment::buildPattern() {
 	STATE_UNKNOWN = 2;
 	site_pattern.resize(nsite, -1);
 	clear();
+	clearSequenceStates();
 	pattern_index.clear();
 	VerboseMode save_mode = verbose_mode; 
 	verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
@@ -1620,10 +1621,12 @@ double SuperAlignment::computeMissingData() {
 }
 
 Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
-	string union_taxa;
 	int nsites = 0, nstates = 0;
+    size_t max_nptn = 0;
     set<int>::iterator it;
 	SeqType sub_type = SEQ_UNKNOWN;
+    // taxa present in at least one of the sub-alignments, in the order of the super-alignment
+    BoolVector union_taxa(getNSeq(), false);
 	for (it = ids.begin(); it != ids.end(); it++) {
 		int id = *it;
 		ASSERT(id >= 0 && id < partitions.size());
@@ -1633,26 +1636,26 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
 			outError("Cannot concatenate sub-alignments of different type");
 		if (nstates != partitions[id]->num_states)
 			outError("Cannot concatenate sub-alignments of different #states");
-
-		string taxa_set;
-        Pattern taxa_pat = getPattern(id);
-        taxa_set.insert(taxa_set.begin(), taxa_pat.begin(), taxa_pat.end());
 		nsites += partitions[id]->getNSite();
-		if (it == ids.begin()) union_taxa = taxa_set; else {
-			for (int j = 0; j < union_taxa.length(); j++)
-				if (taxa_set[j] == 1) union_taxa[j] = 1;
-		}
+        max_nptn += partitions[id]->getNPattern();
+        for (int seq = 0; seq < union_taxa.size(); seq++)
+            if (taxa_index[seq][id] >= 0)
+                union_taxa[seq] = true;
 	}
 
 	Alignment *aln = new Alignment;
-	for (int i = 0; i < union_taxa.length(); i++)
-		if (union_taxa[i] == 1) {
+    IntVector union_seqs;
+	for (int i = 0; i < union_taxa.size(); i++)
+		if (union_taxa[i]) {
 			aln->seq_names.push_back(getSeqName(i));
+            union_seqs.push_back(i);
 		}
 	aln->num_states = nstates;
 	aln->seq_type = sub_type;
 	aln->site_pattern.resize(nsites, -1);
     aln->clear();
+    aln->clearSequenceStates();
+    aln->reserve(max_nptn);
     aln->pattern_index.clear();
     aln->STATE_UNKNOWN = partitions[*ids.begin()]->STATE_UNKNOWN;
     aln->genetic_code = partitions[*ids.begin()]->genetic_code;
@@ -1663,52 +1666,47 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
     	memcpy(aln->non_stop_codon, partitions[*ids.begin()]->non_stop_codon, strlen(aln->genetic_code));
     }
 
+    // Patterns are merged pattern by pattern, not site by site: each pattern of a sub-alignment
+    // is padded with STATE_UNKNOWN for the missing taxa and looked up once, and the sites are
+    // then mapped through the pattern IDs. Padding with STATE_UNKNOWN does not change
+    // constant or informative patterns, so their flags are taken over without computeConst().
+    PatternIntMap &index = aln->getPatternIndex();
+    Pattern pat(union_seqs.size());
+    IntVector part_seqs(union_seqs.size());
     // accumulated site index
     int site = 0;
     for (it = ids.begin(); it != ids.end(); it++) {
     	int id = *it;
-        // 2018-08-23: important bugfix in v1.6: taxa_set has wrong correspondance
-		//string taxa_set;
-        //Pattern taxa_pat = getPattern(id);
-        //taxa_set.insert(taxa_set.begin(), taxa_pat.begin(), taxa_pat.end());
-        
-        // 2021-04-14: build original site to patterns index
-        vector<IntVector> pattern_to_sites;
         Alignment *subaln = partitions[id];
-        pattern_to_sites.resize(subaln->getNPattern());
-        for (int sid = 0; sid < subaln->getNSite(); sid++) {
-            int pid = subaln->site_pattern[sid];
-            pattern_to_sites[pid].push_back(sid+site);
+        for (int seq = 0; seq < union_seqs.size(); seq++)
+            part_seqs[seq] = taxa_index[union_seqs[seq]][id];
+        IntVector ptn_map(subaln->getNPattern());
+        for (Alignment::iterator sub_pat = subaln->begin(); sub_pat != subaln->end(); sub_pat++) {
+            for (int seq = 0; seq < union_seqs.size(); seq++)
+                pat[seq] = (part_seqs[seq] >= 0) ? (*sub_pat)[part_seqs[seq]] : aln->STATE_UNKNOWN;
+            PatternIntMap::iterator pat_it = index.find(pat);
+            int ptnindex;
+            if (pat_it == index.end()) {
+                ptnindex = aln->size();
+                aln->push_back(pat);
+                Pattern &new_pat = aln->back();
+                new_pat.frequency = sub_pat->frequency;
+                new_pat.flag = sub_pat->flag;
+                new_pat.const_char = sub_pat->const_char;
+                new_pat.num_chars = sub_pat->num_chars;
+                index[new_pat] = ptnindex;
+            } else {
+                ptnindex = pat_it->second;
+                aln->at(ptnindex).frequency += sub_pat->frequency;
+            }
+            ptn_map[sub_pat - subaln->begin()] = ptnindex;
         }
-
-        for (Alignment::iterator it = partitions[id]->begin(); it != partitions[id]->end(); it++) {
-    		Pattern pat;
-    		//int part_seq = 0;
-    		for (int seq = 0; seq < union_taxa.size(); seq++)
-    			if (union_taxa[seq] == 1) {
-    				StateType ch = aln->STATE_UNKNOWN;
-                    int seq_part = taxa_index[seq][id];
-                    if (seq_part >= 0)
-                        ch = (*it)[seq_part];
-                    //if (taxa_set[seq] == 1) {
-                    //    ch = (*it)[part_seq++];
-                    //}
-    				pat.push_back(ch);
-    			}
-    		//ASSERT(part_seq == partitions[id]->getNSeq());
-    		aln->addPattern(pat, pattern_to_sites[it - partitions[id]->begin()][0], (*it).frequency);
-    		// IMPORTANT BUG FIX FOLLOW
-    		int ptnindex = aln->pattern_index[pat];
-
-            // 2021-04-14: build original site to patterns index
-            ASSERT((*it).frequency == pattern_to_sites[it - partitions[id]->begin()].size());
-            for (auto sid : pattern_to_sites[it - partitions[id]->begin()])
-                aln->site_pattern[sid] = ptnindex;
-//            for (int j = 0; j < (*it).frequency; j++)
-//                aln->site_pattern[site++] = ptnindex;
-    	}
-        site += partitions[id]->getNSite();
+        for (int sid = 0; sid < subaln->getNSite(); sid++)
+            aln->site_pattern[site + sid] = ptn_map[subaln->site_pattern[sid]];
+        site += subaln->getNSite();
     }
+    // candidates of partition merging are only evaluated, the index is rebuilt if patterns are added
+    aln->releasePatternIndex();
     aln->countConstSite();
 //    aln->buildSeqStates();
 
@@ -92,6 +92,7 @@ void SuperAlignmentUnlinked::buildPattern() {
     STATE_UNKNOWN = 2;
     site_pattern.resize(npart, -1);
     clear();
+    clearSequenceStates();
     pattern_index.clear();
     /*
     VerboseMode save_mode = verbose_mode;
@@ -2622,6 +2622,7 @@ int main(int argc, char *argv[]) {
     time(&start_time);
     cout << "Date and Time: " << ctime(&start_time);
     try{
+    checkpoint->foldJournal();
     delete checkpoint;
     }catch(int err_num){}
 
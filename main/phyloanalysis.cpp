@@ -2388,6 +2388,8 @@ void printFinalSearchInfo(Params &params, IQTree &iqtree, double search_cpu_time
     params.run_time = (getCPUTime() - params.startCPUTime);
     cout << endl;
     cout << "Total number of iterations: " << iqtree.stop_rule.getCurIt() << endl;
+    if (params.lh_mem_save == LM_MEM_SAVE && !iqtree.isSuperTree())
+        iqtree.printMemSaveStats(cout);
 //    cout << "Total number of partial likelihood vector computations: " << iqtree.num_partial_lh_computations << endl;
     cout << "CPU time used for tree search: " << search_cpu_time
             << " sec (" << convert_time(search_cpu_time) << ")" << endl;
@@ -2610,7 +2612,11 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
 
         uint64_t mem_required = iqtree->getMemoryRequired();
 
-        if (mem_required >= total_mem*0.95 && !iqtree->isSuperTree()) {
+        if (params.lh_mmap_dir) {
+            // partial likelihood vectors live in the scratch file, RAM only caches them
+            cout << "NOTE: Partial likelihood vectors are stored in a memory-mapped scratch file in "
+                 << params.lh_mmap_dir << endl;
+        } else if (mem_required >= total_mem*0.95 && !iqtree->isSuperTree()) {
             // switch to memory saving mode
             if (params.lh_mem_save != LM_MEM_SAVE) {
                 params.max_mem_size = (total_mem*0.95)/mem_required;
@@ -2626,7 +2632,7 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
                 mem_required = iqtree->getMemoryRequired();
             }
         }
-        if (mem_required >= total_mem) {
+        if (mem_required >= total_mem && !params.lh_mmap_dir) {
             cerr << "ERROR: Your RAM is below minimum requirement of " << (mem_required / 1073741824.0) << " GB RAM" << endl;
             outError("Memory saving mode cannot work, switch to another computer!!!");
         }
@@ -2663,6 +2669,16 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
 
         iqtree->initializeAllPartialLh();
 
+        if (params.bench_kernels) {
+            iqtree->benchmarkLikelihoodKernels(params.bench_kernel_reps);
+            exit(0);
+        }
+
+        if (params.bench_trees) {
+            iqtree->benchmarkTreeEncoding(params.bench_kernel_reps);
+            exit(0);
+        }
+
         if (iqtree->getRate()->name.find("+I+G") != string::npos) {
             if (params.alpha_invar_file != NULL) { // COMPUTE TREE LIKELIHOOD BASED ON THE INPUT ALPHA AND P_INVAR VALUE
                 computeLoglFromUserInputGAMMAInvar(params, *iqtree);
@@ -4113,7 +4129,13 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint, IQTree *&tree, Ali
         else
             alignment = new SuperAlignment(params);
     } else {
+        double load_start = getRealTime();
         alignment = createAlignment(params.aln_file, params.sequence_type, params.intype, params.model_name);
+        if (params.bench_aln) {
+            cout << "Alignment loaded in " << getRealTime() - load_start << " seconds" << endl;
+            alignment->benchmarkPatternStorage(params.bench_kernel_reps);
+            exit(0);
+        }
 
         if (params.freq_const_patterns) {
             int orig_nsite = alignment->getNSite();
@@ -801,8 +801,10 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
     // Model already specifed, nothing to do here
     if (!empty_model_found && params.model_name.substr(0, 4) != "TEST" && params.model_name.substr(0, 2) != "MF")
         return;
-    if (MPIHelper::getInstance().getNumProcesses() > 1)
-        outError("Please use only 1 MPI process! We are currently working on the MPI parallelization of model selection.");
+    // partitions and partition pairs are distributed over MPI processes, see ModelFinderJobs
+    if (MPIHelper::getInstance().getNumProcesses() > 1 &&
+        (!iqtree.isSuperTree() || params.modelomatic || params.partition_merge == MERGE_KMEANS))
+        outError("Please use only 1 MPI process! Only model selection for partitions and the greedy/rcluster merging are parallelized with MPI.");
     // TODO: check if necessary
     //        if (iqtree.isSuperTree())
     //            ((PhyloSuperTree*) &iqtree)->mapTrees();
@@ -821,6 +823,9 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
     ok_model_file &= model_info.size() > 0;
     if (ok_model_file)
         cout << "NOTE: Restoring information from model checkpoint file " << model_info.getFileName() << endl;
+    // only the master writes the model checkpoint file
+    if (MPIHelper::getInstance().isWorker())
+        model_info.setFileName("");
     
     
     Checkpoint *orig_checkpoint = iqtree.getCheckpoint();
@@ -860,6 +865,17 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
         }
     }
     
+#ifdef _IQTREE_MPI
+    if (MPIHelper::getInstance().getNumProcesses() > 1) {
+        // all processes select models with the initial tree and model information of the master
+        if (MPIHelper::getInstance().isMaster())
+            iqtree.PhyloTree::saveCheckpoint();
+        MPIHelper::getInstance().broadcastCheckpoint(&model_info);
+        if (MPIHelper::getInstance().isWorker())
+            iqtree.PhyloTree::restoreCheckpoint();
+    }
+#endif
+
     // also save initial tree to the original .ckp.gz checkpoint
     //        string initTree = iqtree.getTreeString();
     //        CKP_SAVE(initTree);
@@ -1950,6 +1966,160 @@ void mergePairs(vector<SubsetPair> &dest, vector<SubsetPair> &src) {
             dest.push_back(s);
 }
 
+/**
+    jobs of a ModelFinder loop, distributed over MPI processes: every process takes batches of jobs
+    from a counter at the master, so the master evaluates models as well and faster processes take
+    more batches. Without MPI there is one batch with all jobs.
+ */
+class ModelFinderJobs {
+public:
+
+    /**
+        constructor, collective call with MPI
+        @param num_jobs number of jobs
+        @param batch_size number of jobs taken at once, e.g. the number of threads evaluating them
+     */
+    ModelFinderJobs(int64_t num_jobs, int batch_size) {
+        this->num_jobs = num_jobs;
+        this->batch_size = max(batch_size, 1);
+        next_job = 0;
+        distributed = MPIHelper::getInstance().getNumProcesses() > 1;
+#ifdef _IQTREE_MPI
+        if (distributed)
+            MPIHelper::getInstance().startJobCounter();
+#endif
+    }
+
+    /** destructor, collective call with MPI that waits for all processes to finish their jobs */
+    ~ModelFinderJobs() {
+#ifdef _IQTREE_MPI
+        if (distributed)
+            MPIHelper::getInstance().stopJobCounter();
+#endif
+    }
+
+    /**
+        take the next batch of jobs
+        @param[out] first first job of the batch
+        @param[out] last job after the last job of the batch
+        @return FALSE if all jobs are taken
+     */
+    bool nextBatch(int64_t &first, int64_t &last) {
+#ifdef _IQTREE_MPI
+        if (distributed) {
+            first = MPIHelper::getInstance().takeJobs(batch_size);
+            last = min(first + batch_size, num_jobs);
+            return first < last;
+        }
+#endif
+        first = next_job;
+        last = next_job = num_jobs;
+        return first < last;
+    }
+
+    /** @return TRUE if jobs are distributed, so that results must be merged with syncModelInfo */
+    bool isDistributed() {
+        return distributed;
+    }
+
+protected:
+
+    int64_t num_jobs;
+
+    int64_t batch_size;
+
+    /** next job without MPI */
+    int64_t next_job;
+
+    bool distributed;
+};
+
+/**
+    merge the model information computed by all MPI processes, so that all processes continue
+    with the same model_info
+    @param[in,out] model_info all model information
+    @param[in,out] new_info model information computed by this process, replaced by that of all processes
+ */
+void syncModelInfo(ModelCheckpoint &model_info, ModelCheckpoint &new_info) {
+    if (MPIHelper::getInstance().getNumProcesses() == 1)
+        return;
+#ifdef _IQTREE_MPI
+    MPIHelper::getInstance().gatherCheckpoint(&new_info);
+    MPIHelper::getInstance().broadcastCheckpoint(&new_info);
+    model_info.putSubCheckpoint(&new_info, "");
+    model_info.dump();
+#endif
+}
+
+/**
+    restore the best model of a subset of partitions, computed before or by another MPI process
+    @param set_name name of the subset
+    @param[out] best_model the best model
+    @return TRUE if found, FALSE if the subset was not tested yet
+ */
+bool restoreBestModel(ModelCheckpoint &model_info, string set_name, CandidateModel &best_model) {
+    model_info.startStruct(set_name);
+    bool found = model_info.getBestModel(best_model.subst_name);
+    if (found)
+        best_model.restoreCheckpoint(&model_info);
+    model_info.endStruct();
+    return found;
+}
+
+/**
+    after a distributed loop over partitions, take the best models and trees of all partitions from
+    model_info as if this process had tested every partition
+    @param[out] lhvec, dfvec, lenvec log-likelihood, number of parameters and tree length per partition
+    @param[in,out] lhsum, dfsum sums of log-likelihoods and of numbers of parameters, added to
+ */
+void restorePartitionModels(PhyloSuperTree *in_tree, ModelCheckpoint &model_info,
+    DoubleVector &lhvec, DoubleVector &dfvec, DoubleVector &lenvec, double &lhsum, int &dfsum)
+{
+    for (int i = 0; i < in_tree->size(); i++) {
+        PhyloTree *this_tree = in_tree->at(i);
+        CandidateModel best_model;
+        bool check = restoreBestModel(model_info, this_tree->aln->name, best_model);
+        ASSERT(check);
+        this_tree->aln->model_name = best_model.getName();
+        lhsum += (lhvec[i] = best_model.logl);
+        dfsum += (dfvec[i] = best_model.df);
+        lenvec[i] = best_model.tree_len;
+        // as CandidateModelSet::test() does, load the best tree into the partition tree
+        string best_tree;
+        model_info.startStruct(this_tree->aln->name);
+        if (model_info.getBestTree(best_tree))
+            this_tree->readTreeString(best_tree);
+        model_info.endStruct();
+    }
+}
+
+/**
+    set up the merged subset of a pair of partitions for the greedy merging
+ */
+void initModelPair(PhyloSuperTree *in_tree, vector<set<int> > &gene_sets, SubsetPair &subset_pair, ModelPair &cur_pair) {
+    cur_pair.part1 = subset_pair.first;
+    cur_pair.part2 = subset_pair.second;
+    ASSERT(cur_pair.part1 < cur_pair.part2);
+    cur_pair.merged_set.insert(gene_sets[cur_pair.part1].begin(), gene_sets[cur_pair.part1].end());
+    cur_pair.merged_set.insert(gene_sets[cur_pair.part2].begin(), gene_sets[cur_pair.part2].end());
+    cur_pair.set_name = getSubsetName(in_tree, cur_pair.merged_set);
+}
+
+/**
+    set the best model of a pair of partitions and the score of the partition scheme after merging them
+ */
+void scoreModelPair(CandidateModel &best_model, double lhsum, int dfsum, DoubleVector &lhvec, DoubleVector &dfvec,
+                    size_t ssize, ModelTestCriterion mtc, ModelPair &cur_pair)
+{
+    cur_pair.logl = best_model.logl;
+    cur_pair.df = best_model.df;
+    cur_pair.model_name = best_model.getName();
+    cur_pair.tree_len = best_model.tree_len;
+    double lhnew = lhsum - lhvec[cur_pair.part1] - lhvec[cur_pair.part2] + best_model.logl;
+    int dfnew = dfsum - dfvec[cur_pair.part1] - dfvec[cur_pair.part2] + best_model.df;
+    cur_pair.score = computeInformationScore(lhnew, dfnew, ssize, mtc);
+}
+
 /**
  * select models for all partitions
  * @param[in,out] model_info (IN/OUT) all model information
@@ -1972,6 +2142,8 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
         if (params.partition_type == BRLEN_SCALE)
             dfsum -= 1;
     }
+    // number of branch parameters shared by all partitions
+    int brlen_df = dfsum;
 	size_t  ssize = in_tree->getAlnNSite();
 	int64_t num_model = 0;
     int64_t total_num_model = in_tree->size();
@@ -2022,7 +2194,9 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
         // computation cost is proportional to #sequences, #patterns, and #states
         partitionID.push_back({i, ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states});
     }
-    if (num_threads > 1) {
+    // with MPI, all processes must have the same order of jobs
+    bool distributed = MPIHelper::getInstance().getNumProcesses() > 1;
+    if (num_threads > 1 || distributed) {
         std::sort(partitionID.begin(), partitionID.end(), comparePartition);
     }
     bool parallel_over_partitions = false;
@@ -2034,9 +2208,17 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
     
 #ifdef _OPENMP
     parallel_over_partitions = !params.model_test_and_tree && (in_tree->size() >= num_threads);
+#endif
+    // model information computed by this process, to be merged with other MPI processes
+    ModelCheckpoint new_info;
+    {
+    ModelFinderJobs jobs(in_tree->size(), parallel_over_partitions ? num_threads : 1);
+    int64_t first, last;
+    while (jobs.nextBatch(first, last)) {
+#ifdef _OPENMP
 #pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_over_partitions)
 #endif
-	for (int j = 0; j < in_tree->size(); j++) {
+	for (int64_t j = first; j < last; j++) {
         i = partitionID[j].first;
         PhyloTree *this_tree = in_tree->at(i);
 		// scan through models for this partition, assuming the information occurs consecutively
@@ -2080,9 +2262,20 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             }
             cout << endl;
             replaceModelInfo(this_tree->aln->name, model_info, part_model_info);
+            if (distributed)
+                replaceModelInfo(this_tree->aln->name, new_info, part_model_info);
             model_info.dump();
         }
     }
+    }
+    }
+    if (distributed) {
+        // take the partitions tested by other processes
+        syncModelInfo(model_info, new_info);
+        lhsum = 0.0;
+        dfsum = brlen_df;
+        restorePartitionModels(in_tree, model_info, lhvec, dfvec, lenvec, lhsum, dfsum);
+    }
 
     // in case ModelOMatic change the alignment
     fixPartitions(in_tree);
@@ -2160,23 +2353,22 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             this_aln = in_tree->at(closest_pairs[i].second)->aln;
             closest_pairs[i].distance -= ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
         }
-        if (num_threads > 1) {
+        if (num_threads > 1 || distributed) {
             std::sort(closest_pairs.begin(), closest_pairs.end(), comparePairs);
         }
         size_t num_pairs = closest_pairs.size();
-        
+        new_info.clear();
+        {
+        ModelFinderJobs jobs(num_pairs, params.model_test_and_tree ? 1 : num_threads);
+        int64_t first, last;
+        while (jobs.nextBatch(first, last)) {
 #ifdef _OPENMP
 #pragma omp parallel for private(i) schedule(dynamic) if(!params.model_test_and_tree)
 #endif
-        for (size_t pair = 0; pair < num_pairs; pair++) {
+        for (int64_t pair = first; pair < last; pair++) {
             // information of current partitions pair
             ModelPair cur_pair;
-            cur_pair.part1 = closest_pairs[pair].first;
-            cur_pair.part2 = closest_pairs[pair].second;
-            ASSERT(cur_pair.part1 < cur_pair.part2);
-            cur_pair.merged_set.insert(gene_sets[cur_pair.part1].begin(), gene_sets[cur_pair.part1].end());
-            cur_pair.merged_set.insert(gene_sets[cur_pair.part2].begin(), gene_sets[cur_pair.part2].end());
-            cur_pair.set_name = getSubsetName(in_tree, cur_pair.merged_set);
+            initModelPair(in_tree, gene_sets, closest_pairs[pair], cur_pair);
             double weight1 = getSubsetAlnLength(in_tree, gene_sets[cur_pair.part1]);
             double weight2 = getSubsetAlnLength(in_tree, gene_sets[cur_pair.part2]);
             double sum = 1.0 / (weight1 + weight2);
@@ -2189,12 +2381,7 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
 #endif
             {
                 // if pairs previously examined, reuse the information
-                model_info.startStruct(cur_pair.set_name);
-                if (model_info.getBestModel(best_model.subst_name)) {
-                    best_model.restoreCheckpoint(&model_info);
-                    done_before = true;
-                }
-                model_info.endStruct();
+                done_before = restoreBestModel(model_info, cur_pair.set_name, best_model);
             }
             ModelCheckpoint part_model_info;
             double cur_tree_len = 0.0;
@@ -2224,19 +2411,15 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
                 delete tree;
                 delete aln;
             }
-            cur_pair.logl = best_model.logl;
-            cur_pair.df = best_model.df;
-            cur_pair.model_name = best_model.getName();
-            cur_pair.tree_len = best_model.tree_len;
-            double lhnew = lhsum - lhvec[cur_pair.part1] - lhvec[cur_pair.part2] + best_model.logl;
-            int dfnew = dfsum - dfvec[cur_pair.part1] - dfvec[cur_pair.part2] + best_model.df;
-            cur_pair.score = computeInformationScore(lhnew, dfnew, ssize, params.model_test_criterion);
+            scoreModelPair(best_model, lhsum, dfsum, lhvec, dfvec, ssize, params.model_test_criterion, cur_pair);
 #ifdef _OPENMP
 #pragma omp critical
 #endif
 			{
 				if (!done_before) {
 					replaceModelInfo(cur_pair.set_name, model_info, part_model_info);
+                    if (distributed)
+                        replaceModelInfo(cur_pair.set_name, new_info, part_model_info);
                     model_info.dump();
                     num_model++;
 					cout.width(4);
@@ -2258,6 +2441,23 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
                     better_pairs.insertPair(cur_pair);
 			}
 
+        }
+        }
+        }
+        if (distributed) {
+            // take the pairs tested by other processes, all processes then merge the same pairs
+            syncModelInfo(model_info, new_info);
+            better_pairs.clear();
+            for (size_t pair = 0; pair < num_pairs; pair++) {
+                ModelPair cur_pair;
+                initModelPair(in_tree, gene_sets, closest_pairs[pair], cur_pair);
+                CandidateModel best_model;
+                bool check = restoreBestModel(model_info, cur_pair.set_name, best_model);
+                ASSERT(check);
+                scoreModelPair(best_model, lhsum, dfsum, lhvec, dfvec, ssize, params.model_test_criterion, cur_pair);
+                if (cur_pair.score < inf_score)
+                    better_pairs.insertPair(cur_pair);
+            }
         }
 		if (better_pairs.empty()) break;
         ModelPairSet compatible_pairs;
@@ -2344,15 +2544,22 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             partitionID.push_back({i, ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states});
         }
         
-        if (num_threads > 1) {
+        if (num_threads > 1 || distributed) {
             std::sort(partitionID.begin(), partitionID.end(), comparePartition);
         }
 
     #ifdef _OPENMP
         parallel_over_partitions = !params.model_test_and_tree && (in_tree->size() >= num_threads);
+    #endif
+        new_info.clear();
+        {
+        ModelFinderJobs jobs(in_tree->size(), parallel_over_partitions ? num_threads : 1);
+        int64_t first, last;
+        while (jobs.nextBatch(first, last)) {
+    #ifdef _OPENMP
         #pragma omp parallel for private(i) schedule(dynamic) reduction(+: lhsum, dfsum) if(parallel_over_partitions)
     #endif
-        for (int j = 0; j < in_tree->size(); j++) {
+        for (int64_t j = first; j < last; j++) {
             i = partitionID[j].first;
             PhyloTree *this_tree = in_tree->at(i);
             // scan through models for this partition, assuming the information occurs consecutively
@@ -2394,9 +2601,19 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             }
             cout << endl;
             replaceModelInfo(this_tree->aln->name, model_info, part_model_info);
+            if (distributed)
+                replaceModelInfo(this_tree->aln->name, new_info, part_model_info);
             model_info.dump();
             }
         }
+        }
+        }
+        if (distributed) {
+            syncModelInfo(model_info, new_info);
+            lhsum = 0.0;
+            dfsum = brlen_df;
+            restorePartitionModels(in_tree, model_info, lhvec, dfvec, lenvec, lhsum, dfsum);
+        }
     }
 
     inf_score = computeInformationScore(lhsum, dfsum, ssize, params.model_test_criterion);
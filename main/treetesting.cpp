@@ -15,9 +15,13 @@
 #include "treetesting.h"
 #include "tree/phylotree.h"
 #include "tree/phylosupertree.h"
+#include "tree/replicateweights.h"
 #include "tree/iqtreemix.h"
 #include "gsl/mygsl.h"
 #include "utils/timeutil.h"
+#include "utils/patternlhmatrix.h"
+#include <mutex>
+#include <condition_variable>
 
 
 void printSiteLh(const char*filename, PhyloTree *tree, double *ptn_lh,
@@ -781,21 +785,181 @@ int mlecoef(double *cnts, double *rr, double bb, int kk,
 
 /* END CODE WAS TAKEN FROM CONSEL PROGRAM */
 
+/** number of scales of the multiscale bootstrap in the AU test */
+const size_t AU_NUM_SCALES = 10;
+
+/** scale factors (replicate length relative to alignment length) of the multiscale bootstrap */
+const double AU_SCALES[AU_NUM_SCALES] = {0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2, 1.3, 1.4};
+
+/**
+ @param[out] r scale factors
+ @param[out] rr square roots of the scale factors
+ @param[out] rr_inv square roots of the inverse scale factors
+ */
+static void getAUScales(double *r, double *rr, double *rr_inv) {
+    for (size_t k = 0; k < AU_NUM_SCALES; k++) {
+        r[k] = AU_SCALES[k];
+        rr[k] = sqrt(r[k]);
+        rr_inv[k] = sqrt(1/r[k]);
+    }
+}
+
+/**
+ fit the multiscale bootstrap probabilities of one tree and compute its AU p-value
+ @param tid tree ID, only for printing
+ @param this_stat sorted statistics of the tree, nscales x nboot
+ @param r scale factors
+ @param rr square roots of the scale factors
+ @param rr_inv square roots of the inverse scale factors
+ @param[out] info test results of the tree
+ */
+static void fitAUTest(size_t tid, double *this_stat, size_t nscales, size_t nboot,
+                      double *r, double *rr, double *rr_inv, TreeInfo &info) {
+    double *cc = new double[nscales];
+    double *w = new double[nscales];
+    double *this_bp = new double[nscales];
+    size_t k;
+    double xn = this_stat[(nscales/2)*nboot + nboot/2], x;
+    double c, d; // c, d in original paper
+    int idf0 = -2;
+    double z = 0.0, z0 = 0.0, thp = 0.0, th = 0.0, ze = 0.0, ze0 = 0.0;
+    double pval, se;
+    int df;
+    double rss = 0.0;
+    int step;
+    const int max_step = 30;
+    bool failed = false;
+    for (step = 0; step < max_step; step++) {
+        x = xn;
+        int num_k = 0;
+        for (k = 0; k < nscales; k++) {
+            this_bp[k] = cntdist3(this_stat + k*nboot, nboot, x) / nboot;
+            if (this_bp[k] <= 0 || this_bp[k] >= 1) {
+                cc[k] = w[k] = 0.0;
+            } else {
+                double bp_val = this_bp[k];
+                cc[k] = -gsl_cdf_ugaussian_Pinv(bp_val);
+                double bp_pdf = gsl_ran_ugaussian_pdf(cc[k]);
+                w[k] = bp_pdf*bp_pdf*nboot / (bp_val*(1.0-bp_val));
+                num_k++;
+            }
+        }
+        df = num_k-2;
+        if (num_k >= 2) {
+            // first obtain d and c by weighted least square
+            doWeightedLeastSquare(nscales, w, rr, rr_inv, cc, d, c, se);
+            
+            // maximum likelhood fit
+            double coef0[2] = {d, c};
+            int mlefail = mlecoef(this_bp, r, nboot, nscales, coef0, &rss, &df, &se);
+            
+            if (!mlefail) {
+                d = coef0[0];
+                c = coef0[1];
+            }
+            
+            se = gsl_ran_ugaussian_pdf(d-c)*sqrt(se);
+            
+            // second, perform MLE estimate of d and c
+            //            OptimizationAUTest mle(d, c, nscales, this_bp, rr, rr_inv);
+            //            mle.optimizeDC();
+            //            d = mle.d;
+            //            c = mle.c;
+            
+            /* STEP 4: compute p-value according to Eq. 11 */
+            pval = gsl_cdf_ugaussian_Q(d-c);
+            z = -pval;
+            ze = se;
+            // compute sum of squared difference
+            rss = 0.0;
+            for (k = 0; k < nscales; k++) {
+                double diff = cc[k] - (rr[k]*d + rr_inv[k]*c);
+                rss += w[k] * diff * diff;
+            }
+            
+        } else {
+            // not enough data for WLS
+            int num0 = 0;
+            for (k = 0; k < nscales; k++)
+                if (this_bp[k] <= 0.0) num0++;
+            if (num0 > nscales/2)
+                pval = 0.0;
+            else
+                pval = 1.0;
+            se = 0.0;
+            d = c = 0.0;
+            rss = 0.0;
+            if (verbose_mode >= VB_MED)
+                cout << "   error in wls" << endl;
+            //info.au_pvalue = pval;
+            //break;
+        }
+        
+        
+        if (verbose_mode >= VB_MED) {
+            cout.unsetf(ios::fixed);
+            cout << "\t" << step << "\t" << th << "\t" << x << "\t" << pval << "\t" << se << "\t" << nscales-2 << "\t" << d << "\t" << c << "\t" << z << "\t" << ze << "\t" << rss << endl;
+        }
+        
+        if(df < 0 && idf0 < 0) { failed = true; break;} /* degenerated */
+        
+        if ((df < 0) || (idf0 >= 0 && (z-z0)*(x-thp) > 0.0 && fabs(z-z0)>0.1*ze0)) {
+            if (verbose_mode >= VB_MED)
+                cout << "   non-monotone" << endl;
+            th=x;
+            xn=0.5*x+0.5*thp;
+            continue;
+        }
+        if(idf0 >= 0 && (fabs(z-z0)<0.01*ze0)) {
+            if(fabs(th)<1e-10)
+                xn=th;
+            else th=x;
+        } else
+            xn=0.5*th+0.5*x;
+        info.au_pvalue = pval;
+        thp=x;
+        z0=z;
+        ze0=ze;
+        idf0 = df;
+        if(fabs(x-th)<1e-10) break;
+    } // for step
+    
+    if (failed && verbose_mode >= VB_MED)
+        cout << "   degenerated" << endl;
+    
+    if (step == max_step) {
+        if (verbose_mode >= VB_MED)
+            cout << "   non-convergence" << endl;
+        failed = true;
+    }
+    
+    double pchi2 = (failed) ? 0.0 : computePValueChiSquare(rss, df);
+    cout << tid+1 << "\t" << info.au_pvalue << "\t" << rss << "\t" << d << "\t" << c;
+    
+    // warning if p-value of chi-square < 0.01 (rss too high)
+    if (pchi2 < 0.01)
+        cout << " !!!";
+    cout << endl;
+    
+    delete [] this_bp;
+    delete [] w;
+    delete [] cc;
+}
+
 /**
  @param tree_lhs RELL score matrix of size #trees x #replicates
+ @param resampler resampling engine, shared with the other tests
  */
-void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<TreeInfo> &info) {
+void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<TreeInfo> &info,
+                   BootstrapResampler &resampler) {
     
     if (params.topotest_replicates < 10000)
         outWarning("Too few replicates for AU test. At least -zb 10000 for reliable results!");
     
     /* STEP 1: specify scale factors */
-    size_t nscales = 10;
-    double r[] = {0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2, 1.3, 1.4};
-    double rr[] = {sqrt(0.5), sqrt(0.6), sqrt(0.7), sqrt(0.8), sqrt(0.9), 1.0,
-        sqrt(1.1), sqrt(1.2), sqrt(1.3), sqrt(1.4)};
-    double rr_inv[] = {sqrt(1/0.5), sqrt(1/0.6), sqrt(1/0.7), sqrt(1/0.8), sqrt(1/0.9), 1.0,
-        sqrt(1/1.1), sqrt(1/1.2), sqrt(1/1.3), sqrt(1/1.4)};
+    size_t nscales = AU_NUM_SCALES;
+    double r[AU_NUM_SCALES], rr[AU_NUM_SCALES], rr_inv[AU_NUM_SCALES];
+    getAUScales(r, rr, rr_inv);
     
     /* STEP 2: compute bootstrap proportion */
     size_t ntrees = info.size();
@@ -814,89 +978,60 @@ void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<
     if (!treelhs)
         outError("Not enough memory to perform AU test!");
     
-    size_t k, tid, ptn;
+    size_t k, tid;
     
     double start_time = getRealTime();
     
     cout << "Generating " << nscales << " x " << nboot << " multiscale bootstrap replicates... ";
     
+    for (k = 0; k < nscales; ++k) {
+        ReplicateWeights &boot_samples = resampler.getScaledReplicates(r[k]);
+        double *scale_lhs = treelhs + k*nboot;
+        
+        // all trees against a block of replicates in one pass of the RELL kernel
 #ifdef _OPENMP
-#pragma omp parallel private(k, tid, ptn)
-    {
-    int *rstream;
-    init_random(params.ran_seed + omp_get_thread_num(), false, &rstream);
-#else
-    int *rstream = randstream;
-#endif
-    size_t boot;
-    int *boot_sample = aligned_alloc<int>(maxnptn);
-    memset(boot_sample, 0, maxnptn*sizeof(int));
-    
-    double *boot_sample_dbl = aligned_alloc<double>(maxnptn);
-    
-#ifdef _OPENMP
-#pragma omp for schedule(dynamic)
+#pragma omp parallel for schedule(dynamic)
 #endif
-    for (int k = 0; k < nscales; ++k) {
-        string str = "SCALE=" + convertDoubleToString(r[k]);
-        for (boot = 0; boot < nboot; boot++) {
-            if (r[k] == 1.0 && boot == 0)
-                // 2018-10-23: get one of the bootstrap sample as the original alignment
-                tree->aln->getPatternFreq(boot_sample);
-            else
-                tree->aln->createBootstrapAlignment(boot_sample, str.c_str(), rstream);
-            for (ptn = 0; ptn < maxnptn; ptn++)
-                boot_sample_dbl[ptn] = boot_sample[ptn];
-            double max_lh = -DBL_MAX, second_max_lh = -DBL_MAX;
-            int max_tid = -1;
-            for (tid = 0; tid < ntrees; tid++) {
-                double *pattern_lh = pattern_lhs + (tid*maxnptn);
-                double tree_lh;
-                if (params.SSE == LK_386) {
-                    tree_lh = 0.0;
-                    for (ptn = 0; ptn < nptn; ptn++)
-                        tree_lh += pattern_lh[ptn] * boot_sample_dbl[ptn];
-                } else {
-                    tree_lh = tree->dotProductDoubleCall(pattern_lh, boot_sample_dbl, nptn);
+        for (size_t start = 0; start < nboot; start += RELL_REPLICATE_BLOCK) {
+            size_t end = min(start + RELL_REPLICATE_BLOCK, nboot);
+            boot_samples.computeRELL(tree, pattern_lhs, maxnptn, ntrees, start, end, scale_lhs + start, nscales*nboot);
+            for (size_t boot = start; boot < end; boot++) {
+                double max_lh = -DBL_MAX, second_max_lh = -DBL_MAX;
+                size_t max_tid = ntrees;
+                for (size_t i = 0; i < ntrees; i++) {
+                    // rescale lh
+                    double tree_lh = (scale_lhs[i*nscales*nboot + boot] /= r[k]);
+                    
+                    // find the max and second max
+                    if (tree_lh > max_lh) {
+                        second_max_lh = max_lh;
+                        max_lh = tree_lh;
+                        max_tid = i;
+                    } else if (tree_lh > second_max_lh)
+                        second_max_lh = tree_lh;
                 }
-                // rescale lh
-                tree_lh /= r[k];
-                
-                // find the max and second max
-                if (tree_lh > max_lh) {
-                    second_max_lh = max_lh;
-                    max_lh = tree_lh;
-                    max_tid = tid;
-                } else if (tree_lh > second_max_lh)
-                    second_max_lh = tree_lh;
                 
-                treelhs[(tid*nscales+k)*nboot + boot] = tree_lh;
+                // compute difference from max_lh
+                for (size_t i = 0; i < ntrees; i++)
+                    if (i != max_tid)
+                        scale_lhs[i*nscales*nboot + boot] = max_lh - scale_lhs[i*nscales*nboot + boot];
+                    else
+                        scale_lhs[i*nscales*nboot + boot] = second_max_lh - max_lh;
+                //            bp[k*ntrees+max_tid] += nboot_inv;
             }
-            
-            // compute difference from max_lh
-            for (tid = 0; tid < ntrees; tid++)
-                if (tid != max_tid)
-                    treelhs[(tid*nscales+k)*nboot + boot] = max_lh - treelhs[(tid*nscales+k)*nboot + boot];
-                else
-                    treelhs[(tid*nscales+k)*nboot + boot] = second_max_lh - max_lh;
-            //            bp[k*ntrees+max_tid] += nboot_inv;
         } // for boot
+        resampler.releaseScaled(r[k]);
         
         // sort the replicates
-        for (tid = 0; tid < ntrees; tid++) {
-            quicksort<double,int>(treelhs + (tid*nscales+k)*nboot, 0, nboot-1);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (size_t i = 0; i < ntrees; i++) {
+            quicksort<double,int>(treelhs + (i*nscales+k)*nboot, 0, nboot-1);
         }
         
     } // for scale
     
-    aligned_free(boot_sample_dbl);
-    aligned_free(boot_sample);
-    
-#ifdef _OPENMP
-    finish_random(rstream);
-    }
-#endif
-    
     //    if (verbose_mode >= VB_MED) {
     //        cout << "scale";
     //        for (k = 0; k < nscales; k++)
@@ -915,146 +1050,734 @@ void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<
     
     /* STEP 3: weighted least square fit */
     
-    double *cc = new double[nscales];
-    double *w = new double[nscales];
-    double *this_bp = new double[nscales];
     cout << "TreeID\tAU\tRSS\td\tc" << endl;
-    for (tid = 0; tid < ntrees; tid++) {
-        double *this_stat = treelhs + tid*nscales*nboot;
-        double xn = this_stat[(nscales/2)*nboot + nboot/2], x;
-        double c, d; // c, d in original paper
-        int idf0 = -2;
-        double z = 0.0, z0 = 0.0, thp = 0.0, th = 0.0, ze = 0.0, ze0 = 0.0;
-        double pval, se;
-        int df;
-        double rss = 0.0;
-        int step;
-        const int max_step = 30;
-        bool failed = false;
-        for (step = 0; step < max_step; step++) {
-            x = xn;
-            int num_k = 0;
-            for (k = 0; k < nscales; k++) {
-                this_bp[k] = cntdist3(this_stat + k*nboot, nboot, x) / nboot;
-                if (this_bp[k] <= 0 || this_bp[k] >= 1) {
-                    cc[k] = w[k] = 0.0;
-                } else {
-                    double bp_val = this_bp[k];
-                    cc[k] = -gsl_cdf_ugaussian_Pinv(bp_val);
-                    double bp_pdf = gsl_ran_ugaussian_pdf(cc[k]);
-                    w[k] = bp_pdf*bp_pdf*nboot / (bp_val*(1.0-bp_val));
-                    num_k++;
-                }
+    for (tid = 0; tid < ntrees; tid++)
+        fitAUTest(tid, treelhs + tid*nscales*nboot, nscales, nboot, r, rr, rr_inv, info[tid]);
+    
+    cout << "Time for AU test: " << getRealTime() - start_time << " seconds" << endl;
+    //    delete [] bp;
+}
+
+
+/**
+ prepare a user tree just read from the input and optimize its branch lengths,
+ setting the current score of the tree
+ @param tree tree read with readTree()
+ */
+static void optimizeUserTree(Params &params, PhyloTree *tree) {
+    if (!tree->findNodeName(tree->aln->getSeqName(0))) {
+        outError("Taxon " + tree->aln->getSeqName(0) + " not found in tree");
+    }
+    
+    if (tree->rooted && tree->getModelFactory()->isReversible()) {
+        if (tree->leafNum != tree->aln->getNSeq()+1)
+            outError("Tree does not have same number of taxa as alignment");
+        tree->convertToUnrooted();
+//            cout << "convertToUnrooted" << endl;
+    } else if (!tree->rooted && !tree->getModelFactory()->isReversible()) {
+        if (tree->leafNum != tree->aln->getNSeq())
+            outError("Tree does not have same number of taxa as alignment");
+        tree->convertToRooted();
+//            cout << "convertToRooted" << endl;
+    }
+    tree->setAlignment(tree->aln);
+    tree->setRootNode(params.root);
+    if (tree->isSuperTree())
+        ((PhyloSuperTree*) tree)->mapTrees();
+    
+    tree->initializeAllPartialLh();
+    tree->fixNegativeBranch(false);
+    if (params.fixed_branch_length) {
+        tree->setCurScore(tree->computeLikelihood());
+    } else if (params.topotest_optimize_model) {
+        tree->getModelFactory()->optimizeParameters(BRLEN_OPTIMIZE, false, params.modelEps);
+        tree->setCurScore(tree->computeLikelihood());
+    } else {
+        tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
+    }
+}
+
+/**
+ obtain the 95% confidence set of trees from their probabilities
+ @param tree_probs probabilities of all trees, summing up to 1
+ @param ntrees number of trees
+ @param[out] confident TRUE for trees in the confidence set
+ */
+static void computeConfidenceSet(double *tree_probs, int ntrees, vector<bool> &confident) {
+    int *tree_ranks = new int[ntrees];
+    int tid;
+    confident.assign(ntrees, false);
+    sort_index(tree_probs, tree_probs + ntrees, tree_ranks);
+    double prob_sum = 0.0;
+    // obtain the confidence set
+    for (tid = ntrees-1; tid >= 0; tid--) {
+        confident[tree_ranks[tid]] = true;
+        prob_sum += tree_probs[tree_ranks[tid]];
+        if (prob_sum > 0.95) break;
+    }
+    
+    // sanity check
+    for (tid = 0, prob_sum = 0.0; tid < ntrees; tid++)
+        prob_sum += tree_probs[tid];
+    if (fabs(prob_sum-1.0) > 0.01)
+        outError("Internal error: Wrong ", __func__);
+    delete [] tree_ranks;
+}
+
+/****************************************************************************
+        Streaming evaluation of user trees (--test-stream)
+ ****************************************************************************/
+
+/** number of trees read at once from the pattern log-likelihood matrix by the out-of-core tests */
+const size_t STREAM_TREE_BLOCK = 32;
+
+/** width of the tree count in the header of .sitelh and .partlh, filled in once all trees are read */
+const int STREAM_COUNT_WIDTH = 10;
+
+/**
+ read the next tree string up to and including the terminating ';'
+ @param[out] tree_str tree string
+ @return FALSE if there is no more tree
+ */
+static bool readNextTreeString(istream &in, string &tree_str) {
+    if (!getline(in, tree_str, ';'))
+        return false;
+    if (tree_str.find_first_not_of(" \t\r\n") == string::npos)
+        return false;
+    tree_str += ';';
+    return true;
+}
+
+/**
+ overwrite the placeholder tree count in the header of a .sitelh or .partlh file
+ @param file_name file name
+ @param ntrees number of trees
+ */
+static void writeStreamTreeCount(string file_name, size_t ntrees) {
+    fstream out(file_name.c_str(), ios::in | ios::out);
+    if (out.fail())
+        outError(ERR_WRITE_OUTPUT, file_name);
+    out.seekp(0);
+    out << left << setw(STREAM_COUNT_WIDTH) << ntrees;
+    out.close();
+}
+
+/** a tree evaluated by a worker, waiting to be written in input order */
+struct StreamTreeResult {
+    /** canonical topology for the duplicate check, empty if duplicates are evaluated */
+    string topology;
+    
+    /** tree with optimized branch lengths, empty if the tree was not evaluated */
+    string tree_string;
+    
+    /** log-likelihood of the tree */
+    double logl;
+    
+    /** pattern log-likelihoods, NULL if not needed */
+    double *pattern_lh;
+};
+
+/**
+    pipeline of the streaming tree evaluation. Worker threads take one tree at a time
+    from the input, parse it and optimize its branch lengths on their own PhyloTree
+    sharing the model of the main tree. Results are written in input order, with the
+    pattern log-likelihoods going to a PatternLhMatrix, and at most a window of
+    trees read ahead of the last written one is kept in memory.
+*/
+class TreeStreamPipeline {
+public:
+    
+    /**
+        open the output files
+        @param in input trees
+        @param tree main tree with the model
+        @param[out] info results of distinct trees
+        @param[out] distinct_ids ID of the first identical tree for each input tree, -1 if none
+        @param matrix pattern log-likelihood matrix to fill, NULL if not needed
+    */
+    TreeStreamPipeline(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &info,
+                       IntVector &distinct_ids, PatternLhMatrix *matrix);
+    
+    /**
+        evaluate all trees and close the output files
+        @param num_workers number of worker threads, 1 to evaluate all trees on the main tree
+    */
+    void run(int num_workers);
+    
+protected:
+    
+    /** evaluate trees on a worker tree until the input is exhausted */
+    void work(PhyloTree *worker);
+    
+    /**
+        take the next tree from the input, waiting while the window is full
+        @param[out] tree_str tree string
+        @param[out] index tree index in the input
+        @return FALSE at the end of the input
+    */
+    bool nextTree(string &tree_str, int &index);
+    
+    /** write all pending trees that are next in input order, the lock must be held */
+    void commitReady();
+    
+    /**
+        write a tree to all outputs
+        @param index tree index in the input
+        @param result evaluated tree
+    */
+    void commit(int index, StreamTreeResult &result);
+    
+    istream &in;
+    Params &params;
+    IQTree *tree;
+    vector<TreeInfo> &info;
+    IntVector &distinct_ids;
+    PatternLhMatrix *matrix;
+    
+    ofstream treeout;
+    ofstream scoreout;
+    string site_lh_file;
+    string part_lh_file;
+    
+    /** TRUE if workers compute pattern log-likelihoods */
+    bool need_pattern_lh;
+    
+    /** padded number of patterns */
+    size_t maxnptn;
+    
+    /** number of trees read from the input */
+    int num_read;
+    
+    /** number of trees written */
+    int num_committed;
+    
+    /** maximal number of trees read ahead of the last written one */
+    int window;
+    
+    /** first tree index of each canonical topology seen so far */
+    StringIntMap first_ids;
+    
+    /** evaluated trees waiting for their predecessors */
+    map<int, StreamTreeResult> pending;
+    
+    std::mutex mutex;
+    
+    /** signalled whenever trees are written */
+    std::condition_variable committed;
+};
+
+TreeStreamPipeline::TreeStreamPipeline(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &info,
+                                       IntVector &distinct_ids, PatternLhMatrix *matrix)
+    : in(in), params(params), tree(tree), info(info), distinct_ids(distinct_ids), matrix(matrix)
+{
+    string tree_file = params.out_prefix;
+    tree_file += ".trees";
+    treeout.open(tree_file.c_str());
+    if (params.print_tree_lh) {
+        string score_file = params.out_prefix;
+        score_file += ".treelh";
+        scoreout.open(score_file.c_str());
+    }
+    site_lh_file = params.out_prefix;
+    site_lh_file += ".sitelh";
+    if (params.print_site_lh) {
+        ofstream site_lh_out(site_lh_file.c_str());
+        site_lh_out << left << setw(STREAM_COUNT_WIDTH) << 0 << " " << tree->getAlnNSite() << endl;
+        site_lh_out.close();
+    }
+    part_lh_file = params.out_prefix;
+    part_lh_file += ".partlh";
+    if (params.print_partition_lh) {
+        ofstream part_lh_out(part_lh_file.c_str());
+        part_lh_out << left << setw(STREAM_COUNT_WIDTH) << 0 << " " << ((PhyloSuperTree*)tree)->size() << endl;
+        part_lh_out.close();
+    }
+    need_pattern_lh = matrix || params.print_site_lh || params.print_partition_lh;
+    maxnptn = get_safe_upper_limit(tree->getAlnNPattern());
+    num_read = 0;
+    num_committed = 0;
+    window = 1;
+}
+
+void TreeStreamPipeline::run(int num_workers) {
+    window = 4 * num_workers;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_workers)
+#endif
+    {
+        PhyloTree *worker = tree;
+        if (num_workers > 1) {
+            worker = new PhyloTree;
+            worker->setParams(&params);
+            worker->aln = tree->aln;
+            worker->sse = tree->sse;
+            worker->setNumThreads(1);
+            worker->setModelFactory(tree->getModelFactory());
+        }
+        work(worker);
+        if (worker != tree) {
+            worker->setModelFactory(NULL);
+            worker->setModel(NULL);
+            worker->setRate(NULL);
+            delete worker;
+        }
+    }
+    ASSERT(pending.empty() && num_committed == num_read);
+    
+    treeout.close();
+    if (params.print_tree_lh)
+        scoreout.close();
+    if (params.print_site_lh)
+        writeStreamTreeCount(site_lh_file, info.size());
+    if (params.print_partition_lh)
+        writeStreamTreeCount(part_lh_file, info.size());
+}
+
+void TreeStreamPipeline::work(PhyloTree *worker) {
+    string tree_str;
+    int index;
+    while (nextTree(tree_str, index)) {
+        StreamTreeResult result;
+        result.logl = 0.0;
+        result.pattern_lh = NULL;
+        stringstream str(tree_str);
+        worker->freeNode();
+        // readTree() may change the flag, every worker reads with its own copy
+        bool rooted = tree->rooted;
+        worker->readTree(str, rooted);
+        bool duplicate = false;
+        if (params.distinct_trees) {
+            worker->setAlignment(tree->aln);
+            worker->setRootNode(params.root);
+            ostringstream ostr;
+            worker->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
+            result.topology = ostr.str();
+            // a tree read earlier may still register later, so commit() makes the final decision
+            std::lock_guard<std::mutex> guard(mutex);
+            StringIntMap::iterator it = first_ids.find(result.topology);
+            if (it == first_ids.end())
+                first_ids[result.topology] = index;
+            else if (it->second > index)
+                it->second = index;
+            else
+                duplicate = true;
+        }
+        if (!duplicate) {
+            optimizeUserTree(params, worker);
+            result.logl = worker->getCurScore();
+            ostringstream ostr;
+            worker->printTree(ostr);
+            result.tree_string = ostr.str();
+            if (need_pattern_lh) {
+                double cur_score = result.logl;
+                result.pattern_lh = aligned_alloc<double>(maxnptn);
+                memset(result.pattern_lh, 0, maxnptn*sizeof(double));
+                worker->computePatternLikelihood(result.pattern_lh, &cur_score);
             }
-            df = num_k-2;
-            if (num_k >= 2) {
-                // first obtain d and c by weighted least square
-                doWeightedLeastSquare(nscales, w, rr, rr_inv, cc, d, c, se);
-                
-                // maximum likelhood fit
-                double coef0[2] = {d, c};
-                int mlefail = mlecoef(this_bp, r, nboot, nscales, coef0, &rss, &df, &se);
-                
-                if (!mlefail) {
-                    d = coef0[0];
-                    c = coef0[1];
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        pending[index] = result;
+        commitReady();
+    }
+}
+
+bool TreeStreamPipeline::nextTree(string &tree_str, int &index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (num_read >= num_committed + window)
+        committed.wait(lock);
+    if (!readNextTreeString(in, tree_str))
+        return false;
+    index = num_read++;
+    return true;
+}
+
+void TreeStreamPipeline::commitReady() {
+    map<int, StreamTreeResult>::iterator it;
+    bool any = false;
+    while ((it = pending.find(num_committed)) != pending.end()) {
+        commit(num_committed, it->second);
+        if (it->second.pattern_lh)
+            aligned_free(it->second.pattern_lh);
+        pending.erase(it);
+        num_committed++;
+        any = true;
+    }
+    if (any)
+        committed.notify_all();
+}
+
+void TreeStreamPipeline::commit(int index, StreamTreeResult &result) {
+    cout << "Tree " << index + 1;
+    // all trees before this one are parsed, so first_ids holds the first occurrence
+    int first_id = -1;
+    if (!result.topology.empty() && first_ids[result.topology] < index)
+        first_id = first_ids[result.topology];
+    distinct_ids.push_back(first_id);
+    if (first_id >= 0) {
+        cout << " / identical to tree " << first_id+1 << endl;
+        return;
+    }
+    ASSERT(!result.tree_string.empty());
+    
+    treeout << "[ tree " << index+1 << " lh=" << result.logl << " ]" << result.tree_string << endl;
+    if (params.print_tree_lh)
+        scoreout << result.logl << endl;
+    
+    cout << " / LogL: " << result.logl << endl;
+    
+    string tree_name = "Tree" + convertIntToString(index+1);
+    if (params.print_site_lh)
+        printSiteLh(site_lh_file.c_str(), tree, result.pattern_lh, true, tree_name.c_str());
+    if (params.print_partition_lh)
+        printPartitionLh(part_lh_file.c_str(), tree, result.pattern_lh, true, tree_name.c_str());
+    if (matrix)
+        matrix->addTree(info.size(), result.logl, result.pattern_lh);
+    info.push_back(TreeInfo());
+    info.back().logl = result.logl;
+}
+
+/**
+ RELL log-likelihoods of a block of trees for all replicates
+ @param pattern_lhs pattern log-likelihoods of the trees
+ @param lh_stride distance between the pattern log-likelihoods of consecutive trees
+ @param ntrees number of trees
+ @param[out] rell RELL log-likelihoods, #trees x #replicates
+ */
+static void computeBlockRELL(PhyloTree *tree, ReplicateWeights &boot_samples, double *pattern_lhs,
+                             size_t lh_stride, size_t ntrees, double *rell) {
+    size_t nboot = boot_samples.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t start = 0; start < nboot; start += RELL_REPLICATE_BLOCK)
+        boot_samples.computeRELL(tree, pattern_lhs, lh_stride, ntrees, start,
+            min(start + RELL_REPLICATE_BLOCK, nboot), rell + start, nboot);
+}
+
+/**
+ AU test on the pattern log-likelihood matrix in two passes: the first finds
+ the best and second best tree of every multiscale replicate, the second
+ computes the statistics of each tree and fits its AU p-value
+ @param matrix pattern log-likelihood matrix of all trees
+ @param resampler resampling engine, shared with the other tests
+ */
+static void performAUTestStream(Params &params, PhyloTree *tree, PatternLhMatrix &matrix,
+                                vector<TreeInfo> &info, BootstrapResampler &resampler) {
+    
+    if (params.topotest_replicates < 10000)
+        outWarning("Too few replicates for AU test. At least -zb 10000 for reliable results!");
+    
+    size_t nscales = AU_NUM_SCALES;
+    double r[AU_NUM_SCALES], rr[AU_NUM_SCALES], rr_inv[AU_NUM_SCALES];
+    getAUScales(r, rr, rr_inv);
+    
+    size_t ntrees = info.size();
+    size_t nboot = params.topotest_replicates;
+    size_t maxnptn = get_safe_upper_limit(tree->getAlnNPattern());
+    size_t k, tid, nread;
+    
+    double start_time = getRealTime();
+    
+    // all scales are needed for every block of trees, so the replicate matrices stay in memory
+    cout << "Generating " << nscales << " x " << nboot << " multiscale bootstrap replicates... ";
+    ReplicateWeights *boot_samples[AU_NUM_SCALES];
+    for (k = 0; k < nscales; k++)
+        boot_samples[k] = &resampler.getScaledReplicates(r[k]);
+    cout << getRealTime() - start_time << " seconds" << endl;
+    
+    double *pattern_lhs = aligned_alloc<double>(STREAM_TREE_BLOCK*maxnptn);
+    double *rell = new double[STREAM_TREE_BLOCK*nboot];
+    int tree_ids[STREAM_TREE_BLOCK];
+    
+    // best and second best rescaled RELL log-likelihood of every scale and replicate
+    double *max_lh = new double[nscales*nboot];
+    double *second_max_lh = new double[nscales*nboot];
+    int *max_tid = new int[nscales*nboot];
+    for (size_t i = 0; i < nscales*nboot; i++) {
+        max_lh[i] = second_max_lh[i] = -DBL_MAX;
+        max_tid[i] = -1;
+    }
+    
+    matrix.rewind();
+    for (tid = 0; (nread = matrix.readTrees(STREAM_TREE_BLOCK, pattern_lhs, maxnptn, tree_ids, NULL)) > 0; tid += nread)
+        for (k = 0; k < nscales; k++) {
+            computeBlockRELL(tree, *boot_samples[k], pattern_lhs, maxnptn, nread, rell);
+            for (size_t i = 0; i < nread; i++)
+                for (size_t boot = 0; boot < nboot; boot++) {
+                    double tree_lh = rell[i*nboot + boot] / r[k];
+                    size_t id = k*nboot + boot;
+                    if (tree_lh > max_lh[id]) {
+                        second_max_lh[id] = max_lh[id];
+                        max_lh[id] = tree_lh;
+                        max_tid[id] = tid + i;
+                    } else if (tree_lh > second_max_lh[id])
+                        second_max_lh[id] = tree_lh;
                 }
-                
-                se = gsl_ran_ugaussian_pdf(d-c)*sqrt(se);
-                
-                // second, perform MLE estimate of d and c
-                //            OptimizationAUTest mle(d, c, nscales, this_bp, rr, rr_inv);
-                //            mle.optimizeDC();
-                //            d = mle.d;
-                //            c = mle.c;
-                
-                /* STEP 4: compute p-value according to Eq. 11 */
-                pval = gsl_cdf_ugaussian_Q(d-c);
-                z = -pval;
-                ze = se;
-                // compute sum of squared difference
-                rss = 0.0;
-                for (k = 0; k < nscales; k++) {
-                    double diff = cc[k] - (rr[k]*d + rr_inv[k]*c);
-                    rss += w[k] * diff * diff;
+        }
+    ASSERT(tid == ntrees);
+    
+    // statistics of a block of trees, each nscales x nboot
+    double *treelhs = new double[STREAM_TREE_BLOCK*nscales*nboot];
+    
+    cout << "TreeID\tAU\tRSS\td\tc" << endl;
+    matrix.rewind();
+    for (tid = 0; (nread = matrix.readTrees(STREAM_TREE_BLOCK, pattern_lhs, maxnptn, tree_ids, NULL)) > 0; tid += nread) {
+        for (k = 0; k < nscales; k++) {
+            computeBlockRELL(tree, *boot_samples[k], pattern_lhs, maxnptn, nread, rell);
+            for (size_t i = 0; i < nread; i++) {
+                double *this_stat = treelhs + (i*nscales + k)*nboot;
+                for (size_t boot = 0; boot < nboot; boot++) {
+                    size_t id = k*nboot + boot;
+                    if (max_tid[id] == tid + i)
+                        this_stat[boot] = second_max_lh[id] - max_lh[id];
+                    else
+                        this_stat[boot] = max_lh[id] - rell[i*nboot + boot] / r[k];
                 }
-                
-            } else {
-                // not enough data for WLS
-                int num0 = 0;
-                for (k = 0; k < nscales; k++)
-                    if (this_bp[k] <= 0.0) num0++;
-                if (num0 > nscales/2)
-                    pval = 0.0;
-                else
-                    pval = 1.0;
-                se = 0.0;
-                d = c = 0.0;
-                rss = 0.0;
-                if (verbose_mode >= VB_MED)
-                    cout << "   error in wls" << endl;
-                //info[tid].au_pvalue = pval;
-                //break;
             }
+        }
+        
+        // sort the replicates
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (size_t i = 0; i < nread*nscales; i++)
+            quicksort<double,int>(treelhs + i*nboot, 0, nboot-1);
+        
+        for (size_t i = 0; i < nread; i++)
+            fitAUTest(tid + i, treelhs + i*nscales*nboot, nscales, nboot, r, rr, rr_inv, info[tid + i]);
+    }
+    
+    for (k = 0; k < nscales; k++)
+        resampler.releaseScaled(r[k]);
+    
+    delete [] treelhs;
+    delete [] max_tid;
+    delete [] second_max_lh;
+    delete [] max_lh;
+    delete [] rell;
+    aligned_free(pattern_lhs);
+    
+    cout << "Time for AU test: " << getRealTime() - start_time << " seconds" << endl;
+}
+
+/**
+ RELL-BP, KH, SH, ELW and AU tests on the pattern log-likelihood matrix,
+ reading blocks of trees so that only O(#trees + #replicates) values stay in memory.
+ The first pass collects the maxima over trees of every replicate, the second
+ computes the p-values of each tree.
+ @param matrix_file pattern log-likelihood matrix of all distinct trees
+ @param[in,out] info log-likelihoods of the trees, receives the test results
+ */
+static void performTreeTestsStream(Params &params, PhyloTree *tree, string matrix_file, vector<TreeInfo> &info) {
+    size_t ntrees = info.size();
+    size_t nboot = params.topotest_replicates;
+    size_t maxnptn = get_safe_upper_limit(tree->getAlnNPattern());
+    size_t tid, nread, boot;
+    
+    BootstrapResampler resampler(tree->aln, nboot, params.ran_seed);
+    cout << "Creating " << nboot << " bootstrap replicates..." << endl;
+    ReplicateWeights &boot_samples = resampler.getReplicates(params.bootstrap_spec);
+    cout << "done" << endl;
+    
+    PatternLhMatrix matrix;
+    matrix.open(matrix_file);
+    ASSERT(matrix.getNPattern() == tree->getAlnNPattern());
+    double *pattern_lhs = aligned_alloc<double>(STREAM_TREE_BLOCK*maxnptn);
+    double *rell = new double[STREAM_TREE_BLOCK*nboot];
+    int tree_ids[STREAM_TREE_BLOCK];
+    
+    // the two best trees on the original alignment for the KH test
+    size_t orig_max_id = 0;
+    size_t orig_2ndmax_id = -1;
+    for (tid = 1; tid < ntrees; tid++)
+        if (info[orig_max_id].logl < info[tid].logl)
+            orig_max_id = tid;
+    double orig_2ndmax_lh = -DBL_MAX;
+    for (tid = 0; tid < ntrees; tid++)
+        if (tid != orig_max_id && orig_2ndmax_lh < info[tid].logl) {
+            orig_2ndmax_lh = info[tid].logl;
+            orig_2ndmax_id = tid;
+        }
+    
+    double *tree_probs = new double[ntrees];
+    double *avg_lh = new double[ntrees];
+    int *maxtid = new int[nboot];
+    double *maxL = new double[nboot];
+    int *maxcount = new int[nboot];
+    double *max_lh = new double[nboot];
+    double *elw_max = new double[nboot];
+    double *elw_sum = new double[nboot];
+    double *max_kh = new double[nboot];
+    double *second_max_kh = new double[nboot];
+    for (boot = 0; boot < nboot; boot++) {
+        max_lh[boot] = elw_max[boot] = -DBL_MAX;
+        elw_sum[boot] = 0.0;
+    }
+    
+    cout << "Performing RELL-BP, KH, SH and ELW tests..." << endl;
+    
+    for (tid = 0; (nread = matrix.readTrees(STREAM_TREE_BLOCK, pattern_lhs, maxnptn, tree_ids, NULL)) > 0; ) {
+        computeBlockRELL(tree, boot_samples, pattern_lhs, maxnptn, nread, rell);
+        for (size_t i = 0; i < nread; i++, tid++) {
+            ASSERT(tree_ids[i] == tid);
+            double *tree_rell = rell + i*nboot;
+            // RELL-BP with random tie breaking, trees in the same order as evaluateTrees()
+            for (boot = 0; boot < nboot; boot++)
+                if (tid == 0 || tree_rell[boot] > maxL[boot] + params.ufboot_epsilon) {
+                    maxL[boot] = tree_rell[boot];
+                    maxtid[boot] = tid;
+                    maxcount[boot] = 1;
+                } else if (tree_rell[boot] > maxL[boot] - params.ufboot_epsilon &&
+                           random_double() <= 1.0/(maxcount[boot]+1)) {
+                    maxL[boot] = max(maxL[boot], tree_rell[boot]);
+                    maxtid[boot] = tid;
+                    maxcount[boot]++;
+                }
             
+            // SH centering step
+            avg_lh[tid] = 0.0;
+            for (boot = 0; boot < nboot; boot++)
+                avg_lh[tid] += tree_rell[boot];
+            avg_lh[tid] /= nboot;
+            for (boot = 0; boot < nboot; boot++)
+                max_lh[boot] = max(max_lh[boot], tree_rell[boot] - avg_lh[tid]);
             
-            if (verbose_mode >= VB_MED) {
-                cout.unsetf(ios::fixed);
-                cout << "\t" << step << "\t" << th << "\t" << x << "\t" << pval << "\t" << se << "\t" << nscales-2 << "\t" << d << "\t" << c << "\t" << z << "\t" << ze << "\t" << rss << endl;
-            }
-            
-            if(df < 0 && idf0 < 0) { failed = true; break;} /* degenerated */
+            // ELW normalization as a running log-sum-exp
+            for (boot = 0; boot < nboot; boot++)
+                if (tree_rell[boot] > elw_max[boot]) {
+                    elw_sum[boot] = elw_sum[boot] * exp(elw_max[boot] - tree_rell[boot]) + 1.0;
+                    elw_max[boot] = tree_rell[boot];
+                } else
+                    elw_sum[boot] += exp(tree_rell[boot] - elw_max[boot]);
             
-            if ((df < 0) || (idf0 >= 0 && (z-z0)*(x-thp) > 0.0 && fabs(z-z0)>0.1*ze0)) {
-                if (verbose_mode >= VB_MED)
-                    cout << "   non-monotone" << endl;
-                th=x;
-                xn=0.5*x+0.5*thp;
-                continue;
+            if (tid == orig_max_id)
+                memcpy(max_kh, tree_rell, nboot*sizeof(double));
+            if (tid == orig_2ndmax_id)
+                memcpy(second_max_kh, tree_rell, nboot*sizeof(double));
+        }
+    }
+    ASSERT(tid == ntrees);
+    
+    vector<bool> confident;
+    memset(tree_probs, 0, ntrees*sizeof(double));
+    for (boot = 0; boot < nboot; boot++)
+        tree_probs[maxtid[boot]] += 1.0;
+    for (tid = 0; tid < ntrees; tid++) {
+        tree_probs[tid] /= nboot;
+        info[tid].rell_bp = tree_probs[tid];
+    }
+    computeConfidenceSet(tree_probs, ntrees, confident);
+    for (tid = 0; tid < ntrees; tid++)
+        info[tid].rell_confident = confident[tid];
+    
+    matrix.rewind();
+    for (tid = 0; (nread = matrix.readTrees(STREAM_TREE_BLOCK, pattern_lhs, maxnptn, tree_ids, NULL)) > 0; ) {
+        computeBlockRELL(tree, boot_samples, pattern_lhs, maxnptn, nread, rell);
+        for (size_t i = 0; i < nread; i++, tid++) {
+            double *tree_rell = rell + i*nboot;
+            size_t max_id = (tid != orig_max_id) ? orig_max_id : orig_2ndmax_id;
+            double *max_id_rell = (tid != orig_max_id) ? max_kh : second_max_kh;
+            double orig_diff = info[max_id].logl - info[tid].logl - avg_lh[tid];
+            double sh_count = 0.0, kh_count = 0.0;
+            tree_probs[tid] = 0.0;
+            for (boot = 0; boot < nboot; boot++) {
+                if (max_lh[boot] - tree_rell[boot] > orig_diff)
+                    sh_count += 1.0;
+                if (max_id_rell[boot] - avg_lh[max_id] - tree_rell[boot] > orig_diff)
+                    kh_count += 1.0;
+                tree_probs[tid] += exp(tree_rell[boot] - elw_max[boot]) / elw_sum[boot];
             }
-            if(idf0 >= 0 && (fabs(z-z0)<0.01*ze0)) {
-                if(fabs(th)<1e-10)
-                    xn=th;
-                else th=x;
-            } else
-                xn=0.5*th+0.5*x;
-            info[tid].au_pvalue = pval;
-            thp=x;
-            z0=z;
-            ze0=ze;
-            idf0 = df;
-            if(fabs(x-th)<1e-10) break;
-        } // for step
-        
-        if (failed && verbose_mode >= VB_MED)
-            cout << "   degenerated" << endl;
-        
-        if (step == max_step) {
-            if (verbose_mode >= VB_MED)
-                cout << "   non-convergence" << endl;
-            failed = true;
+            info[tid].sh_pvalue = sh_count / nboot;
+            info[tid].kh_pvalue = kh_count / nboot;
+            tree_probs[tid] /= nboot;
+            info[tid].elw_value = tree_probs[tid];
         }
-        
-        double pchi2 = (failed) ? 0.0 : computePValueChiSquare(rss, df);
-        cout << tid+1 << "\t" << info[tid].au_pvalue << "\t" << rss << "\t" << d << "\t" << c;
-        
-        // warning if p-value of chi-square < 0.01 (rss too high)
-        if (pchi2 < 0.01)
-            cout << " !!!";
-        cout << endl;
     }
     
-    delete [] this_bp;
-    delete [] w;
-    delete [] cc;
+    computeConfidenceSet(tree_probs, ntrees, confident);
+    for (tid = 0; tid < ntrees; tid++)
+        info[tid].elw_confident = confident[tid];
     
-    cout << "Time for AU test: " << getRealTime() - start_time << " seconds" << endl;
-    //    delete [] bp;
+    delete [] second_max_kh;
+    delete [] max_kh;
+    delete [] elw_sum;
+    delete [] elw_max;
+    delete [] max_lh;
+    delete [] maxcount;
+    delete [] maxL;
+    delete [] maxtid;
+    delete [] avg_lh;
+    delete [] tree_probs;
+    delete [] rell;
+    aligned_free(pattern_lhs);
+    
+    if (params.do_au_test) {
+        cout << "Performing approximately unbiased (AU) test..." << endl;
+        performAUTestStream(params, tree, matrix, info, resampler);
+    }
+    matrix.close();
 }
 
+/**
+ evaluate user trees in a pipeline without reading the whole input first (--test-stream).
+ Pattern log-likelihoods are written to a compressed matrix file on which the tests run out-of-core.
+ */
+static void evaluateTreesStream(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &info, IntVector &distinct_ids)
+{
+    cout << endl;
+    // -zw with --test-stream is rejected when parsing the options
+    ASSERT(!params.do_weighted_test);
+    if (params.print_partition_lh && !tree->isSuperTree()) {
+        outWarning("-wpl does not work with non-partition model");
+        params.print_partition_lh = false;
+    }
+    info.clear();
+    distinct_ids.clear();
+    
+    // worker trees share the model, which is only safe when branch lengths alone are optimized
+    int num_workers = max(tree->num_threads, 1);
+    if (tree->isSuperTree() || tree->isTreeMix() || params.topotest_optimize_model ||
+        !tree->getModelFactory()->isReversible())
+        num_workers = 1;
+    
+    double time_start = getRealTime();
+    string saved_tree = tree->getTreeString();
+    
+    string matrix_file = params.out_prefix;
+    matrix_file += ".ptnlh.gz";
+    PatternLhMatrix matrix;
+    if (params.topotest_replicates)
+        matrix.create(matrix_file, tree->getAlnNPattern());
+    
+    cout << "Evaluating trees with " << num_workers << " thread" << (num_workers > 1 ? "s" : "") << "..." << endl;
+    TreeStreamPipeline pipeline(in, params, tree, info, distinct_ids, params.topotest_replicates ? &matrix : NULL);
+    pipeline.run(num_workers);
+    matrix.close();
+    
+    size_t ntrees = info.size();
+    if (ntrees < distinct_ids.size()) {
+        cout << "WARNING: " << distinct_ids.size() << " trees detected but only " << ntrees << " distinct trees evaluated" << endl;
+    } else {
+        cout << ntrees << (params.distinct_trees ? " distinct" : "") << " trees evaluated" << endl;
+    }
+    if (params.topotest_replicates)
+        cout << "Pattern log-likelihoods written to " << matrix_file << endl;
+    
+    if (params.topotest_replicates && ntrees > 1)
+        performTreeTestsStream(params, tree, matrix_file, info);
+    
+    // restore the tree
+    tree->readTreeString(saved_tree);
+    
+    cout << "Time for evaluating all trees: " << getRealTime() - time_start << " sec." << endl;
+}
 
 void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &info, IntVector &distinct_ids)
 {
+    if (params.topotest_stream) {
+        evaluateTreesStream(in, params, tree, info, distinct_ids);
+        return;
+    }
     cout << endl;
     //MTreeSet trees(treeset_file, params.is_rooted, params.tree_burnin, params.tree_max_count);
     size_t ntrees = countDistinctTrees(in, params.is_rooted, tree, distinct_ids, params.distinct_trees);
@@ -1101,7 +1824,8 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
     
     double time_start = getRealTime();
     
-    int *boot_samples = NULL;
+    BootstrapResampler resampler(tree->aln, params.topotest_replicates, params.ran_seed);
+    ReplicateWeights *boot_samples = NULL;
     //double *saved_tree_lhs = NULL;
     double *tree_lhs = NULL; // RELL score matrix of size #trees x #replicates
     double *pattern_lh = NULL;
@@ -1122,26 +1846,7 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
         if (mem_size > getMemorySize()-100000)
             outWarning("The required memory does not fit in RAM!");
         cout << "Creating " << params.topotest_replicates << " bootstrap replicates..." << endl;
-        if (!(boot_samples = new int [params.topotest_replicates*nptn]))
-            outError(ERR_NO_MEMORY);
-#ifdef _OPENMP
-#pragma omp parallel if(nptn > 10000)
-        {
-        int *rstream;
-        init_random(params.ran_seed + omp_get_thread_num(), false, &rstream);
-#pragma omp for schedule(static)
-#else
-        int *rstream = randstream;
-#endif
-        for (size_t boot = 0; boot < params.topotest_replicates; boot++)
-            if (boot == 0)
-                tree->aln->getPatternFreq(boot_samples + (boot*nptn));
-            else
-                tree->aln->createBootstrapAlignment(boot_samples + (boot*nptn), params.bootstrap_spec, rstream);
-#ifdef _OPENMP
-        finish_random(rstream);
-        }
-#endif
+        boot_samples = &resampler.getReplicates(params.bootstrap_spec);
         cout << "done" << endl;
         //if (!(saved_tree_lhs = new double [ntrees * params.topotest_replicates]))
         //    outError(ERR_NO_MEMORY);
@@ -1181,36 +1886,7 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
         }
         tree->freeNode();
         tree->readTree(in, tree->rooted);
-        if (!tree->findNodeName(tree->aln->getSeqName(0))) {
-            outError("Taxon " + tree->aln->getSeqName(0) + " not found in tree");
-        }
-        
-        if (tree->rooted && tree->getModelFactory()->isReversible()) {
-            if (tree->leafNum != tree->aln->getNSeq()+1)
-                outError("Tree does not have same number of taxa as alignment");
-            tree->convertToUnrooted();
-//            cout << "convertToUnrooted" << endl;
-        } else if (!tree->rooted && !tree->getModelFactory()->isReversible()) {
-            if (tree->leafNum != tree->aln->getNSeq())
-                outError("Tree does not have same number of taxa as alignment");
-            tree->convertToRooted();
-//            cout << "convertToRooted" << endl;
-        }
-        tree->setAlignment(tree->aln);
-        tree->setRootNode(params.root);
-        if (tree->isSuperTree())
-            ((PhyloSuperTree*) tree)->mapTrees();
-        
-        tree->initializeAllPartialLh();
-        tree->fixNegativeBranch(false);
-        if (params.fixed_branch_length) {
-            tree->setCurScore(tree->computeLikelihood());
-        } else if (params.topotest_optimize_model) {
-            tree->getModelFactory()->optimizeParameters(BRLEN_OPTIMIZE, false, params.modelEps);
-            tree->setCurScore(tree->computeLikelihood());
-        } else {
-            tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
-        }
+        optimizeUserTree(params, tree);
         treeout << "[ tree " << tree_index+1 << " lh=" << tree->getCurScore() << " ]";
         tree->printTree(treeout);
         treeout << endl;
@@ -1243,13 +1919,12 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
         // now compute RELL scores
         orig_tree_lh[tid] = tree->getCurScore();
         double *tree_lhs_offset = tree_lhs + (tid*params.topotest_replicates);
-        for (size_t boot = 0; boot < params.topotest_replicates; boot++) {
-            double lh = 0.0;
-            int *this_boot_sample = boot_samples + (boot*nptn);
-            for (size_t ptn = 0; ptn < nptn; ptn++)
-                lh += pattern_lh[ptn] * this_boot_sample[ptn];
-            tree_lhs_offset[boot] = lh;
-        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (size_t boot = 0; boot < params.topotest_replicates; boot += RELL_REPLICATE_BLOCK)
+            boot_samples->computeRELL(tree, pattern_lh, boot, min(boot + RELL_REPLICATE_BLOCK, (size_t)params.topotest_replicates),
+                tree_lhs_offset + boot);
         tid++;
     }
     
@@ -1258,7 +1933,6 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
     if (params.topotest_replicates && ntrees > 1) {
         double *tree_probs = new double[ntrees];
         memset(tree_probs, 0, ntrees*sizeof(double));
-        int *tree_ranks = new int[ntrees];
         
         /* perform RELL BP method */
         cout << "Performing RELL-BP test..." << endl;
@@ -1287,23 +1961,12 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
             tree_probs[maxtid[boot]] += 1.0;
         for (tid = 0; tid < ntrees; tid++) {
             tree_probs[tid] /= params.topotest_replicates;
-            info[tid].rell_confident = false;
             info[tid].rell_bp = tree_probs[tid];
         }
-        sort_index(tree_probs, tree_probs + ntrees, tree_ranks);
-        double prob_sum = 0.0;
-        // obtain the confidence set
-        for (tid = ntrees-1; tid >= 0; tid--) {
-            info[tree_ranks[tid]].rell_confident = true;
-            prob_sum += tree_probs[tree_ranks[tid]];
-            if (prob_sum > 0.95) break;
-        }
-        
-        // sanity check
-        for (tid = 0, prob_sum = 0.0; tid < ntrees; tid++)
-            prob_sum += tree_probs[tid];
-        if (fabs(prob_sum-1.0) > 0.01)
-            outError("Internal error: Wrong ", __func__);
+        vector<bool> confident;
+        computeConfidenceSet(tree_probs, ntrees, confident);
+        for (tid = 0; tid < ntrees; tid++)
+            info[tid].rell_confident = confident[tid];
         
         delete [] maxcount;
         delete [] maxL;
@@ -1442,32 +2105,19 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
                 tree_probs[tid] += (tree_lhs_offset[boot] / sumL[boot]);
             }
             tree_probs[tid] /= params.topotest_replicates;
-            info[tid].elw_confident = false;
             info[tid].elw_value = tree_probs[tid];
         }
         
-        sort_index(tree_probs, tree_probs + ntrees, tree_ranks);
-        prob_sum = 0.0;
-        // obtain the confidence set
-        for (tid = ntrees-1; tid >= 0; tid--) {
-            info[tree_ranks[tid]].elw_confident = true;
-            prob_sum += tree_probs[tree_ranks[tid]];
-            if (prob_sum > 0.95) break;
-        }
-        
-        // sanity check
-        for (tid = 0, prob_sum = 0.0; tid < ntrees; tid++)
-            prob_sum += tree_probs[tid];
-        if (fabs(prob_sum-1.0) > 0.01)
-            outError("Internal error: Wrong ", __func__);
+        computeConfidenceSet(tree_probs, ntrees, confident);
+        for (tid = 0; tid < ntrees; tid++)
+            info[tid].elw_confident = confident[tid];
         delete [] sumL;
         
         if (params.do_au_test) {
             cout << "Performing approximately unbiased (AU) test..." << endl;
-            performAUTest(params, tree, pattern_lhs, info);
+            performAUTest(params, tree, pattern_lhs, info, resampler);
         }
         
-        delete [] tree_ranks;
         delete [] tree_probs;
         
     }
@@ -1477,7 +2127,6 @@ void evaluateTrees(istream &in, Params &params, IQTree *tree, vector<TreeInfo> &
     aligned_free(pattern_lhs);
     delete [] lhdiff_weights;
     delete [] tree_lhs;
-    delete [] boot_samples;
     
     if (params.print_tree_lh) {
         scoreout.close();
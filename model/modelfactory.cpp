@@ -1020,6 +1020,8 @@ void ModelFactory::saveCheckpoint() {
 }
 
 void ModelFactory::restoreCheckpoint() {
+    ModelSubst::bumpParamEpoch();
+    RateHeterogeneity::bumpParamEpoch();
     model->restoreCheckpoint();
     site_rate->restoreCheckpoint();
     startCheckpoint();
@@ -1586,6 +1588,8 @@ void ModelFactory::setVariables(double *variables) {
 }
 
 bool ModelFactory::getVariables(double *variables) {
+    ModelSubst::bumpParamEpoch();
+    RateHeterogeneity::bumpParamEpoch();
     bool changed = model->getVariables(variables);
     changed |= site_rate->getVariables(variables + model->getNDim());
     return changed;
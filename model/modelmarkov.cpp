@@ -1384,6 +1384,8 @@ void ModelMarkov::decomposeRateMatrixNonrev() {
 }
 
 void ModelMarkov::decomposeRateMatrix(){
+	// cached transition terms of all trees are out of date
+	bumpParamEpoch();
 	int i, j, k = 0;
 
     if (!is_reversible) {
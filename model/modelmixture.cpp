@@ -2045,6 +2045,7 @@ bool ModelMixture::isUnstableParameters() {
 }
 
 void ModelMixture::decomposeRateMatrix() {
+	bumpParamEpoch();
 	for (iterator it = begin(); it != end(); it++)
 		(*it)->decomposeRateMatrix();
 }
@@ -128,6 +128,7 @@ void ModelSet::writeInfo(ostream& out)
 
 void ModelSet::decomposeRateMatrix()
 {
+    bumpParamEpoch();
     if (empty()) {
         return;
     }
@@ -12,6 +12,8 @@
 #include "modelsubst.h"
 #include "utils/tools.h"
 
+std::atomic<int64_t> ModelSubst::param_epoch(0);
+
 ModelSubst::ModelSubst(int nstates) : Optimization(), CheckpointFactory()
 {
 	num_states = nstates;
@@ -42,6 +44,7 @@ void ModelSubst::saveCheckpoint() {
 }
 
 void ModelSubst::restoreCheckpoint() {
+    bumpParamEpoch();
     CheckpointFactory::restoreCheckpoint();
     startCheckpoint();
 //    CKP_RESTORE(num_states);
@@ -126,6 +129,7 @@ void ModelSubst::getStateFrequency(double *state_freq, int mixture) {
 }
 
 void ModelSubst::setStateFrequency(double *state_freq) {
+    bumpParamEpoch();
     memcpy(this->state_freq, state_freq, sizeof(double)*num_states);
 }
 
@@ -13,6 +13,7 @@
 #define SUBSTMODEL_H
 
 #include <string>
+#include <atomic>
 #include "utils/tools.h"
 #include "utils/optimization.h"
 #include "utils/checkpoint.h"
@@ -43,6 +44,12 @@ public:
 	*/
     ModelSubst(int nstates);
 
+    /** called whenever the eigen decomposition or state frequencies of any model change */
+    static void bumpParamEpoch() { param_epoch++; }
+
+    /** @return number of parameter changes of all models, see PhyloTree::getModelEpoch() */
+    static int64_t getParamEpoch() { return param_epoch; }
+
 
 	/**
 		@return the number of dimensions
@@ -453,6 +460,9 @@ public:
 
 protected:
 
+    /** parameter epoch shared by all models */
+    static std::atomic<int64_t> param_epoch;
+
 	/**
 		this function is served for the multi-dimension optimization. It should pack the model parameters
 		into a vector that is index from 1 (NOTE: not from 0)
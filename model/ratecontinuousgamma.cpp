@@ -36,6 +36,7 @@ void RateContinuousGamma::restoreCheckpoint() {
 }
 
 void RateContinuousGamma::setGammaShape(double gs) {
+    bumpParamEpoch();
     gamma_shape = gs;
 }
 
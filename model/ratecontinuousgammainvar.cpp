@@ -12,6 +12,7 @@ RateInvar(p_invar_sites), RateContinuousGamma(shape) {
 }
 
 void RateContinuousGammaInvar::setPInvar(double pInvar) {
+    bumpParamEpoch();
     p_invar = pInvar;
 }
 
@@ -96,6 +96,7 @@ void RateFree::saveCheckpoint() {
 }
 
 void RateFree::restoreCheckpoint() {
+    bumpParamEpoch();
 //    RateGamma::restoreCheckpoint();
     startCheckpoint();
 //    CKP_RESTORE(fix_params);
@@ -139,6 +140,7 @@ void RateFree::setNCategory(int ncat) {
 }
 
 void RateFree::initFromCatMinusOne() {
+    bumpParamEpoch();
     ncategory--;
     restoreCheckpoint();
     ncategory++;
@@ -384,6 +386,7 @@ void RateFree::setVariables(double *variables) {
 }
 
 bool RateFree::getVariables(double *variables) {
+	bumpParamEpoch();
 	if (getNDim() == 0) return false;
 	int i;
     bool changed = false;
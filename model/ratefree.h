@@ -59,7 +59,7 @@ public:
         @param category category ID from 0 to #category-1
         @return the proportion of the specified category
     */
-    virtual void setProp(int category, double value) {prop[category] = value;}
+    virtual void setProp(int category, double value) {prop[category] = value; bumpParamEpoch();}
 
 	/**
 		the target function which needs to be optimized
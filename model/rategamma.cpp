@@ -96,6 +96,8 @@ RateGamma::~RateGamma()
 }
 
 void RateGamma::computeRates() {
+	// cached transition terms of all trees are out of date
+	bumpParamEpoch();
 	int cat; /* category id */
 	double sum_rates = 0.0;
 	if (ncategory == 1) {
@@ -156,6 +158,7 @@ void RateGamma::computeRates() {
 }*/
 
 void RateGamma::computeRatesMean () {
+	bumpParamEpoch();
 	int i;
 	double lnga1=cmpLnGamma(gamma_shape+1);
 	double *freqK = new double[ncategory];
@@ -203,6 +206,7 @@ void RateGamma::setVariables(double *variables) {
 }
 
 bool RateGamma::getVariables(double *variables) {
+	bumpParamEpoch();
 	if (getNDim() == 0) return false;
     bool changed = (gamma_shape != variables[1]);
 	gamma_shape = variables[1];
@@ -110,7 +110,7 @@ public:
 		@param category category ID from 0 to #category-1
 		@param value the rate of the specified category
 	*/
-	virtual void setRate(int category, double value) { rates[category] = value; }
+	virtual void setRate(int category, double value) { rates[category] = value; bumpParamEpoch(); }
 
 	/**
 		get the proportion of sites under a specified category.
@@ -21,6 +21,8 @@
 #include "tree/phylotree.h"
 #include "rateheterogeneity.h"
 
+std::atomic<int64_t> RateHeterogeneity::param_epoch(0);
+
 
 RateHeterogeneity::RateHeterogeneity()
  : Optimization(), CheckpointFactory()
@@ -51,6 +53,7 @@ void RateHeterogeneity::saveCheckpoint() {
 }
 
 void RateHeterogeneity::restoreCheckpoint() {
+    bumpParamEpoch();
     startCheckpoint();
 //    CKP_RESTORE(name);
 //    CKP_RESTORE(full_name);
@@ -23,6 +23,7 @@
 
 #include "utils/optimization.h"
 #include <string>
+#include <atomic>
 #include "utils/tools.h"
 #include "utils/checkpoint.h"
 
@@ -58,6 +59,12 @@ public:
 	*/
     virtual ~RateHeterogeneity();
 
+    /** called whenever the rates or proportions of any rate heterogeneity model change */
+    static void bumpParamEpoch() { param_epoch++; }
+
+    /** @return number of parameter changes of all rate heterogeneity models, see PhyloTree::getModelEpoch() */
+    static int64_t getParamEpoch() { return param_epoch; }
+
     /**
         start structure for checkpointing
     */
@@ -323,6 +330,9 @@ public:
 
 protected:
 
+    /** parameter epoch shared by all rate heterogeneity models */
+    static std::atomic<int64_t> param_epoch;
+
 	/**
 		this function is served for the multi-dimension optimization. It should pack the model parameters
 		into a vector that is index from 1 (NOTE: not from 0)
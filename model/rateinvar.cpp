@@ -131,6 +131,7 @@ void RateInvar::setVariables(double *variables) {
 }
 
 bool RateInvar::getVariables(double *variables) {
+	bumpParamEpoch();
 	if (RateInvar::getNDim() == 0) return false;
     bool changed = (p_invar != variables[1]);
 	p_invar = variables[1];
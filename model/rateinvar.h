@@ -147,6 +147,7 @@ public:
 	*/
 	virtual void setPInvar(double pInvar) {
 		p_invar = pInvar;
+		bumpParamEpoch();
 	}
 
 	/**
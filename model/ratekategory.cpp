@@ -139,6 +139,7 @@ int RateKategory::computePatternRates(DoubleVector& pattern_rates, IntVector& pa
 
 bool RateKategory::getVariables(double* variables)
 {
+	bumpParamEpoch();
 	if (ncategory == 1) return false;
     bool changed = (rates[0] != 1.0);
 	rates[0] = 1.0;
@@ -151,6 +151,7 @@ void RateMeyerHaeseler::getRates(DoubleVector &rates) {
 }
 
 void RateMeyerHaeseler::setRates(DoubleVector &rates) {
+	bumpParamEpoch();
 	clear();
 	insert(begin(), rates.begin(), rates.end());
 }
@@ -0,0 +1,113 @@
+/*
+ * blockscheduler.cpp
+ * Work-stealing scheduler of pattern blocks for the likelihood kernels
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "blockscheduler.h"
+
+inline uint64_t packRange(uint64_t front, uint64_t back) {
+    return (front << 32) | back;
+}
+
+BlockScheduler::BlockScheduler() {
+    queues = NULL;
+    num_queues = 0;
+    num_blocks = block_size = num_elements = 0;
+}
+
+BlockScheduler::BlockScheduler(const BlockScheduler &other) : BlockScheduler() {
+}
+
+BlockScheduler &BlockScheduler::operator=(const BlockScheduler &other) {
+    return *this;
+}
+
+BlockScheduler::~BlockScheduler() {
+    delete [] queues;
+}
+
+void BlockScheduler::init(int threads, size_t elements, size_t grain, size_t min_block, size_t max_block) {
+    if (threads < 1)
+        threads = 1;
+    if (grain < 1)
+        grain = 1;
+    if (threads != num_queues) {
+        delete [] queues;
+        queues = new WorkQueue[threads];
+        num_queues = threads;
+    }
+    num_elements = elements;
+
+    // blocks are multiples of grain, small enough for stealing to balance the load
+    size_t max_blocks = (threads == 1) ? 1 : threads * BLOCKS_PER_THREAD;
+    block_size = (elements + max_blocks - 1) / max_blocks;
+    // tiles small enough to keep the vectors of one block in cache
+    if (max_block > 0 && block_size > max_block)
+        block_size = max_block;
+    if (block_size < min_block)
+        block_size = min_block;
+    if (block_size < 1)
+        block_size = 1;
+    block_size = ((block_size + grain - 1) / grain) * grain;
+    num_blocks = (elements + block_size - 1) / block_size;
+
+    // contiguous ranges of blocks for every thread
+    for (int i = 0; i < threads; i++) {
+        uint64_t front = num_blocks * i / threads;
+        uint64_t back = num_blocks * (i+1) / threads;
+        queues[i].range.store(packRange(front, back), std::memory_order_relaxed);
+        queues[i].steals = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+int64_t BlockScheduler::pop(int queue, bool front) {
+    std::atomic<uint64_t> &range = queues[queue].range;
+    uint64_t cur = range.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t first = cur >> 32, last = cur & 0xffffffff;
+        if (first >= last)
+            return -1;
+        uint64_t next = front ? packRange(first+1, last) : packRange(first, last-1);
+        if (range.compare_exchange_weak(cur, next, std::memory_order_acq_rel, std::memory_order_acquire))
+            return front ? first : last-1;
+    }
+}
+
+bool BlockScheduler::next(int thread, size_t &lower, size_t &upper) {
+    int64_t block = -1;
+    if (thread < num_queues)
+        block = pop(thread, true);
+    while (block < 0) {
+        // steal from the thread with most remaining blocks
+        int victim = -1;
+        uint64_t max_left = 0;
+        for (int i = 0; i < num_queues; i++) {
+            uint64_t cur = queues[i].range.load(std::memory_order_relaxed);
+            uint64_t first = cur >> 32, last = cur & 0xffffffff;
+            if (last > first && last - first > max_left) {
+                max_left = last - first;
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return false;
+        block = pop(victim, false);
+        if (block >= 0 && thread < num_queues)
+            queues[thread].steals++;
+    }
+    lower = block * block_size;
+    upper = lower + block_size;
+    if (upper > num_elements)
+        upper = num_elements;
+    return true;
+}
+
+size_t BlockScheduler::getNumSteals() {
+    size_t steals = 0;
+    for (int i = 0; i < num_queues; i++)
+        steals += queues[i].steals;
+    return steals;
+}
@@ -0,0 +1,87 @@
+/*
+ * blockscheduler.h
+ * Work-stealing scheduler of pattern blocks for the likelihood kernels
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef BLOCKSCHEDULER_H
+#define BLOCKSCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/** number of pattern blocks per thread for work stealing */
+#define BLOCKS_PER_THREAD 8
+
+/**
+    work-stealing distribution of pattern blocks among threads.
+    Every thread owns a contiguous range of blocks and takes blocks from its front.
+    A thread that runs out of work steals blocks from the back of the range of the
+    busiest other thread. Each task is one pattern block for all nodes of a traversal.
+*/
+class BlockScheduler {
+public:
+
+    BlockScheduler();
+
+    /** copies start empty, queues are never shared between trees */
+    BlockScheduler(const BlockScheduler &other);
+
+    BlockScheduler &operator=(const BlockScheduler &other);
+
+    ~BlockScheduler();
+
+    /**
+        distribute blocks among threads, must be called outside parallel region
+        @param threads number of threads
+        @param elements number of patterns
+        @param grain block size is a multiple of grain (SIMD vector size)
+        @param min_block minimum number of patterns per block
+        @param max_block maximum number of patterns per block (tile size), 0 for no limit
+    */
+    void init(int threads, size_t elements, size_t grain, size_t min_block = 0, size_t max_block = 0);
+
+    /**
+        get the next block for a thread
+        @param thread thread ID
+        @param[out] lower first pattern of the block
+        @param[out] upper last pattern of the block + 1
+        @return false if all blocks were taken
+    */
+    bool next(int thread, size_t &lower, size_t &upper);
+
+    /** number of blocks */
+    size_t getNumBlocks() { return num_blocks; }
+
+    /** number of patterns per block */
+    size_t getBlockSize() { return block_size; }
+
+    /** number of blocks taken from other threads since init */
+    size_t getNumSteals();
+
+protected:
+
+    /** pop one block from the front (owner) or the back (thief) of a queue, -1 if empty */
+    int64_t pop(int queue, bool front);
+
+    /** work queue of a thread, padded to a cache line to avoid false sharing */
+    struct WorkQueue {
+        /** front block ID in the upper, back block ID + 1 in the lower 32 bits */
+        std::atomic<uint64_t> range;
+        /** number of blocks stolen by the owner thread */
+        size_t steals;
+        char padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(size_t)];
+        WorkQueue() : range(0), steals(0) {}
+    };
+
+    /** one queue per thread */
+    WorkQueue *queues;
+
+    int num_queues;
+
+    size_t num_blocks, block_size, num_elements;
+};
+
+#endif // BLOCKSCHEDULER_H
@@ -236,9 +236,38 @@ int CandidateSet::update(string newTree, double newScore) {
     if ( size() >= maxSize && front!=end() && newScore < front->first ) {
         return -2;
     }
+    return insertCandidate(newTree, convertTreeString(newTree), newScore);
+}
+
+int CandidateSet::update(MTree &tree, double newScore) {
+    auto front = begin();
+    if ( size() >= maxSize && front!=end() && newScore < front->first ) {
+        return -2;
+    }
+    // root as in convertTreeString, so the topology is the tree string without branch lengths
+    string rootName = "0";
+    tree.root = tree.findLeafName(rootName);
+    ostringstream tree_str;
+    tree.printTree(tree_str, WT_TAXON_ID + WT_BR_LEN + WT_SORT_TAXA);
+    string newTree = tree_str.str();
+    string topology;
+    topology.reserve(newTree.size());
+    bool in_length = false;
+    for (char c : newTree) {
+        if (c == ':')
+            in_length = true;
+        else if (c == ',' || c == ')' || c == ';')
+            in_length = false;
+        if (!in_length)
+            topology += c;
+    }
+    return insertCandidate(newTree, topology, newScore);
+}
+
+int CandidateSet::insertCandidate(const string &newTree, const string &topology, double newScore) {
     CandidateTree candidate;
     candidate.score = newScore;
-    candidate.topology = convertTreeString(newTree);
+    candidate.topology = topology;
     candidate.tree = newTree;
 
     int treePos;
@@ -127,6 +127,15 @@ public:
      */
     int update(string newTree, double newScore);
 
+    /**
+     *  Add a tree that is already built, e.g. decoded from its binary form, the tree is printed
+     *  once and its topology is taken from that string instead of parsing it again
+     *  @param tree the new tree with taxon IDs, its root may be changed
+     *  @param newScore the score (ML or parsimony) of \a tree
+     *  @return the same as update(string, double)
+     */
+    int update(MTree &tree, double newScore);
+
     /**
      *  Get the \a numBestScores best scores in the candidate set
      *
@@ -361,6 +370,11 @@ public:
     }
 
 private:
+    /**
+     *  insert a tree whose topology string is computed, called by update()
+     */
+    int insertCandidate(const string &newTree, const string &topology, double newScore);
+
     /**
      *  Maximum number of candidate trees
      */
@@ -55,6 +55,7 @@ void IQTree::init() {
 //    enable_parsimony = false;
     estimate_nni_cutoff = false;
     nni_cutoff = -1e6;
+    nni_num_threads = 0;
     nni_sort = false;
     testNNI = false;
 //    print_tree_lh = false;
@@ -64,6 +65,7 @@ void IQTree::init() {
     len_scale = 10000;
 //    save_all_br_lens = false;
     duplication_counter = 0;
+    tree_send_skipped = false;
     //boot_splits = new SplitGraph;
     pll2iqtree_pattern_index = NULL;
 
@@ -99,8 +101,35 @@ void IQTree::setCheckpoint(Checkpoint *checkpoint) {
         (*it)->setCheckpoint(checkpoint);
 }
 
+/**
+    put a value unless the checkpoint already has it, so that a journaled
+    checkpoint only records the UFBoot trees and replicates that changed
+ */
+static void putUFBootValue(Checkpoint *checkpoint, const string &key, const string &value) {
+    string old_value;
+    if (!checkpoint->getString(key, old_value) || old_value != value)
+        checkpoint->put(key, value);
+}
+
 void IQTree::saveUFBoot(Checkpoint *checkpoint) {
     checkpoint->startStruct("UFBoot");
+    // each distinct tree is saved once, replicates refer to it by tree ID
+    checkpoint->startStruct("tree");
+    for (int tree_id = 0; tree_id < boot_trees.getMaxTreeID(); tree_id++)
+        if (boot_trees.getTreeCount(tree_id) > 0)
+            putUFBootValue(checkpoint, convertIntToString(tree_id), boot_trees.getTree(tree_id));
+        else
+            // no replicate has this tree any more
+            checkpoint->eraseKey(convertIntToString(tree_id));
+    // tree IDs beyond the current ones were saved before the trees were cleared
+    string prefix = checkpoint->getStructName();
+    StrVector stale_keys;
+    for (auto it = checkpoint->lower_bound(prefix); it != checkpoint->end() && it->first.compare(0, prefix.length(), prefix) == 0; it++)
+        if (convert_int(it->first.c_str() + prefix.length()) >= boot_trees.getMaxTreeID())
+            stale_keys.push_back(it->first.substr(prefix.length()));
+    for (auto key : stale_keys)
+        checkpoint->eraseKey(key);
+    checkpoint->endStruct();
     if (MPIHelper::getInstance().isWorker()) {
         CKP_SAVE(sample_start);
         CKP_SAVE(sample_end);
@@ -110,8 +139,10 @@ void IQTree::saveUFBoot(Checkpoint *checkpoint) {
             checkpoint->addListElement();
             stringstream ss;
             ss.precision(10);
-            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << boot_trees[id];
-            checkpoint->put("", ss.str());
+            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id];
+            if (boot_trees.getTreeID(id) >= 0)
+                ss << " " << boot_trees.getTreeID(id);
+            putUFBootValue(checkpoint, "", ss.str());
         }
         checkpoint->endList();
     } else {
@@ -123,8 +154,10 @@ void IQTree::saveUFBoot(Checkpoint *checkpoint) {
             checkpoint->addListElement();
             stringstream ss;
             ss.precision(10);
-            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << boot_trees[id];
-            checkpoint->put("", ss.str());
+            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id];
+            if (boot_trees.getTreeID(id) >= 0)
+                ss << " " << boot_trees.getTreeID(id);
+            putUFBootValue(checkpoint, "", ss.str());
         }
         checkpoint->endList();
     }
@@ -151,8 +184,43 @@ void IQTree::saveCheckpoint() {
     CKP_SAVE(contree_rfdist);
 }
 
+void IQTree::restoreUFBootTrees(Checkpoint *checkpoint, StrVector &saved_trees) {
+    Checkpoint tree_ckp;
+    checkpoint->getSubCheckpoint(&tree_ckp, checkpoint->getStructName() + "tree");
+    saved_trees.clear();
+    for (auto it = tree_ckp.begin(); it != tree_ckp.end(); it++) {
+        int tree_id = convert_int(it->first.c_str());
+        if (tree_id >= saved_trees.size())
+            saved_trees.resize(tree_id+1);
+        saved_trees[tree_id] = it->second;
+    }
+}
+
+void IQTree::restoreUFBootSample(int sample, const string &value, StrVector &saved_trees, IntVector &tree_ids) {
+    stringstream ss(value);
+    string tree;
+    ss >> boot_counts[sample] >> boot_logl[sample] >> boot_orig_logl[sample] >> tree;
+    if (tree.empty()) {
+        boot_trees.setTreeID(sample, -1);
+    } else if (tree[0] == '(') {
+        // checkpoint from older versions with a NEWICK string per replicate
+        boot_trees.set(sample, tree);
+    } else {
+        int saved_id = convert_int(tree.c_str());
+        ASSERT(saved_id < saved_trees.size() && !saved_trees[saved_id].empty());
+        if (tree_ids.size() < saved_trees.size())
+            tree_ids.resize(saved_trees.size(), -1);
+        if (tree_ids[saved_id] < 0)
+            tree_ids[saved_id] = boot_trees.intern(saved_trees[saved_id]);
+        boot_trees.setTreeID(sample, tree_ids[saved_id]);
+    }
+}
+
 void IQTree::restoreUFBoot(Checkpoint *checkpoint) {
     checkpoint->startStruct("UFBoot");
+    StrVector saved_trees;
+    IntVector tree_ids;
+    restoreUFBootTrees(checkpoint, saved_trees);
     // save boot_samples and boot_trees
     int id;
     checkpoint->startList(params->gbo_replicates);
@@ -165,8 +233,7 @@ void IQTree::restoreUFBoot(Checkpoint *checkpoint) {
         string str;
         checkpoint->getString("", str);
         ASSERT(!str.empty());
-        stringstream ss(str);
-        ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+        restoreUFBootSample(id, str, saved_trees, tree_ids);
     }
     checkpoint->endList();
     checkpoint->endStruct();
@@ -181,6 +248,9 @@ void IQTree::restoreCheckpoint() {
         checkpoint->startStruct("UFBoot");
 //        CKP_RESTORE(max_candidate_trees);
         CKP_RESTORE(logl_cutoff);
+        StrVector saved_trees;
+        IntVector tree_ids;
+        restoreUFBootTrees(checkpoint, saved_trees);
         // save boot_samples and boot_trees
         int id = 0;
         checkpoint->startList(params->gbo_replicates);
@@ -192,8 +262,7 @@ void IQTree::restoreCheckpoint() {
             checkpoint->addListElement();
             string str;
             checkpoint->getString("", str);
-            stringstream ss(str);
-            ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+            restoreUFBootSample(id, str, saved_trees, tree_ids);
         }
         checkpoint->endList();
         int boot_splits_size = 0;
@@ -345,7 +414,8 @@ void IQTree::initSettings(Params &params) {
 //        cout << "Generating " << params.gbo_replicates << " samples for ultrafast "
 //             << RESAMPLE_NAME << " (seed: " << params.ran_seed << ")..." << endl;
         // allocate memory for boot_samples
-        boot_samples.resize(params.gbo_replicates);
+        size_t orig_nptn = getAlnNPattern();
+        boot_samples.init(params.gbo_replicates, orig_nptn);
         sample_start = 0;
         sample_end = boot_samples.size();
 
@@ -360,24 +430,15 @@ void IQTree::initSettings(Params &params) {
                 sample_end = boot_samples.size();
         }
 
-        size_t orig_nptn = getAlnNPattern();
-#ifdef BOOT_VAL_FLOAT
-        size_t nptn = get_safe_upper_limit_float(orig_nptn);
-#else
-        size_t nptn = get_safe_upper_limit(orig_nptn);
-#endif
-        BootValType *mem = aligned_alloc<BootValType>(nptn * (size_t)(params.gbo_replicates));
-        memset(mem, 0, nptn * (size_t)(params.gbo_replicates) * sizeof(BootValType));
-        for (i = 0; i < params.gbo_replicates; i++)
-            boot_samples[i] = mem + i*nptn;
 
         if (boot_trees.empty()) {
             boot_logl.resize(params.gbo_replicates, -DBL_MAX);
             boot_orig_logl.resize(params.gbo_replicates, -DBL_MAX);
-            boot_trees.resize(params.gbo_replicates, "");
+            boot_trees.resize(params.gbo_replicates);
             boot_counts.resize(params.gbo_replicates, 0);
         } else {
-            cout << "CHECKPOINT: " << boot_trees.size() << " UFBoot trees and " << boot_splits.size() << " UFBootSplits restored" << endl;
+            cout << "CHECKPOINT: " << boot_trees.size() << " UFBoot trees (" << boot_trees.getNumTrees()
+                 << " distinct) and " << boot_splits.size() << " UFBootSplits restored" << endl;
         }
         VerboseMode saved_mode = verbose_mode;
         verbose_mode = VB_QUIET;
@@ -390,15 +451,13 @@ void IQTree::initSettings(Params &params) {
                     bootstrap_alignment = new Alignment;
                 IntVector this_sample;
                 bootstrap_alignment->createBootstrapAlignment(aln, &this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                boot_samples.setReplicate(i, &this_sample[0]);
                 bootstrap_alignment->printAlignment(params.aln_output_format, bootaln_name.c_str(), true);
                 delete bootstrap_alignment;
             } else {
                 IntVector this_sample;
                 aln->createBootstrapAlignment(this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                boot_samples.setReplicate(i, &this_sample[0]);
             }
         }
         verbose_mode = saved_mode;
@@ -418,9 +477,9 @@ void IQTree::initSettings(Params &params) {
         if(params.ufboot2corr){
             boot_samples_int.resize(params.gbo_replicates);
             for (size_t i = 0; i < params.gbo_replicates; i++) {
-                boot_samples_int[i].resize(nptn, 0);
+                boot_samples_int[i].resize(get_safe_upper_limit_float(orig_nptn), 0);
                 for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples_int[i][j] = boot_samples[i][j];
+                    boot_samples_int[i][j] = boot_samples.getCount(i, j);
                }
         }
 
@@ -445,10 +504,7 @@ IQTree::~IQTree() {
     boot_splits.clear();
     //if (boot_splits) delete boot_splits;
 
-    if (!boot_samples.empty()) {
-        aligned_free(boot_samples[0]); // free memory
-        boot_samples.clear();
-    }
+    boot_samples.clear();
 }
 
 extern const char *aa_model_names_rax[];
@@ -674,26 +730,39 @@ void IQTree::computeInitialTree(LikelihoodKernel kernel, istream* in) {
 int IQTree::addTreeToCandidateSet(string treeString, double score, bool updateStopRule, int sourceProcID) {
     double curBestScore = candidateTrees.getBestScore();
     int pos = candidateTrees.update(treeString, score);
-    if (updateStopRule) {
-        stop_rule.setCurIt(stop_rule.getCurIt() + 1);
-        if (score > curBestScore) {
-            if (pos != -1) {
-                stop_rule.addImprovedIteration(stop_rule.getCurIt());
-                cout << "BETTER TREE FOUND at iteration " << stop_rule.getCurIt() << ": " << score << endl;
-            } else {
-                cout << "UPDATE BEST LOG-LIKELIHOOD: " << score << endl;
-            }
-            bestcandidate_changed = true;
-            // COMMENT OUT: not safe with MPI version
-//            printResultTree();
-        }
+    if (updateStopRule)
+        countCandidateIteration(pos, score, curBestScore, sourceProcID);
+    return pos;
+}
 
-        curScore = score;
-        printIterationInfo(sourceProcID);
-    }
+int IQTree::addBinaryTreeToCandidateSet(const string &tree_bin, double score, bool updateStopRule, int sourceProcID) {
+    MTree tree;
+    tree.decodeTree(tree_bin.c_str(), tree_bin.size());
+    double curBestScore = candidateTrees.getBestScore();
+    int pos = candidateTrees.update(tree, score);
+    if (updateStopRule)
+        countCandidateIteration(pos, score, curBestScore, sourceProcID);
     return pos;
 }
 
+void IQTree::countCandidateIteration(int pos, double score, double curBestScore, int sourceProcID) {
+    stop_rule.setCurIt(stop_rule.getCurIt() + 1);
+    if (score > curBestScore) {
+        if (pos != -1) {
+            stop_rule.addImprovedIteration(stop_rule.getCurIt());
+            cout << "BETTER TREE FOUND at iteration " << stop_rule.getCurIt() << ": " << score << endl;
+        } else {
+            cout << "UPDATE BEST LOG-LIKELIHOOD: " << score << endl;
+        }
+        bestcandidate_changed = true;
+        // COMMENT OUT: not safe with MPI version
+//        printResultTree();
+    }
+
+    curScore = score;
+    printIterationInfo(sourceProcID);
+}
+
 void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
 
     if (nParTrees > 0) {
@@ -806,18 +875,48 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
         cout << "Computing log-likelihood of " << initTreeStrings.size() - init_size << " initial trees ... ";
     startTime = getRealTime();
 
-    for (vector<string>::iterator it = initTreeStrings.begin(); it != initTreeStrings.end(); ++it) {
-        string treeString;
-        double score;
-        readTreeString(*it);
-        if (it-initTreeStrings.begin() >= init_size)
-            treeString = optimizeBranches(params->brlen_num_traversal);
-        else {
-            computeLogL();
-            treeString = getTreeString();
+    int num_workers = getNumTreeWorkers(initTreeStrings.size(), false);
+    if (num_workers > 1) {
+        // score the trees concurrently, then add them in the original order
+        vector<string> treeStrings(initTreeStrings.size());
+        DoubleVector scores(initTreeStrings.size());
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(num_workers)
+#endif
+        {
+            IQTree *worker = newTreeWorker();
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+            for (int i = 0; i < initTreeStrings.size(); i++) {
+                worker->readTreeString(initTreeStrings[i]);
+                worker->initializeAllPartialLh();
+                if (i >= init_size)
+                    treeStrings[i] = worker->optimizeBranches(params->brlen_num_traversal);
+                else {
+                    worker->computeLogL();
+                    treeStrings[i] = worker->getTreeString();
+                }
+                scores[i] = worker->getCurScore();
+            }
+            deleteTreeWorker(worker);
+        }
+        for (int i = 0; i < initTreeStrings.size(); i++)
+            candidateTrees.update(treeStrings[i], scores[i]);
+    } else {
+        for (vector<string>::iterator it = initTreeStrings.begin(); it != initTreeStrings.end(); ++it) {
+            string treeString;
+            double score;
+            readTreeString(*it);
+            if (it-initTreeStrings.begin() >= init_size)
+                treeString = optimizeBranches(params->brlen_num_traversal);
+            else {
+                computeLogL();
+                treeString = getTreeString();
+            }
+            score = getCurScore();
+            candidateTrees.update(treeString,score);
         }
-        score = getCurScore();
-        candidateTrees.update(treeString,score);
     }
 
     if (Params::getInstance().writeDistImdTrees)
@@ -847,15 +946,60 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
     candidateTrees.setMaxSize(Params::getInstance().numSupportTrees);
     vector<string>::iterator it;
 
-    for (it = bestInitTrees.begin(); it != bestInitTrees.end(); it++) {
-        readTreeString(*it);
-//        optimizeBranches();
-//        cout << "curScore: " << curScore << "  Tree before NNI: " << getTreeString() << endl;
-        doNNISearch();
-        string treeString = getTreeString();
-        addTreeToCandidateSet(treeString, curScore, true, MPIHelper::getInstance().getProcessID());
-        if (Params::getInstance().writeDistImdTrees)
-            intermediateTrees.update(treeString, curScore);
+    num_workers = getNumTreeWorkers(bestInitTrees.size(), true);
+    if (num_workers > 1) {
+        // NNI-polish the trees concurrently under the current model, which is then
+        // re-optimized once on the best polished tree instead of after every improvement
+        double curBestScore = getBestScore();
+        vector<string> treeStrings(bestInitTrees.size());
+        DoubleVector scores(bestInitTrees.size());
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(num_workers)
+#endif
+        {
+            IQTree *worker = newTreeWorker();
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+            for (int i = 0; i < bestInitTrees.size(); i++) {
+                worker->readTreeString(bestInitTrees[i]);
+                worker->initializeAllPartialLh();
+                worker->computeLogL();
+                worker->prepareToComputeDistances();
+                worker->optimizeNNI(Params::getInstance().speednni);
+                worker->doneComputingDistances();
+                treeStrings[i] = worker->getTreeString();
+                scores[i] = worker->getCurScore();
+            }
+            deleteTreeWorker(worker);
+        }
+        int best = 0;
+        for (int i = 0; i < bestInitTrees.size(); i++) {
+            addTreeToCandidateSet(treeStrings[i], scores[i], true, MPIHelper::getInstance().getProcessID());
+            MPIHelper::getInstance().setNumNNISearch(MPIHelper::getInstance().getNumNNISearch() + 1);
+            if (scores[i] > scores[best])
+                best = i;
+        }
+        if (!bestInitTrees.empty() && scores[best] > curBestScore + params->modelEps) {
+            readTreeString(treeStrings[best]);
+            computeLogL();
+            optimizeModelParameters(false, params->modelEps * 10);
+            getModelFactory()->saveCheckpoint();
+            if (rooted && params->root_move_dist > 0)
+                optimizeRootPosition(params->root_move_dist, true, params->modelEps * 10);
+            addTreeToCandidateSet(getTreeString(), curScore, true, MPIHelper::getInstance().getProcessID());
+        }
+    } else {
+        for (it = bestInitTrees.begin(); it != bestInitTrees.end(); it++) {
+            readTreeString(*it);
+//            optimizeBranches();
+//            cout << "curScore: " << curScore << "  Tree before NNI: " << getTreeString() << endl;
+            doNNISearch();
+            string treeString = getTreeString();
+            addTreeToCandidateSet(treeString, curScore, true, MPIHelper::getInstance().getProcessID());
+            if (Params::getInstance().writeDistImdTrees)
+                intermediateTrees.update(treeString, curScore);
+        }
     }
 
     // TODO turning this
@@ -881,6 +1025,38 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
 
 }
 
+int IQTree::getNumTreeWorkers(int ntrees, bool nni_search) {
+    int num_workers = min(params->init_tree_workers, min(num_threads, ntrees));
+    // workers keep no per-tree output files, PLL instance or partition-wise trees
+    if (num_workers <= 1 || params->pll || isSuperTree() || isMixlen() || isTreeMix() ||
+        params->print_tree_lh || params->write_intermediate_trees)
+        return 1;
+    // NNI search of a worker must not depend on state only this tree has
+    if (nni_search && (on_refine_btree || save_all_trees == 2 || params->fixStableSplits ||
+        params->writeDistImdTrees || params->print_trees_site_posterior || !initTabuSplits.empty()))
+        return 1;
+    return num_workers;
+}
+
+IQTree *IQTree::newTreeWorker() {
+    IQTree *worker = new IQTree(aln);
+    worker->setParams(params);
+    if (!constraintTree.empty())
+        worker->constraintTree.readConstraint(constraintTree);
+    worker->rooted = rooted;
+    worker->sse = sse;
+    worker->setNumThreads(1);
+    worker->setModelFactory(getModelFactory());
+    return worker;
+}
+
+void IQTree::deleteTreeWorker(IQTree *worker) {
+    worker->setModelFactory(NULL);
+    worker->setModel(NULL);
+    worker->setRate(NULL);
+    delete worker;
+}
+
 string IQTree::generateParsimonyTree(int randomSeed) {
     string parsimonyTreeString;
     if (params->start_tree == STT_PLL_PARSIMONY) {
@@ -2591,7 +2767,7 @@ void IQTree::refineBootTrees(){
         stringstream ostr;
         printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
         tree = ostr.str();
-        boot_trees[sample] = getTreeString();
+        boot_trees.set(sample, getTreeString());
         boot_logl[sample] = curScore;
 
         printTree(btreea, WT_NEWLINE | WT_SORT_TAXA);
@@ -2783,7 +2959,7 @@ void IQTree::refineBootTrees() {
             boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_LEN_SHORT);
         else
             boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        boot_trees[sample] = ostr.str();
+        boot_trees.set(sample, ostr.str());
         boot_logl[sample] = boot_tree->curScore;
 
 
@@ -3273,7 +3449,7 @@ void IQTree::pllInitUFBootData(){
                 if(!pllUFBootDataPtr->boot_samples[i]) outError("Not enough dynamic memory!");
                 for(int j = 0; j < pllAlignment->sequenceLength; j++){
                     pllUFBootDataPtr->boot_samples[i][j] =
-                        boot_samples[i][pll2iqtree_pattern_index[j]];
+                        boot_samples.getCount(i, pll2iqtree_pattern_index[j]);
                 }
             }
 
@@ -3424,6 +3600,18 @@ void IQTree::setDelete(int _delete) {
 }
 
 void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs) {
+    int saved_num_threads = num_threads;
+    bool change_threads = !isSuperTree() && num_threads > 1 && params->nni_num_threads != 0;
+    if (change_threads && nni_num_threads == 0) {
+        if (params->nni_num_threads > 0)
+            nni_num_threads = min(params->nni_num_threads, num_threads);
+        else
+            // measure before the loop below, which may synchronize trees with MPI workers
+            tuneNNIThreads(nniBranches);
+    }
+    if (change_threads && nni_num_threads > 0)
+        setNumThreads(nni_num_threads);
+
     for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end(); it++) {
         NNIMove nni = getBestNNIForBran((PhyloNode*) it->second.first, (PhyloNode*) it->second.second, NULL);
         if (nni.newloglh > curScore) {
@@ -3436,6 +3624,50 @@ void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs)
             syncCurrentTree();
         }
     }
+
+    if (change_threads)
+        setNumThreads(saved_num_threads);
+}
+
+void IQTree::tuneNNIThreads(Branches &nniBranches) {
+    vector<pair<PhyloNode*, PhyloNode*> > sample;
+    for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end() && sample.size() < NNI_BATCH_SIZE; it++)
+        sample.push_back(make_pair((PhyloNode*) it->second.first, (PhyloNode*) it->second.second));
+    if (sample.empty())
+        return;
+
+    int saved_num_threads = num_threads;
+    int saved_save_all_trees = save_all_trees;
+    save_all_trees = 0;
+    int best_threads = num_threads;
+    double best_time = DBL_MAX;
+    for (int threads = num_threads; threads >= 1; threads /= 2) {
+        setNumThreads(threads);
+        // fastest of several windows, so that a single slow window does not decide
+        double min_time = DBL_MAX;
+        for (int rep = 0; rep < NNI_TUNE_REPS; rep++) {
+            size_t num_evals = 0;
+            double start_time = getRealTime(), elapsed;
+            do {
+                for (auto &bran : sample)
+                    getBestNNIForBran(bran.first, bran.second, NULL);
+                num_evals += sample.size();
+                elapsed = getRealTime() - start_time;
+            } while (elapsed < NNI_TUNE_MIN_TIME);
+            min_time = min(min_time, elapsed / num_evals);
+        }
+        if (min_time >= best_time)
+            break;
+        best_time = min_time;
+        best_threads = threads;
+    }
+    setNumThreads(saved_num_threads);
+    save_all_trees = saved_save_all_trees;
+
+    nni_num_threads = best_threads;
+    if (verbose_mode >= VB_MED)
+        cout << "Evaluating NNIs with " << nni_num_threads << " threads ("
+            << best_time * 1000.0 << " ms per branch)" << endl;
 }
 
 //Branches IQTree::getReducedListOfNNIBranches(Branches &previousNNIBranches) {
@@ -3593,6 +3825,10 @@ void IQTree::saveCurrentTree(double cur_logl) {
         else
             printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA);
         tree_str = ostr.str();
+        // replicates improved by this tree, which is stored once after the loop
+        vector<char> improved(sample_end, 0);
+        // RELL log-likelihoods of all replicates of this process
+        DoubleVector rells(sample_end - sample_start);
 
     #ifdef _OPENMP
         int rand_seed = random_int(1000);
@@ -3600,21 +3836,18 @@ void IQTree::saveCurrentTree(double cur_logl) {
         {
         int *rstream;
         init_random(rand_seed + omp_get_thread_num(), false, &rstream);
-        #pragma omp for
+        #pragma omp for schedule(static)
     #else
         int *rstream = randstream;
+    #endif
+        for (int start = sample_start; start < sample_end; start += RELL_REPLICATE_BLOCK)
+            boot_samples.computeRELL(this, pattern_lh, start, min(start + RELL_REPLICATE_BLOCK, sample_end),
+                &rells[start - sample_start]);
+    #ifdef _OPENMP
+        #pragma omp for
     #endif
         for (int sample = sample_start; sample < sample_end; sample++) {
-            double rell = 0.0;
-
-            {
-                // SSE optimized version of the above loop
-                BootValType *boot_sample = boot_samples[sample];
-
-                BootValType res = (this->*dotProduct)(pattern_lh, boot_sample, nptn);
-
-                rell = res;
-            }
+            double rell = rells[sample - sample_start];
 
             bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
             if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
@@ -3628,13 +3861,20 @@ void IQTree::saveCurrentTree(double cur_logl) {
                 }
                 boot_logl[sample] = max(boot_logl[sample], rell);
                 boot_orig_logl[sample] = cur_logl;
-                boot_trees[sample] = tree_str;
+                improved[sample] = 1;
             }
         }
     #ifdef _OPENMP
         finish_random(rstream);
         }
     #endif
+        int tree_id = -1;
+        for (int sample = sample_start; sample < sample_end; sample++)
+            if (improved[sample]) {
+                if (tree_id < 0)
+                    tree_id = boot_trees.intern(tree_str);
+                boot_trees.setTreeID(sample, tree_id);
+            }
     }
     if (Params::getInstance().print_tree_lh) {
         out_treelh << cur_logl;
@@ -3792,7 +4032,12 @@ void IQTree::writeUFBootTrees(Params &params) {
     ofstream out(filename.c_str());
 
     trees.init(boot_trees, rooted);
-    for (i = 0; i < trees.size(); i++) {
+    // each distinct tree is converted once, MTreeSet::init() keeps the order of tree IDs
+    StrVector tree_strs(boot_trees.getMaxTreeID());
+    i = 0;
+    for (int tree_id = 0; tree_id < boot_trees.getMaxTreeID(); tree_id++) {
+        if (boot_trees.getTreeCount(tree_id) == 0)
+            continue;
         NodeVector taxa;
         // change the taxa name from ID to real name
         trees[i]->getOrderedTaxa(taxa);
@@ -3802,13 +4047,18 @@ void IQTree::writeUFBootTrees(Params &params) {
             // reinsert removed seqs into each tree
             trees[i]->insertTaxa(removed_seqs, twin_seqs);
         }
-        // now print to file
-        for (j = 0; j < trees.tree_weights[i]; j++)
-            if (params.print_ufboot_trees == 1)
-                trees[i]->printTree(out, WT_NEWLINE);
-            else
-                trees[i]->printTree(out, WT_NEWLINE + WT_BR_LEN);
-    }
+        stringstream ss;
+        if (params.print_ufboot_trees == 1)
+            trees[i]->printTree(ss, WT_NEWLINE);
+        else
+            trees[i]->printTree(ss, WT_NEWLINE + WT_BR_LEN);
+        tree_strs[tree_id] = ss.str();
+        i++;
+    }
+    // now print to file, one tree per replicate in the order of replicates
+    for (size_t sample = 0; sample < boot_trees.size(); sample++)
+        if (boot_trees.getTreeID(sample) >= 0)
+            out << tree_strs[boot_trees.getTreeID(sample)];
     cout << "UFBoot trees printed to " << filename << endl;
     out.close();
 }
@@ -3903,9 +4153,9 @@ void IQTree::computeRootstrap(MTreeSet &trees, bool use_taxid) {
             if (other.shouldInvert())
                 other.invert();
             // count how often both splits occur in the tree set
-            for (auto splits : ssvec) {
-                if (splits.findSplit(sg[i]) && splits.findSplit(&other)) {
-                    rootstrap++;
+            for (int j = 0; j < ssvec.size(); j++) {
+                if (ssvec[j].findSplit(sg[i]) && ssvec[j].findSplit(&other)) {
+                    rootstrap += trees.tree_weights[j];
                 }
             }
 
@@ -3931,16 +4181,16 @@ void IQTree::computeRootstrap(MTreeSet &trees, bool use_taxid) {
             }
             
             // count how often both splits occur in the tree set
-            for (auto splits : ssvec) {
-                if (splits.findSplit(left) && splits.findSplit(right)) {
-                    rootstrap++;
+            for (int j = 0; j < ssvec.size(); j++) {
+                if (ssvec[j].findSplit(left) && ssvec[j].findSplit(right)) {
+                    rootstrap += trees.tree_weights[j];
                 }
             }
             delete right;
             delete left;
         }
         
-        double rootstrap_dbl = (double)rootstrap*100.0 / trees.size();
+        double rootstrap_dbl = (double)rootstrap*100.0 / trees.sumTreeWeights();
         //branch.first->findNeighbor(branch.second)->putAttr("rootstrap", rootstrap_dbl);
         Neighbor *nei = branch.second->findNeighbor(branch.first);
         nei->putAttr("rootstrap", rootstrap_dbl);
@@ -4133,8 +4383,9 @@ void IQTree::pllConvertUFBootData2IQTree(){
 
     //boot_trees
     boot_trees.clear();
+    boot_trees.resize(params->gbo_replicates);
     for(int i = 0; i < params->gbo_replicates; i++)
-        boot_trees.push_back(pllUFBootDataPtr->boot_trees[i]);
+        boot_trees.set(i, pllUFBootDataPtr->boot_trees[i]);
 
 }
 
@@ -4343,7 +4594,10 @@ void IQTree::syncCandidateTrees(int nTrees, bool updateStopRule) {
 
     Checkpoint *ckp = new Checkpoint;
 
-    if (MPIHelper::getInstance().isMaster()) {
+    if (params->mpi_async) {
+        // master does not receive from every worker one after another
+        gatherCandidateTreesHierarchical(updateStopRule);
+    } else if (MPIHelper::getInstance().isMaster()) {
         // update candidate set at master
         int trees = 0;
         for (int w = 1; w < MPIHelper::getInstance().getNumProcesses(); w++) {
@@ -4357,14 +4611,6 @@ void IQTree::syncCandidateTrees(int nTrees, bool updateStopRule) {
             ckp->clear();
         }
         cout << "Master: " << trees << " candidate trees gathered from workers" << endl;
-        // get the best candidate trees
-        int numTrees = max(nTrees, MPIHelper::getInstance().getNumProcesses());
-        CandidateSet bestCandidates = candidateTrees.getBestCandidateTrees(numTrees);
-        int saved_numNNITrees = params->numNNITrees;
-        params->numNNITrees = numTrees;
-        bestCandidates.setCheckpoint(ckp);
-        bestCandidates.saveCheckpoint();
-        params->numNNITrees = saved_numNNITrees;
     } else {
         // send candidate set to master
         CandidateSet cset = candidateTrees.getBestCandidateTrees();
@@ -4375,6 +4621,17 @@ void IQTree::syncCandidateTrees(int nTrees, bool updateStopRule) {
         ckp->clear();
     }
 
+    if (MPIHelper::getInstance().isMaster()) {
+        // get the best candidate trees
+        int numTrees = max(nTrees, MPIHelper::getInstance().getNumProcesses());
+        CandidateSet bestCandidates = candidateTrees.getBestCandidateTrees(numTrees);
+        int saved_numNNITrees = params->numNNITrees;
+        params->numNNITrees = numTrees;
+        bestCandidates.setCheckpoint(ckp);
+        bestCandidates.saveCheckpoint();
+        params->numNNITrees = saved_numNNITrees;
+    }
+
     if (updateStopRule && stop_rule.meetStopCondition(stop_rule.getCurIt(), 0.0)) {
         // 2020-04-30: send stop signal
         ckp->putBool("stop", true);
@@ -4403,22 +4660,80 @@ void IQTree::syncCandidateTrees(int nTrees, bool updateStopRule) {
 #endif
 }
 
+void IQTree::gatherCandidateTreesHierarchical(bool updateStopRule) {
+#ifdef _IQTREE_MPI
+    int proc = MPIHelper::getInstance().getProcessID();
+    int num_procs = MPIHelper::getInstance().getNumProcesses();
+    Checkpoint *ckp = new Checkpoint;
+    // number of trees each process of this subtree would send to the master in blocking mode,
+    // merged sets are smaller, so the master counts the missing trees as iterations for the stop rule
+    IntVector worker_trees(num_procs, 0);
+    if (!MPIHelper::getInstance().isMaster())
+        worker_trees[proc] = min(Params::getInstance().numNNITrees, (int)candidateTrees.getBestCandidateTrees().size());
+    // in round i, processes with a multiple of 2*step receive from proc+step,
+    // the others send to proc-step and are done, master finishes after log2(num_procs) rounds
+    for (int step = 1; step < num_procs; step *= 2) {
+        if (proc % (2*step) == 0) {
+            int child = proc + step;
+            if (child >= num_procs)
+                continue;
+            MPIHelper::getInstance().recvCheckpoint(ckp, child, CAND_TAG);
+            CandidateSet cset;
+            cset.setCheckpoint(ckp);
+            cset.restoreCheckpoint();
+            bool count_iterations = updateStopRule && MPIHelper::getInstance().isMaster();
+            for (CandidateSet::iterator it = cset.begin(); it != cset.end(); it++)
+                addTreeToCandidateSet(it->second.tree, it->second.score, count_iterations, child);
+            IntVector child_trees;
+            ckp->getVector("worker_trees", child_trees);
+            int num_child_trees = 0;
+            for (int w = 0; w < child_trees.size() && w < num_procs; w++) {
+                worker_trees[w] += child_trees[w];
+                num_child_trees += child_trees[w];
+            }
+            if (count_iterations && num_child_trees > cset.size())
+                stop_rule.setCurIt(stop_rule.getCurIt() + num_child_trees - cset.size());
+            ckp->clear();
+        } else {
+            // send the merged candidate set to the parent
+            CandidateSet cset = candidateTrees.getBestCandidateTrees();
+            cset.setCheckpoint(ckp);
+            cset.saveCheckpoint();
+            ckp->putVector("worker_trees", worker_trees);
+            MPIHelper::getInstance().sendCheckpoint(ckp, proc - step, CAND_TAG);
+            ckp->clear();
+            break;
+        }
+    }
+    if (MPIHelper::getInstance().isMaster()) {
+        int trees = 0;
+        for (auto num : worker_trees)
+            trees += num;
+        cout << "Master: " << trees << " candidate trees gathered hierarchically from workers" << endl;
+    }
+    delete ckp;
+#endif
+}
+
 void IQTree::syncCurrentTree() {
     if (MPIHelper::getInstance().getNumProcesses() == 1)
         return;
 #ifdef _IQTREE_MPI
+    if (params->mpi_async) {
+        syncCurrentTreeAsync();
+        return;
+    }
     //------ BLOCKING COMMUNICATION ------//
     Checkpoint *checkpoint = new Checkpoint;
-    string tree;
+    string tree_bin;
     double score;
 
     if (MPIHelper::getInstance().isMaster()) {
         // master: receive tree from WORKERS
-        int worker = MPIHelper::getInstance().recvCheckpoint(checkpoint);
+        int worker = MPIHelper::getInstance().recvCheckpoint(checkpoint, MPI_ANY_SOURCE, TREE_TAG, &tree_bin);
         MPIHelper::getInstance().increaseTreeReceived();
-        CKP_RESTORE(tree);
         CKP_RESTORE(score);
-        int pos = addTreeToCandidateSet(tree, score, true, worker);
+        int pos = addBinaryTreeToCandidateSet(tree_bin, score, true, worker);
         if (pos >= 0 && pos < params->popSize) {
             // candidate set is changed, update for other workers
             for (int w = 0; w < candidateset_changed.size(); w++)
@@ -4443,15 +4758,14 @@ void IQTree::syncCurrentTree() {
         }
         MPIHelper::getInstance().sendCheckpoint(checkpoint, worker);
     } else {
-        // worker: always send tree to MASTER
-        tree = getTreeString();
+        // worker: always send tree to MASTER, in binary form to save parsing newick at MASTER
+        getTreeBinary(tree_bin);
         score = curScore;
-        CKP_SAVE(tree);
         CKP_SAVE(score);
         if (boot_samples.size() > 0) {
             saveUFBoot(checkpoint);
         }
-        MPIHelper::getInstance().sendCheckpoint(checkpoint, PROC_MASTER);
+        MPIHelper::getInstance().sendCheckpoint(checkpoint, PROC_MASTER, TREE_TAG, tree_bin);
         MPIHelper::getInstance().increaseTreeSent();
 
         // now receive the candidate set
@@ -4476,6 +4790,99 @@ void IQTree::syncCurrentTree() {
 #endif
 }
 
+void IQTree::syncCurrentTreeAsync() {
+#ifdef _IQTREE_MPI
+    //------ NON-BLOCKING COMMUNICATION ------//
+    Checkpoint *checkpoint = new Checkpoint;
+    string tree_bin;
+    double score;
+
+    if (MPIHelper::getInstance().isMaster()) {
+        // master: merge all trees that have arrived from WORKERS so far
+        int worker;
+        while ((worker = MPIHelper::getInstance().tryRecvCheckpoint(checkpoint, MPI_ANY_SOURCE, &tree_bin)) >= 0) {
+            MPIHelper::getInstance().increaseTreeReceived();
+            CKP_RESTORE(score);
+            int pos = addBinaryTreeToCandidateSet(tree_bin, score, true, worker);
+            if (pos >= 0 && pos < params->popSize) {
+                // candidate set is changed, update for other workers
+                for (int w = 0; w < candidateset_changed.size(); w++)
+                    if (w != worker)
+                        candidateset_changed[w] = true;
+            }
+
+            if (boot_samples.size() > 0) {
+                restoreUFBoot(checkpoint);
+            }
+
+            // only answer if the worker is outdated, it does not wait for it. While the previous
+            // answer is on the way, the next one is skipped and candidateset_changed is kept
+            checkpoint->clear();
+            if ((candidateset_changed[worker] || boot_samples.size() > 0) &&
+                !MPIHelper::getInstance().isSendPending(worker)) {
+                if (boot_samples.size() > 0)
+                    CKP_SAVE(logl_cutoff);
+                if (candidateset_changed[worker]) {
+                    CandidateSet cset = candidateTrees.getBestCandidateTrees(Params::getInstance().popSize);
+                    cset.setCheckpoint(checkpoint);
+                    cset.saveCheckpoint();
+                    candidateset_changed[worker] = false;
+                    MPIHelper::getInstance().increaseTreeSent(Params::getInstance().popSize);
+                }
+                MPIHelper::getInstance().isendCheckpoint(checkpoint, worker);
+                checkpoint->clear();
+            }
+        }
+    } else {
+        // worker: send tree to MASTER and continue, unless the previous tree is still on the way;
+        // the next tree then also carries the UFBoot state of this iteration
+        if (MPIHelper::getInstance().isSendPending(PROC_MASTER)) {
+            tree_send_skipped = true;
+        } else {
+            sendCurrentTreeAsync();
+        }
+
+        // merge candidate sets that have arrived from MASTER so far
+        checkpoint->clear();
+        while (!stop_rule.isStopped() && MPIHelper::getInstance().tryRecvCheckpoint(checkpoint, PROC_MASTER) >= 0) {
+            if (checkpoint->getBool("stop")) {
+                cout << "Worker " << MPIHelper::getInstance().getProcessID() << " gets STOP message!" << endl;
+                stop_rule.shouldStop();
+            } else {
+                CandidateSet cset;
+                cset.setCheckpoint(checkpoint);
+                cset.restoreCheckpoint();
+                for (CandidateSet::iterator it = cset.begin(); it != cset.end(); it++)
+                    addTreeToCandidateSet(it->second.tree, it->second.score, false, MPIHelper::getInstance().getProcessID());
+                MPIHelper::getInstance().increaseTreeReceived(cset.size());
+                if (boot_samples.size() > 0)
+                    CKP_RESTORE(logl_cutoff);
+            }
+            checkpoint->clear();
+        }
+    }
+
+    delete checkpoint;
+#endif
+}
+
+void IQTree::sendCurrentTreeAsync() {
+#ifdef _IQTREE_MPI
+    Checkpoint *checkpoint = new Checkpoint;
+    string tree_bin;
+    getTreeBinary(tree_bin);
+    double score = curScore;
+    CKP_SAVE(score);
+    if (boot_samples.size() > 0) {
+        saveUFBoot(checkpoint);
+    }
+    MPIHelper::getInstance().isendCheckpoint(checkpoint, PROC_MASTER, tree_bin);
+    MPIHelper::getInstance().increaseTreeSent();
+    tree_send_skipped = false;
+    delete checkpoint;
+#endif
+}
+
 void IQTree::sendStopMessage() {
     if (MPIHelper::getInstance().getNumProcesses() == 1)
         return;
@@ -4486,11 +4893,50 @@ void IQTree::sendStopMessage() {
     stringstream ss;
     checkpoint->dump(ss);
     string str = ss.str();
-    string tree;
+    string tree_bin;
     double score;
 
     cout << "Sending STOP message to workers" << endl;
 
+    if (params->mpi_async) {
+        if (MPIHelper::getInstance().isMaster()) {
+            for (int w = 1; w < MPIHelper::getInstance().getNumProcesses(); w++)
+                MPIHelper::getInstance().isendCheckpoint(checkpoint, w);
+            // merge trees still on the way until every worker acknowledged the STOP message,
+            // messages from one worker arrive in order, so nothing is left behind
+            int num_stopped = 0;
+            while (num_stopped < MPIHelper::getInstance().getNumProcesses()-1) {
+                checkpoint->clear();
+                int worker = MPIHelper::getInstance().recvCheckpoint(checkpoint, MPI_ANY_SOURCE, TREE_TAG, &tree_bin);
+                if (checkpoint->getBool("stop")) {
+                    num_stopped++;
+                    continue;
+                }
+                MPIHelper::getInstance().increaseTreeReceived();
+                CKP_RESTORE(score);
+                addBinaryTreeToCandidateSet(tree_bin, score, true, worker);
+            }
+        } else {
+            // worker: skip candidate sets until the STOP message, then acknowledge it
+            while (!stop_rule.isStopped()) {
+                checkpoint->clear();
+                MPIHelper::getInstance().recvCheckpoint(checkpoint, PROC_MASTER);
+                if (checkpoint->getBool("stop"))
+                    stop_rule.shouldStop();
+            }
+            // the last tree must reach the master before the acknowledgement
+            if (tree_send_skipped)
+                sendCurrentTreeAsync();
+            checkpoint->clear();
+            checkpoint->putBool("stop", true);
+            MPIHelper::getInstance().isendCheckpoint(checkpoint, PROC_MASTER);
+        }
+        MPIHelper::getInstance().waitAllMessages();
+        delete checkpoint;
+        MPI_Barrier(MPI_COMM_WORLD);
+        return;
+    }
+
     // send STOP message to all processes
     if (MPIHelper::getInstance().isMaster()) {
         // repeatedly send stop message to all workers
@@ -4498,11 +4944,10 @@ void IQTree::sendStopMessage() {
 //            string buf;
 //            int worker = MPIHelper::getInstance().recvString(buf);
             checkpoint->clear();
-            int worker = MPIHelper::getInstance().recvCheckpoint(checkpoint);
+            int worker = MPIHelper::getInstance().recvCheckpoint(checkpoint, MPI_ANY_SOURCE, TREE_TAG, &tree_bin);
             MPIHelper::getInstance().increaseTreeReceived();
-            CKP_RESTORE(tree);
             CKP_RESTORE(score);
-            addTreeToCandidateSet(tree, score, true, worker);
+            addBinaryTreeToCandidateSet(tree_bin, score, true, worker);
             MPIHelper::getInstance().sendString(str, worker, TREE_TAG);
         }
     }
@@ -32,8 +32,18 @@
 #include "mtreeset.h"
 #include "node.h"
 #include "candidateset.h"
+#include "replicateweights.h"
 #include "utils/pllnni.h"
 
+/** number of NNI branches in the sample used to measure the number of threads for NNI evaluation */
+const int NNI_BATCH_SIZE = 16;
+
+/** number of timing windows per thread count when measuring, the fastest window is taken */
+const int NNI_TUNE_REPS = 3;
+
+/** minimum length of one timing window in seconds, the sample is evaluated again until it is reached */
+const double NNI_TUNE_MIN_TIME = 0.01;
+
 typedef std::map< string, double > mapString2Double;
 typedef std::multiset< double, std::less< double > > multiSetDB;
 typedef std::multiset< int, std::less< int > > MultiSetInt;
@@ -126,6 +136,22 @@ public:
     */
     void restoreUFBoot(Checkpoint *checkpoint);
 
+    /**
+        restore the distinct UFBoot trees saved by saveUFBoot, called inside struct UFBoot
+        @param checkpoint Checkpoint object
+        @param[out] saved_trees tree strings indexed by saved tree ID
+    */
+    void restoreUFBootTrees(Checkpoint *checkpoint, StrVector &saved_trees);
+
+    /**
+        restore one UFBoot replicate from its checkpoint value
+        @param sample replicate ID
+        @param value "count logl orig_logl tree", tree is a saved tree ID or a NEWICK string of older versions
+        @param saved_trees trees from restoreUFBootTrees
+        @param[in,out] tree_ids boot_trees ID of each saved tree, -1 if not yet added
+    */
+    void restoreUFBootSample(int sample, const string &value, StrVector &saved_trees, IntVector &tree_ids);
+
     /**
      * setup all necessary parameters  (declared as virtual needed for phylosupertree)
      */
@@ -449,6 +475,14 @@ public:
      */
     void evaluateNNIs(Branches &nniBranches, vector<NNIMove> &outNNIMoves);
 
+    /**
+     * set nni_num_threads for --nni-threads AUTO: evaluate a sample of \a nniBranches
+     * with halving number of threads until it gets slower. The tree is not changed
+     * and the evaluated trees are not saved for UFBoot
+     * @param nniBranches branches to take the sample from
+     */
+    void tuneNNIThreads(Branches &nniBranches);
+
     double optimizeNNIBranches(Branches &nniBranches);
 
     /**
@@ -684,6 +718,21 @@ public:
      */
     int addTreeToCandidateSet(string treeString, double score, bool updateStopRule, int sourceProcID);
 
+    /**
+     *  Add a tree received in the binary form of PhyloTree::getTreeBinary, e.g. from an MPI worker,
+     *  the tree is decoded without parsing newick
+     *  @param tree_bin the tree in binary form
+     *  @return the same as addTreeToCandidateSet
+     */
+    int addBinaryTreeToCandidateSet(const string &tree_bin, double score, bool updateStopRule, int sourceProcID);
+
+    /**
+     *  update the stop rule and print the iteration info after a tree was added to the candidate set
+     *  @param pos position returned by CandidateSet::update
+     *  @param curBestScore best score before the tree was added
+     */
+    void countCandidateIteration(int pos, double score, double curBestScore, int sourceProcID);
+
     /**
         MPI: synchronize candidate trees between all processes
         @param nTrees number of trees to broadcast
@@ -699,6 +748,25 @@ public:
     */
     void syncCurrentTree();
 
+    /**
+        MPI: exchange the tree of current iteration with master without blocking (--mpi-async).
+        Master merges all trees that have arrived and answers only workers whose candidate set
+        is outdated, workers merge candidate sets that have arrived and continue searching
+    */
+    void syncCurrentTreeAsync();
+
+    /**
+        MPI worker: send the current tree, its score and the UFBoot state to master without blocking
+    */
+    void sendCurrentTreeAsync();
+
+    /**
+        MPI: gather the best candidate trees to master along a binary tree of processes,
+        each process merges the trees of its children before sending to its parent (--mpi-async)
+        @param updateStopRule true to update stopping rule at master, false otherwise
+    */
+    void gatherCandidateTreesHierarchical(bool updateStopRule);
+
     /**
         MPI: Master sends stop message to all workers
     */
@@ -717,6 +785,26 @@ public:
      */
     void initCandidateTreeSet(int nParTrees, int nNNITrees);
 
+    /**
+     *  @param ntrees number of trees to process
+     *  @param nni_search TRUE if the trees will be NNI-polished, FALSE if only scored
+     *  @return number of tree workers for initCandidateTreeSet() (--init-workers),
+     *  1 if the trees have to be processed one after another by this tree
+     */
+    int getNumTreeWorkers(int ntrees, bool nni_search);
+
+    /**
+     *  create a tree-private single-threaded worker sharing the alignment and model of this tree
+     *  @return the worker, to be freed by deleteTreeWorker()
+     */
+    IQTree *newTreeWorker();
+
+    /**
+     *  free a worker created by newTreeWorker(), leaving the shared model untouched
+     *  @param worker the worker
+     */
+    void deleteTreeWorker(IQTree *worker);
+
     /**
      * Generate the initial tree (usually used for model parameter estimation)
      */
@@ -771,8 +859,8 @@ public:
     /** log-likelihood threshold (l_min) */
     double logl_cutoff;
 
-    /** vector of bootstrap alignments generated */
-    vector<BootValType* > boot_samples;
+    /** pattern counts of the bootstrap alignments generated */
+    ReplicateWeights boot_samples;
 
     /** starting sample for UFBoot, used for MPI */
     int sample_start;
@@ -780,8 +868,8 @@ public:
     /** end sample for UFBoot, used for MPI */
     int sample_end;
 
-    /** newick string of corresponding bootstrap trees */
-    StrVector boot_trees;
+    /** newick string of corresponding bootstrap trees, each distinct tree stored once */
+    UFBootTrees boot_trees;
 
     /** bootstrap tree strings with branch lengths, for -wbtl option */
 //    StrVector boot_trees_brlen;
@@ -849,6 +937,13 @@ protected:
 
     double nni_cutoff;
 
+    /**
+        number of threads for evaluating NNI branches, 0 if not yet determined.
+        Each NNI branch needs only a few small traversals, so for short alignments
+        fewer threads than for full traversals can be faster
+    */
+    int nni_num_threads;
+
     bool nni_sort;
 
     bool testNNI;
@@ -875,6 +970,9 @@ protected:
     // MPI: vector of size = num processes, true if master should send candidate set to worker
     BoolVector candidateset_changed;
 
+    // MPI --mpi-async: true if the worker skipped sending its current tree because the previous one was still on the way
+    bool tree_send_skipped;
+
     // true if best candidate tree is changed
     bool bestcandidate_changed;
 
@@ -22,21 +22,70 @@
 #include "tree/phylotree.h"
 #include "memslot.h"
 
+
 const int MEM_LOCKED = 1;
 const int MEM_SPECIAL = 2;
+const int MEM_PENDING = 4; // partial_lh is assigned but not yet computed in the current traversal
+
+/** hit counters of all slots are halved after this number of traversals */
+const int MEM_HIT_AGING = 16;
+
+MemSlotVector::MemSlotVector() {
+    central_float_lh = NULL;
+    central_float_exp = NULL;
+    central_float_scale = NULL;
+    lh_size = scale_size = 0;
+    num_states = num_cat = vector_size = 1;
+    num_float_saved = num_float_rejected = num_float_loaded = 0;
+    num_hits = num_misses = num_recomputes = num_evictions = 0;
+    num_traversals = 0;
+    free_count = 0;
+}
+
+MemSlotVector::~MemSlotVector() {
+    aligned_free(central_float_lh);
+    aligned_free(central_float_exp);
+    aligned_free(central_float_scale);
+}
 
-void MemSlotVector::init(PhyloTree *tree, int num_slot) {
+void MemSlotVector::init(PhyloTree *tree, int num_slot, int num_float_slot) {
     if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
         return;
     reserve(num_slot+2);
     resize(num_slot);
-    size_t lh_size = tree->getPartialLhSize();
-    size_t scale_size = tree->getScaleNumSize();
-    reset();
+    lh_size = tree->getPartialLhSize();
+    scale_size = tree->getScaleNumSize();
+    num_states = lh_size / scale_size;
+    num_cat = tree->getRate()->getNRate() * ((tree->getModelFactory()->fused_mix_rate) ? 1 : tree->getModel()->getNMixtures());
+    vector_size = max(tree->vector_size, (size_t)1);
     for (iterator it = begin(); it != end(); it++) {
         it->partial_lh = tree->central_partial_lh + lh_size*(it-begin());
         it->scale_num = tree->central_scale_num + scale_size*(it-begin());
     }
+
+    if (float_slots.size() != num_float_slot) {
+        aligned_free(central_float_lh);
+        aligned_free(central_float_exp);
+        aligned_free(central_float_scale);
+        float_slots.resize(num_float_slot);
+        if (num_float_slot > 0) {
+            try {
+                central_float_lh = aligned_alloc<float>(lh_size*num_float_slot);
+                central_float_exp = aligned_alloc<int16_t>(scale_size*num_float_slot);
+                central_float_scale = aligned_alloc<UBYTE>(scale_size*num_float_slot);
+            } catch (std::bad_alloc &ba) {
+                outError("Not enough memory for single-precision partial likelihood vectors (bad_alloc)");
+            }
+        }
+        for (auto it = float_slots.begin(); it != float_slots.end(); it++) {
+            size_t id = it - float_slots.begin();
+            it->partial_lh = central_float_lh + lh_size*id;
+            it->exponent = central_float_exp + scale_size*id;
+            it->scale_num = central_float_scale + scale_size*id;
+            it->loading = false;
+        }
+    }
+    reset();
 }
 
 void MemSlotVector::reset() {
@@ -45,9 +94,16 @@ void MemSlotVector::reset() {
     for (iterator it = begin(); it != end(); it++) {
         it->status = 0;
         it->nei = NULL;
+        it->hits = 0;
     }
     nei_id_map.clear();
+    evicted_neis.clear();
     free_count = 0;
+    for (auto it = float_slots.begin(); it != float_slots.end(); it++) {
+        it->nei = NULL;
+        it->loading = false;
+    }
+    float_id_map.clear();
 }
 
 
@@ -63,6 +119,7 @@ void MemSlotVector::addNei(PhyloNeighbor *nei, iterator it) {
     nei->partial_lh = it->partial_lh;
     nei->scale_num = it->scale_num;
     it->nei = nei;
+    it->hits = 0;
     nei_id_map[nei] = it-begin();
 }
 
@@ -73,6 +130,7 @@ void MemSlotVector::addSpecialNei(PhyloNeighbor *nei) {
     MemSlot ms;
     ms.status = MEM_SPECIAL + MEM_LOCKED;
     ms.nei = nei;
+    ms.hits = 0;
     ms.partial_lh = nei->partial_lh;
     ms.scale_num = nei->scale_num;
     push_back(ms);
@@ -139,32 +197,40 @@ int MemSlotVector::allocate(PhyloNeighbor *nei) {
         iterator it = begin() + free_count;
         ASSERT(it->nei == NULL);
         addNei(nei, it);
+        it->status |= MEM_PENDING;
+        countMiss(nei);
         free_count++;
         return it-begin();
     }
 
-    int min_size = INT_MAX;
+    int64_t min_cost = INT64_MAX;
     iterator best = end();
 
 
-    // no free slot found, find an unlocked slot with minimal size
+    // no free slot found, find an unlocked slot with minimal expected recomputation cost:
+    // subtree size (cost to recompute) weighted by how often the slot was reused
     for (iterator it = begin(); it != end(); it++)
-        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_size > it->nei->size) {
-            best = it;
-            min_size = it->nei->size;
-            // 2 is the minimum size
-            if (min_size == 2)
-                break;
+        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0) {
+            int64_t cost = (int64_t)it->nei->size * (it->hits+1);
+            if (cost < min_cost) {
+                best = it;
+                min_cost = cost;
+                // 2 is the minimum size
+                if (min_cost == 2)
+                    break;
+            }
         }
 
     if (best == end())
         return -1;
 
     // clear mem assigned to it->nei
-    best->nei->clearPartialLh();
+    evict(best);
 
     // assign mem to nei
     addNei(nei, best);
+    best->status |= MEM_PENDING;
+    countMiss(nei);
     return best-begin();
 
 }
@@ -178,11 +244,65 @@ void MemSlotVector::update(PhyloNeighbor *nei) {
 //        return;
     if (it->nei != nei) {
         // clear mem assigned to it->nei
-        it->nei->clearPartialLh();
+        evict(it);
 
         // assign mem to nei
         addNei(nei, it);
     }
+    it->status |= MEM_PENDING;
+    countMiss(nei);
+}
+
+void MemSlotVector::startTraversal() {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    num_traversals++;
+    bool aging = (num_traversals % MEM_HIT_AGING == 0);
+    for (iterator it = begin(); it != end(); it++) {
+        it->status &= ~MEM_PENDING;
+        if (aging)
+            it->hits /= 2;
+    }
+    // single-precision copies restored in the previous traversal can be reused
+    for (auto it = float_slots.begin(); it != float_slots.end(); it++)
+        it->loading = false;
+}
+
+void MemSlotVector::hit(PhyloNeighbor *nei) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    if (nei->node->isLeaf())
+        return;
+    iterator it = findNei(nei);
+    if (it->status & MEM_SPECIAL)
+        return;
+    it->hits++;
+    num_hits++;
+}
+
+void MemSlotVector::countMiss(PhyloNeighbor *nei) {
+    num_misses++;
+    auto it = evicted_neis.find(nei);
+    if (it != evicted_neis.end()) {
+        num_recomputes++;
+        evicted_neis.erase(it);
+    }
+}
+
+void MemSlotVector::printStats(ostream &out) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    int64_t total = num_hits + num_misses;
+    out << "Memory saving: " << size() << " partial likelihood slots";
+    if (!float_slots.empty())
+        out << " + " << float_slots.size() << " single-precision slots";
+    out << endl;
+    out << "  hits: " << num_hits << " (" << ((total > 0) ? num_hits*100.0/total : 0.0) << "%)"
+        << ", misses: " << num_misses << ", recomputations: " << num_recomputes
+        << ", evictions: " << num_evictions << endl;
+    if (!float_slots.empty())
+        out << "  single precision: " << num_float_saved << " saved, " << num_float_rejected
+            << " rejected, " << num_float_loaded << " restored" << endl;
 }
 
 /*
@@ -252,3 +372,115 @@ void MemSlotVector::restore(PhyloNeighbor *new_nei, PhyloNeighbor *old_nei) {
 //    nei_id_map[old_nei] = it;
     cout << "slot " << distance(begin(), it) << " restored" << endl;
 }
+
+void MemSlotVector::evict(iterator it) {
+    PhyloNeighbor *nei = it->nei;
+    // a pending slot does not hold the final partial_lh yet, and the slot may be stale
+    // if nei was re-created (e.g. by reading a new tree)
+    bool saved = (it->status & MEM_PENDING) == 0 && (nei->partial_lh_computed & 1) &&
+        nei->partial_lh == it->partial_lh && saveFloat(*it);
+    nei->clearPartialLh();
+    num_evictions++;
+    if (saved)
+        nei->partial_lh_computed |= PARTIAL_LH_FLOAT;
+    else
+        evicted_neis.insert(nei);
+}
+
+bool MemSlotVector::saveFloat(MemSlot &slot) {
+    if (float_slots.empty())
+        return false;
+
+    // reuse the slot of this neighbor, a free slot, a slot whose copy became invalid,
+    // or the slot of the smallest subtree in this order
+    int id = -1;
+    auto map_it = float_id_map.find(slot.nei);
+    if (map_it != float_id_map.end()) {
+        id = map_it->second;
+        float_id_map.erase(map_it);
+    } else {
+        int min_size = INT_MAX;
+        for (auto it = float_slots.begin(); it != float_slots.end(); it++) {
+            if (it->loading)
+                continue;
+            if (!it->nei || (it->nei->partial_lh_computed & PARTIAL_LH_FLOAT) == 0) {
+                id = it - float_slots.begin();
+                break;
+            }
+            if (it->nei->size < min_size) {
+                min_size = it->nei->size;
+                id = it - float_slots.begin();
+            }
+        }
+        if (id < 0)
+            return false;
+        if (float_slots[id].nei) {
+            float_slots[id].nei->partial_lh_computed &= ~PARTIAL_LH_FLOAT;
+            float_id_map.erase(float_slots[id].nei);
+        }
+    }
+
+    FloatSlot &fs = float_slots[id];
+    fs.nei = NULL;
+    // store mantissas relative to the maximum of each pattern and category,
+    // scale_num keeps the scaling information exactly
+    size_t group = num_states*vector_size;
+    for (size_t unit = 0; unit < scale_size; unit++) {
+        size_t start = (unit/vector_size)*group + (unit%vector_size);
+        double lh_max = 0.0;
+        for (size_t i = start; i < start+group; i += vector_size)
+            lh_max = max(lh_max, fabs(slot.partial_lh[i]));
+        int exponent = 0;
+        if (lh_max > 0.0)
+            frexp(lh_max, &exponent);
+        fs.exponent[unit] = exponent;
+        for (size_t i = start; i < start+group; i += vector_size) {
+            double value = ldexp(slot.partial_lh[i], -exponent);
+            float stored = (float)value;
+            if (fabs((double)stored - value) > FLOAT_LH_TOLERANCE * fabs(value)) {
+                // e.g. a denormal or flushed mantissa, the vector is recomputed in double
+                num_float_rejected++;
+                return false;
+            }
+            fs.partial_lh[i] = stored;
+        }
+    }
+    memcpy(fs.scale_num, slot.scale_num, scale_size*sizeof(UBYTE));
+    fs.nei = slot.nei;
+    float_id_map[slot.nei] = id;
+    num_float_saved++;
+    return true;
+}
+
+int MemSlotVector::loadFloat(PhyloNeighbor *nei) {
+    nei->partial_lh_computed &= ~PARTIAL_LH_FLOAT;
+    auto map_it = float_id_map.find(nei);
+    if (map_it == float_id_map.end())
+        return -1;
+    int id = map_it->second;
+    float_id_map.erase(map_it);
+    // keep the copy until the traversal is computed
+    float_slots[id].nei = NULL;
+    float_slots[id].loading = true;
+    num_float_loaded++;
+    return id;
+}
+
+void MemSlotVector::unpackFloat(int float_id, PhyloNeighbor *nei, size_t ptn_lower, size_t ptn_upper,
+                                bool safe_numeric) {
+    FloatSlot &fs = float_slots[float_id];
+    size_t group = num_states*vector_size;
+    for (size_t unit = ptn_lower*num_cat; unit < ptn_upper*num_cat; unit++) {
+        size_t start = (unit/vector_size)*group + (unit%vector_size);
+        int exponent = fs.exponent[unit];
+        for (size_t i = start; i < start+group; i += vector_size)
+            nei->partial_lh[i] = ldexp((double)fs.partial_lh[i], exponent);
+    }
+    // SAFE_LH kernels scale each pattern and category, NORM_LH kernels each pattern,
+    // so that only the scale_num of this range of patterns is touched
+    if (safe_numeric)
+        memcpy(nei->scale_num + ptn_lower*num_cat, fs.scale_num + ptn_lower*num_cat,
+               (ptn_upper-ptn_lower)*num_cat*sizeof(UBYTE));
+    else
+        memcpy(nei->scale_num + ptn_lower, fs.scale_num + ptn_lower, (ptn_upper-ptn_lower)*sizeof(UBYTE));
+}
@@ -34,18 +34,44 @@ struct MemSlot {
     PhyloNeighbor *nei; // neighbor assigned to this slot
     double *partial_lh; // partial_lh assigned to this slot
     UBYTE *scale_num; // scale_num assigned to this slot
+    int hits; // number of traversals that reused partial_lh since it was assigned, aged over time
 
     PhyloNeighbor *saved_nei;
 };
 
+/**
+    maximum relative error of a partial likelihood entry after the round trip through single
+    precision, otherwise the vector is not cached and will be recomputed in double
+*/
+const double FLOAT_LH_TOLERANCE = 1e-6;
+
+/**
+    single-precision copy of an evicted partial likelihood vector, used with --lh-float.
+    This is a memory-saving cache only, all likelihood kernels still compute in double
+*/
+struct FloatSlot {
+    PhyloNeighbor *nei; // neighbor whose partial_lh is stored here
+    float *partial_lh; // mantissas of partial_lh
+    int16_t *exponent; // power-of-two exponent per pattern and category
+    UBYTE *scale_num; // exact copy of scale_num
+    bool loading; // being restored in the current traversal
+};
+
 /**
     all memory slots, used for memory saving technique
 */
 class MemSlotVector : public vector<MemSlot> {
 public:
 
-    /** initialize with a specified number of slots */
-    void init(PhyloTree *tree, int num_slot);
+    MemSlotVector();
+
+    ~MemSlotVector();
+
+    /** 
+        initialize with a specified number of slots
+        @param num_float_slot number of single-precision slots for evicted vectors
+    */
+    void init(PhyloTree *tree, int num_slot, int num_float_slot = 0);
 
     /** 
         lock the memory assigned to nei
@@ -66,6 +92,15 @@ public:
     /** update neighbor */
     void update(PhyloNeighbor *nei);
 
+    /** mark all slots as computed, called before collecting a new traversal */
+    void startTraversal();
+
+    /** record that the computed partial_lh of nei is reused by a traversal */
+    void hit(PhyloNeighbor *nei);
+
+    /** print cache statistics of the memory saving technique */
+    void printStats(ostream &out);
+
     /** find ID the a neighbor */
     iterator findNei(PhyloNeighbor *nei);
 
@@ -93,8 +128,74 @@ public:
     /** restore neighbor, after calling replace */
     void restore(PhyloNeighbor *new_nei, PhyloNeighbor *old_nei);
 
+    /**
+        take the single-precision copy of nei saved on eviction, it is kept until the next traversal
+        @param nei neighbor with PARTIAL_LH_FLOAT bit set
+        @return ID of the copy to pass to unpackFloat, -1 if partial_lh must be recomputed
+    */
+    int loadFloat(PhyloNeighbor *nei);
+
+    /**
+        restore partial_lh and scale_num of nei from a single-precision copy for a range of patterns
+        @param float_id ID returned by loadFloat
+        @param safe_numeric TRUE if scale_num has one entry per pattern and category (SAFE_LH),
+            FALSE if it has one entry per pattern (NORM_LH)
+    */
+    void unpackFloat(int float_id, PhyloNeighbor *nei, size_t ptn_lower, size_t ptn_upper, bool safe_numeric);
+
+    /** number of evicted vectors kept in single precision */
+    int64_t num_float_saved;
+
+    /** number of evicted vectors not kept because an entry exceeded FLOAT_LH_TOLERANCE */
+    int64_t num_float_rejected;
+
+    /** number of vectors restored from single precision instead of being recomputed */
+    int64_t num_float_loaded;
+
+    /** number of reused partial_lh vectors */
+    int64_t num_hits;
+
+    /** number of partial_lh vectors that had to be computed */
+    int64_t num_misses;
+
+    /** number of misses for vectors that were computed before and evicted */
+    int64_t num_recomputes;
+
+    /** number of vectors evicted from their slot */
+    int64_t num_evictions;
+
 protected:
 
+    /** clear mem assigned to it->nei, keeping a single-precision copy if possible */
+    void evict(iterator it);
+
+    /** count a partial_lh computation of nei */
+    void countMiss(PhyloNeighbor *nei);
+
+    /**
+        save the partial_lh of a slot in single precision, every entry is converted back and
+        compared with the original within FLOAT_LH_TOLERANCE
+        @return TRUE if saved, FALSE if no float slot is available or precision would be lost
+    */
+    bool saveFloat(MemSlot &slot);
+
+    /** single-precision slots for evicted vectors */
+    vector<FloatSlot> float_slots;
+
+    /** map from neighbor to float slot ID */
+    unordered_map<PhyloNeighbor*, int> float_id_map;
+
+    /** memory of all float slots */
+    float *central_float_lh;
+    int16_t *central_float_exp;
+    UBYTE *central_float_scale;
+
+    /** sizes of one slot */
+    size_t lh_size, scale_size;
+
+    /** no. states, categories and vector size, to map a partial_lh entry to its pattern and category */
+    size_t num_states, num_cat, vector_size;
+
 
     /** 
         map from neighbor to slot ID for fast lookup
@@ -105,6 +206,12 @@ protected:
     /** counter of free slot ID */
     int free_count;
 
+    /** neighbors whose partial_lh was evicted, to count recomputations */
+    unordered_set<PhyloNeighbor*> evicted_neis;
+
+    /** number of traversals, to age the hit counters */
+    int64_t num_traversals;
+
 };
 
 
@@ -438,6 +438,35 @@ void MTree::printTree(ostream &out, int brtype) {
     if (brtype & WT_NEWLINE) out << endl;
 }
 
+void MTree::encodeTree(string &out) {
+    size_t start = out.size();
+    int32_t header[4] = {TREE_BIN_MAGIC, (int32_t)leafNum, 0, (int32_t)rooted};
+    out.append((char*)header, sizeof(header));
+    // preorder with an explicit stack, caterpillar trees with many taxa are too deep for recursion
+    vector<pair<Node*, Node*> > stack;
+    stack.push_back(make_pair(root, (Node*)NULL));
+    int32_t num_nodes = 0;
+    while (!stack.empty()) {
+        Node *node = stack.back().first;
+        Node *dad = stack.back().second;
+        stack.pop_back();
+        TreeBinRecord rec;
+        rec.length = (dad) ? node->findNeighbor(dad)->length : 0.0;
+        if (node->isLeaf())
+            rec.code = node->id;
+        else
+            rec.code = -(int32_t)(node->degree() - ((dad) ? 1 : 0));
+        out.append((char*)&rec.code, sizeof(rec.code));
+        out.append((char*)&rec.length, sizeof(rec.length));
+        num_nodes++;
+        // push in reverse order to keep the order of neighbors
+        for (NeighborVec::reverse_iterator it = node->neighbors.rbegin(); it != node->neighbors.rend(); it++)
+            if ((*it)->node != dad)
+                stack.push_back(make_pair((*it)->node, node));
+    }
+    memcpy(&out[start + 2*sizeof(int32_t)], &num_nodes, sizeof(num_nodes));
+}
+
 struct IntString {
     int id;
     string str;
@@ -790,6 +819,66 @@ void MTree::readTree(istream &in, bool &is_rooted)
     //checkValidTree(stop);
 }
 
+size_t MTree::decodeTree(const char *buf, size_t size) {
+    int32_t header[4];
+    if (size < sizeof(header))
+        outError("Binary tree is truncated");
+    memcpy(header, buf, sizeof(header));
+    if (header[0] != TREE_BIN_MAGIC)
+        outError("Binary tree has a wrong format");
+    leafNum = header[1];
+    int32_t num_nodes = header[2];
+    rooted = (header[3] != 0);
+    size_t total = sizeof(header) + (size_t)num_nodes * TREE_BIN_RECORD_SIZE;
+    if (num_nodes < 1 || size < total)
+        outError("Binary tree is truncated");
+
+    // the records are read in place, no intermediate string is built
+    const char *pos = buf + sizeof(header);
+    // nodes whose children are not all read yet, with the number of children left
+    vector<pair<Node*, int> > stack;
+    root = NULL;
+    for (int32_t i = 0; i < num_nodes; i++, pos += TREE_BIN_RECORD_SIZE) {
+        TreeBinRecord rec;
+        memcpy(&rec.code, pos, sizeof(rec.code));
+        memcpy(&rec.length, pos + sizeof(rec.code), sizeof(rec.length));
+        Node *node;
+        int children;
+        if (rec.code >= 0) {
+            if (rec.code >= leafNum)
+                outError("Binary tree has a wrong taxon ID " + convertIntToString(rec.code));
+            if (rooted && rec.code == leafNum-1)
+                node = newNode(rec.code, ROOT_NAME);
+            else
+                node = newNode(rec.code, rec.code);
+            // the root leaf is the only leaf with a child
+            children = (i == 0 && num_nodes > 1) ? 1 : 0;
+        } else {
+            node = newNode();
+            children = -rec.code;
+        }
+        if (i == 0) {
+            root = node;
+        } else {
+            if (stack.empty())
+                outError("Binary tree has more nodes than its topology");
+            Node *dad = stack.back().first;
+            dad->addNeighbor(node, rec.length);
+            node->addNeighbor(dad, rec.length);
+            if (--stack.back().second == 0)
+                stack.pop_back();
+        }
+        if (children > 0)
+            stack.push_back(make_pair(node, children));
+    }
+    if (!stack.empty())
+        outError("Binary tree is truncated");
+
+    nodeNum = leafNum;
+    initializeTree();
+    return total;
+}
+
 void MTree::initializeTree(Node *node, Node* dad)
 {
     if (!node) {
@@ -33,6 +33,22 @@ const char ROOT_NAME[] = "__root__"; // special name that does not occur elsewhe
 
 const char BRANCH_LENGTH_SEPARATOR = '/';
 
+/** magic number at the start of a binary tree written by MTree::encodeTree ("IQTB") */
+const int32_t TREE_BIN_MAGIC = 0x42545149;
+
+/**
+    one node of a binary tree in preorder: taxon ID for a leaf or minus the number of children
+    for an internal node, and the length of the branch to the parent.
+    It is written without padding, see TREE_BIN_RECORD_SIZE
+*/
+struct TreeBinRecord {
+    int32_t code;
+    double length;
+};
+
+/** number of bytes of one TreeBinRecord in a binary tree */
+const size_t TREE_BIN_RECORD_SIZE = sizeof(int32_t) + sizeof(double);
+
 class SplitGraph;
 class MTreeSet;
 
@@ -199,6 +215,14 @@ public:
      */
     virtual void printTree(ostream & out, int brtype = WT_BR_LEN);
 
+    /**
+            append the tree in a compact binary form to a buffer, much smaller and faster to read
+            than newick: a header (TREE_BIN_MAGIC, leafNum, number of nodes, rooted) followed by
+            one TreeBinRecord per node in preorder from the root, leaves are stored by their IDs
+            @param[out] out buffer to append to
+     */
+    void encodeTree(string &out);
+
     /**
      print the tree to the output file in NEXUS format
      @param outfile the output file.
@@ -311,6 +335,14 @@ public:
      */
     virtual void readTree(istream &in, bool &is_rooted);
 
+    /**
+            build the tree directly from a buffer written by encodeTree, leaves are named by their IDs
+            @param buf buffer to read from
+            @param size number of bytes available in buf
+            @return number of bytes consumed
+     */
+    size_t decodeTree(const char *buf, size_t size);
+
     /**
             read the tree from a newick string
             @param tree_string the tree string.
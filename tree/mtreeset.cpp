@@ -116,31 +116,43 @@ void MTreeSet::init(StrVector &treels, bool &is_rooted) {
     if (!it->empty())
 	{
 		count++;
-		MTree *tree = newTree();
-		stringstream ss(*it);
-		bool myrooted = is_rooted;
-		tree->readTree(ss, myrooted);
-		NodeVector taxa;
-		tree->getTaxa(taxa);
-		for (NodeVector::iterator taxit = taxa.begin(); taxit != taxa.end(); taxit++) {
-			if ((*taxit)->name == ROOT_NAME) {
-				(*taxit)->id = taxa.size() - 1;
-			}
-			else {
-				(*taxit)->id = atoi((*taxit)->name.c_str());
-			}
-		}
-		//at(it->second) = tree;
-		push_back(tree);
-		tree_weights.push_back(1);
-		//cout << "Tree " << it->second << ": ";
-		//tree->printTree(cout, WT_NEWLINE);
+		addTaxonIDTree(*it, is_rooted, 1);
 	}
 	if (verbose_mode >= VB_MED)
 		cout << count << " tree(s) converted" << endl;
 	//tree_weights.resize(size(), 1);
 }
 
+void MTreeSet::init(UFBootTrees &treels, bool &is_rooted) {
+	int count = 0;
+	for (int id = 0; id < treels.getMaxTreeID(); id++)
+	if (treels.getTreeCount(id) > 0) {
+		count++;
+		addTaxonIDTree(treels.getTree(id), is_rooted, treels.getTreeCount(id));
+	}
+	if (verbose_mode >= VB_MED)
+		cout << count << " distinct tree(s) converted" << endl;
+}
+
+void MTreeSet::addTaxonIDTree(const string &tree_str, bool &is_rooted, int weight) {
+	MTree *tree = newTree();
+	stringstream ss(tree_str);
+	bool myrooted = is_rooted;
+	tree->readTree(ss, myrooted);
+	NodeVector taxa;
+	tree->getTaxa(taxa);
+	for (NodeVector::iterator taxit = taxa.begin(); taxit != taxa.end(); taxit++) {
+		if ((*taxit)->name == ROOT_NAME) {
+			(*taxit)->id = taxa.size() - 1;
+		}
+		else {
+			(*taxit)->id = atoi((*taxit)->name.c_str());
+		}
+	}
+	push_back(tree);
+	tree_weights.push_back(weight);
+}
+
 void MTreeSet::init(vector<string> &trees, vector<string> &taxonNames, bool &is_rooted) {
 	int count = 0;
 	for (vector<string>::iterator it = trees.begin(); it != trees.end(); it++) {
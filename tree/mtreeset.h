@@ -21,6 +21,7 @@
 #define MTREESET_H
 
 #include "mtree.h"
+#include "ufboottrees.h"
 #include "pda/splitgraph.h"
 #include "alignment/alignment.h"
 
@@ -60,6 +61,14 @@ public:
 
 	void init(StrVector &treels, bool &is_rooted);
 
+	/**
+		initialize from UFBoot trees, each distinct tree is read once and
+		weighted by the number of replicates having it
+		@param treels UFBoot trees with taxon IDs as names
+		@param is_rooted (IN/OUT) true if tree is rooted
+	*/
+	void init(UFBootTrees &treels, bool &is_rooted);
+
 	/**
 	 *  Add trees from \a trees to the tree set
 	 *
@@ -194,6 +203,16 @@ public:
 
     /** TRUE if trees have equal taxon set, FALSE otherwise */
     bool equal_taxon_set;
+
+protected:
+
+	/**
+		read a tree whose taxon names are taxon IDs and add it to the set
+		@param tree_str NEWICK string
+		@param is_rooted (IN/OUT) true if tree is rooted
+		@param weight tree weight
+	*/
+	void addTaxonIDTree(const string &tree_str, bool &is_rooted, int weight);
     
 };
 
@@ -927,6 +927,11 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
     if (partial_lh_leaf == NULL)
         partial_lh_leaf = info.partial_lh_leaves;
 
+    // transition terms of unchanged branches are copied from the cache, only for the
+    // traversal buffers as the slots are assigned by assignTransCache()
+    bool use_trans_cache = (echildren == NULL && !trans_cache_slots.empty());
+    size_t echild_size = block*nstates, leaf_size = (aln->STATE_UNKNOWN+1)*block;
+
     //----------- Non-reversible model --------------
 
     if (!model->useRevKernel()) {
@@ -934,6 +939,13 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
         // non-reversible model
         FOR_NEIGHBOR_IT(node, dad, it) {
             PhyloNeighbor *child = (PhyloNeighbor*)*it;
+            if (use_trans_cache && loadTransCache(child, echild, echild_size, partial_lh_leaf, leaf_size)) {
+                if (child->node->isLeaf())
+                    partial_lh_leaf += leaf_size;
+                echild += echild_size;
+                continue;
+            }
+            double *child_lh_leaf = partial_lh_leaf;
             // precompute information buffer
             if (child->direction == TOWARD_ROOT) {
                 // transpose probability matrix
@@ -1000,6 +1012,8 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
                 }
                 partial_lh_leaf += block;
             }
+            if (use_trans_cache)
+                saveTransCache(child, echild, echild_size, child_lh_leaf, leaf_size);
             echild += block*nstates;
         }
         return;
@@ -1011,6 +1025,13 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
         VectorClass *expchild = (VectorClass*)buffer;
         FOR_NEIGHBOR_IT(node, dad, it) {
             PhyloNeighbor *child = (PhyloNeighbor*)*it;
+            if (use_trans_cache && loadTransCache(child, echild, echild_size, partial_lh_leaf, leaf_size)) {
+                if (child->node->isLeaf())
+                    partial_lh_leaf += leaf_size;
+                echild += echild_size;
+                continue;
+            }
+            double *child_lh_leaf = partial_lh_leaf;
             VectorClass *echild_ptr = (VectorClass*)echild;
             // precompute information buffer
             for (c = 0; c < ncat_mix; c++) {
@@ -1055,6 +1076,8 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
                 }
                 partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
             }
+            if (use_trans_cache)
+                saveTransCache(child, echild, echild_size, child_lh_leaf, leaf_size);
             echild += block*nstates;
         }
 //        aligned_free(expchild);
@@ -1063,6 +1086,13 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
         double expchild[nstates];
         FOR_NEIGHBOR_IT(node, dad, it) {
             PhyloNeighbor *child = (PhyloNeighbor*)*it;
+            if (use_trans_cache && loadTransCache(child, echild, echild_size, partial_lh_leaf, leaf_size)) {
+                if (child->node->isLeaf())
+                    partial_lh_leaf += leaf_size;
+                echild += echild_size;
+                continue;
+            }
+            double *child_lh_leaf = partial_lh_leaf;
             // precompute information buffer
             double *echild_ptr = echild;
             for (c = 0; c < ncat_mix; c++) {
@@ -1104,6 +1134,8 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
                 }
                 partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
             }
+            if (use_trans_cache)
+                saveTransCache(child, echild, echild_size, child_lh_leaf, leaf_size);
             echild += block*nstates;
         }
     }
@@ -1170,6 +1202,7 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
 
     // sort subtrees for mem save technique
     if (params->lh_mem_save == LM_MEM_SAVE) {
+        mem_slots.startTraversal();
 //        sortNeighborBySubtreeSize(node, dad);
 //        sortNeighborBySubtreeSize(dad, node);
         int node_size = node->computeSize(dad);
@@ -1206,6 +1239,8 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
     if (traversal_info.empty())
         return;
 
+    prefetchTraversalInfo();
+
     if (!model->isSiteSpecificModel()) {
 
         int num_info = traversal_info.size();
@@ -1240,6 +1275,7 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
 
         
         if (!Params::getInstance().buffer_mem_save) {
+            assignTransCache();
 #ifdef _OPENMP
 #pragma omp parallel if (num_info >= 3) num_threads(num_threads)
         {
@@ -1249,6 +1285,8 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
             VectorClass *buffer_tmp = (VectorClass*)buffer;
 #endif
             for (int i = 0; i < num_info; i++) {
+                if (traversal_info[i].float_id >= 0)
+                    continue;
             #ifdef KERNEL_FIX_STATES
                 computePartialInfo<VectorClass, nstates>(traversal_info[i], buffer_tmp);
             #else
@@ -1262,19 +1300,35 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
     }
 
     if (compute_partial_lh) {
-        vector<size_t> limits;
         size_t orig_nptn = roundUpToMultiple(aln->size(), VectorClass::size());
         size_t nptn      = roundUpToMultiple(orig_nptn+model_factory->unobserved_ptns.size(),VectorClass::size());
-        computeBounds<VectorClass>(num_threads, num_packets, nptn, limits);
+        // each task is one pattern block for the whole traversal, idle threads steal blocks
+        // so that patterns of different cost do not stall the other threads
+        // a block is at most one cache-sized tile, so the children of a node are still in cache
+        // when the node is computed
+        block_scheduler.init(num_threads, nptn, VectorClass::size(), 0, getTraversalTileSize(VectorClass::size()));
 
         #ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,1) num_threads(num_threads)
+        #pragma omp parallel num_threads(num_threads)
         #endif
-        for (int packet_id = 0; packet_id < num_packets; ++packet_id) {
-            for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
-                computePartialLikelihood(*it, limits[packet_id], limits[packet_id+1], packet_id);
+        {
+        #ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+        #else
+            int thread_id = 0;
+        #endif
+            size_t ptn_lower, ptn_upper;
+            // thread_id < num_packets, so the per-packet kernel buffers are not shared
+            while (block_scheduler.next(thread_id, ptn_lower, ptn_upper)) {
+                for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
+                    computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+                }
             }
         }
+        if (verbose_mode >= VB_DEBUG)
+            cout << "Partial likelihood: " << block_scheduler.getNumBlocks() << " pattern blocks of "
+                 << block_scheduler.getBlockSize() << " patterns, "
+                 << block_scheduler.getNumSteals() << " stolen" << endl;
         traversal_info.clear();
     }
     return;
@@ -1489,7 +1543,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 } else {
                     // non site specific model
                     PhyloNeighbor *child = (PhyloNeighbor*)*it;
-                    auto stateRow = this->getConvertedSequenceByNumber(child->node->id);
+                    auto stateRow = this->getTipStateRow(child->node->id);
                     auto unknown  = aln->STATE_UNKNOWN;
                     UBYTE *scale_child = SAFE_NUMERIC ? child->scale_num + ptn*ncat_mix : NULL;
                     if (child->node->isLeaf()) {
@@ -1643,8 +1697,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         double *vec_right =  SITE_MODEL ? &vec_left[nstates*VectorClass::size()] : &vec_left[block*VectorClass::size()];
         VectorClass *partial_lh_tmp = SITE_MODEL ? (VectorClass*)vec_right+nstates : (VectorClass*)vec_right+block;
 
-        auto leftStateRow  = this->getConvertedSequenceByNumber(left->node->id);
-        auto rightStateRow = this->getConvertedSequenceByNumber(right->node->id);
+        auto leftStateRow  = this->getTipStateRow(left->node->id);
+        auto rightStateRow = this->getTipStateRow(right->node->id);
         auto unknown = aln->STATE_UNKNOWN;
 
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
@@ -1761,7 +1815,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         double *vec_left = buffer_partial_lh_ptr + thread_buf_size * packet_id;
         VectorClass *partial_lh_tmp = SITE_MODEL ? (VectorClass*)vec_left+2*nstates : (VectorClass*)vec_left+block;
 
-        auto leftStateRow = this->getConvertedSequenceByNumber(left->node->id);
+        auto leftStateRow = this->getTipStateRow(left->node->id);
         auto unknown = aln->STATE_UNKNOWN;
         
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
@@ -2092,7 +2146,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         // special treatment for TIP-INTERNAL NODE case
         double *tip_partial_lh_node = &tip_partial_lh[dad->id * max_orig_nptn * nstates];
         double *vec_tip = buffer_partial_lh_ptr + tip_block * VectorClass::size() * packet_id;
-        auto stateRow = this->getConvertedSequenceByNumber(dad->id);
+        auto stateRow = this->getTipStateRow(dad->id);
         auto unknown  = aln->STATE_UNKNOWN;
 
         size_t offset     = ptn_lower*block;
@@ -2785,7 +2839,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
             }
         }
         
-        auto stateRow = this->getConvertedSequenceByNumber(dad->id);
+        auto stateRow = this->getTipStateRow(dad->id);
         auto unknown  = aln->STATE_UNKNOWN;
     	// now do the real computation
 #ifdef _OPENMP
@@ -128,7 +128,7 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info
                 if (child->node->isLeaf()) {
                     // external node
                     // load data for tip
-                    auto childStateRow = this->getConvertedSequenceByNumber(child->node->id);
+                    auto childStateRow = this->getTipStateRow(child->node->id);
                     auto unknown  = aln->STATE_UNKNOWN;
                     for (size_t x = 0; x < VectorClass::size(); x++) {
                         int state;
@@ -273,7 +273,7 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info
         memset(dad_branch->scale_num + (SAFE_NUMERIC ? ptn_lower*ncat_mix : ptn_lower), 0, scale_size * sizeof(UBYTE));
         
         if (isRootLeaf(left->node)) {
-            auto rightStateRow = this->getConvertedSequenceByNumber(right->node->id);
+            auto rightStateRow = this->getTipStateRow(right->node->id);
             auto unknown  = aln->STATE_UNKNOWN;
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 double *vright = dad_branch->partial_lh + ptn*block;
@@ -305,8 +305,8 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info
                     partial_lh[i] *= partial_lh_left[i];
             }
         } else {
-            auto leftStateRow  = this->getConvertedSequenceByNumber(left->node->id);
-            auto rightStateRow = this->getConvertedSequenceByNumber(right->node->id);
+            auto leftStateRow  = this->getTipStateRow(left->node->id);
+            auto rightStateRow = this->getTipStateRow(right->node->id);
             bool flat = (leftStateRow!=nullptr && rightStateRow!=nullptr);
             auto unknown  = aln->STATE_UNKNOWN;
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
@@ -399,7 +399,7 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info
         
         double *partial_lh_left = partial_lh_leaves;
         double *vec_left = buffer_partial_lh_ptr + (block*2)*VectorClass::size() * packet_id;
-        auto leftStateRow  = this->getConvertedSequenceByNumber(left->node->id);
+        auto leftStateRow  = this->getTipStateRow(left->node->id);
         auto unknown  = aln->STATE_UNKNOWN;
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
             VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
@@ -734,7 +734,7 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
                 computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
             }
             double *vec_tip = buffer_partial_lh_ptr + block*3*VectorClass::size() * packet_id;
-            auto dadStateRow  = this->getConvertedSequenceByNumber(dad->id);
+            auto dadStateRow  = this->getTipStateRow(dad->id);
             auto unknown  = aln->STATE_UNKNOWN;
 
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
@@ -1181,7 +1181,7 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
             memset(_pattern_lh_cat+ptn_lower*ncat_mix, 0, sizeof(double)*(ptn_upper-ptn_lower)*ncat_mix);
 
             double *vec_tip = buffer_partial_lh_ptr + block*VectorClass::size() * packet_id;
-            auto dadStateRow  = this->getConvertedSequenceByNumber(dad->id);
+            auto dadStateRow  = this->getTipStateRow(dad->id);
             auto unknown  = aln->STATE_UNKNOWN;
 
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
@@ -47,6 +47,8 @@ void PhyloTree::setDotProductSSE() {
 
 void PhyloTree::setLikelihoodKernelSSE() {
     vector_size = 2;
+    // number of states to select a fixed-state kernel, 0 for the generic kernel
+    int num_states = params->kernel_generic ? 0 : aln->num_states;
     bool site_model = model_factory && model_factory->model->isSiteSpecificModel();
 
     if (site_model && ((model_factory && !model_factory->model->isReversible()) || params->kernel_nonrev))
@@ -56,7 +58,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
     computeLikelihoodDervMixlenPointer = NULL;
 
     if (site_model && safe_numeric) {
-        switch (aln->num_states) {
+        switch (num_states) {
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec2d, SAFE_LH, 4, false, true>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec2d, SAFE_LH, 4, false, true>;
@@ -80,7 +82,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
     }
 
     if (site_model) {
-        switch (aln->num_states) {
+        switch (num_states) {
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec2d, NORM_LH, 4, false, true>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec2d, NORM_LH, 4, false, true>;
@@ -103,7 +105,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
     if ((model_factory && !model_factory->model->isReversible()) || params->kernel_nonrev) {
         // if nonreversible model
         if (safe_numeric) {
-        switch (aln->num_states) {
+        switch (num_states) {
         case 4:
             computeLikelihoodBranchPointer  = &PhyloTree::computeNonrevLikelihoodBranchSIMD <Vec2d, SAFE_LH, 4>;
             computeLikelihoodDervPointer    = &PhyloTree::computeNonrevLikelihoodDervSIMD   <Vec2d, SAFE_LH, 4>;
@@ -116,7 +118,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
             break;
         }
         } else {
-            switch (aln->num_states) {
+            switch (num_states) {
                 case 4:
                     computeLikelihoodBranchPointer  = &PhyloTree::computeNonrevLikelihoodBranchSIMD <Vec2d, NORM_LH, 4>;
                     computeLikelihoodDervPointer    = &PhyloTree::computeNonrevLikelihoodDervSIMD   <Vec2d, NORM_LH, 4>;
@@ -134,7 +136,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
     }
 
     if (safe_numeric) {
-	switch(aln->num_states) {
+	switch (num_states) {
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec2d, SAFE_LH, 4>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec2d, SAFE_LH, 4>;
@@ -160,7 +162,7 @@ void PhyloTree::setLikelihoodKernelSSE() {
         return;
     }
 
-	switch(aln->num_states) {
+	switch (num_states) {
 	case 4:
         computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec2d, NORM_LH, 4>;
         computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec2d, NORM_LH, 4>;
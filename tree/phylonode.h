@@ -21,6 +21,12 @@ typedef unsigned short UBYTE;
  */
 enum RootDirection {UNDEFINED_DIRECTION, TOWARD_ROOT, AWAYFROM_ROOT};
 
+/**
+ * bit of PhyloNeighbor::partial_lh_computed: partial_lh was evicted from its memory slot
+ * but a single-precision copy is kept (memory saving technique with --lh-float)
+ */
+const int PARTIAL_LH_FLOAT = 4;
+
 /**
 A neighbor in a phylogenetic tree
 
@@ -52,6 +58,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        trans_slot = -1;
     }
 
     /**
@@ -68,6 +75,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        trans_slot = -1;
     }
 
     /**
@@ -82,6 +90,7 @@ public:
         partial_pars = NULL;
         direction = nei->direction;
         size = nei->size;
+        trans_slot = -1;
     }
 
     
@@ -182,6 +191,9 @@ private:
     /** size of subtree below this neighbor in terms of number of taxa */
     int size;
 
+    /** slot of the transition terms cache (PhyloTree::trans_cache), -1 if none */
+    int trans_slot;
+
 };
 
 /**
@@ -100,6 +100,10 @@ void PhyloTree::init() {
     theta_all = NULL;
     buffer_scale_all = NULL;
     buffer_partial_lh = NULL;
+    trans_cache = NULL;
+    trans_cache_slot_size = 0;
+    trans_cache_next = 0;
+    model_epoch = 0;
     ptn_freq = NULL;
     ptn_freq_pars = NULL;
     ptn_invar = NULL;
@@ -112,6 +116,7 @@ void PhyloTree::init() {
     num_threads = 0;
     num_packets = 0;
     max_lh_slots = 0;
+    max_float_lh_slots = 0;
     save_all_trees = 0;
     nodeBranchDists = NULL;
     // FOR: upper bounds
@@ -231,8 +236,8 @@ PhyloTree::~PhyloTree() {
     doneComputingDistances();
     aligned_free(nni_scale_num);
     aligned_free(nni_partial_lh);
-    aligned_free(central_partial_lh);
-    aligned_free(central_scale_num);
+    lh_storage_free(central_partial_lh);
+    lh_storage_free(central_scale_num);
     aligned_free(central_partial_pars);
     aligned_free(cost_matrix);
 
@@ -248,6 +253,7 @@ PhyloTree::~PhyloTree() {
     aligned_free(theta_all);
     aligned_free(buffer_scale_all);
     aligned_free(buffer_partial_lh);
+    aligned_free(trans_cache);
     aligned_free(ptn_freq);
     aligned_free(ptn_freq_pars);
     ptn_freq_computed = false;
@@ -596,6 +602,52 @@ string PhyloTree::getTreeString() {
     return tree_stream.str();
 }
 
+void PhyloTree::getTreeBinary(string &out) {
+    setRootNode(params->root);
+    encodeTree(out);
+}
+
+void PhyloTree::benchmarkTreeEncoding(int num_reps) {
+    num_reps = max(num_reps, 1);
+    string newick, tree_bin;
+    MTree tree;
+    bool is_rooted = rooted;
+
+    double start_time = getRealTime();
+    for (int i = 0; i < num_reps; i++)
+        newick = getTreeString();
+    double newick_encode = (getRealTime() - start_time) / num_reps;
+    start_time = getRealTime();
+    for (int i = 0; i < num_reps; i++) {
+        tree.freeNode();
+        stringstream str(newick);
+        tree.readTree(str, is_rooted);
+    }
+    double newick_decode = (getRealTime() - start_time) / num_reps;
+
+    start_time = getRealTime();
+    for (int i = 0; i < num_reps; i++) {
+        tree_bin.clear();
+        getTreeBinary(tree_bin);
+    }
+    double bin_encode = (getRealTime() - start_time) / num_reps;
+    start_time = getRealTime();
+    for (int i = 0; i < num_reps; i++) {
+        tree.freeNode();
+        tree.decodeTree(tree_bin.c_str(), tree_bin.size());
+    }
+    double bin_decode = (getRealTime() - start_time) / num_reps;
+
+    cout << "Tree encoding with " << leafNum << " taxa (bytes, encode and decode ms per tree):" << endl;
+    cout << "  Newick: " << newick.size() << " bytes, " << newick_encode * 1000.0 << " ms, "
+        << newick_decode * 1000.0 << " ms" << endl;
+    cout << "  Binary: " << tree_bin.size() << " bytes, " << bin_encode * 1000.0 << " ms, "
+        << bin_decode * 1000.0 << " ms" << endl;
+    if (bin_decode > 0.0)
+        cout << "  Binary is " << (double)newick.size() / tree_bin.size() << "x smaller and decodes "
+            << newick_decode / bin_decode << "x faster" << endl;
+}
+
 string PhyloTree::getTopologyString(bool printBranchLength) {
     stringstream tree_stream;
     // important: to make topology string unique
@@ -664,6 +716,8 @@ Node* PhyloTree::newNode(int node_id, int node_name) {
 }
 
 void PhyloTree::clearAllPartialLH(bool make_null) {
+    // invalidates the transition terms cache
+    model_epoch++;
     if (!root) {
         return;
     }
@@ -890,6 +944,8 @@ size_t PhyloTree::getBufferPartialLhSize() {
 void PhyloTree::initializeAllPartialLh() {
     int index, indexlh;
     int numStates = model->num_states;
+    if (!isSuperTree())
+        aln->buildSequenceStates();
     // Minh's question: why getAlnNSite() but not getAlnNPattern() ?
     //size_t mem_size = ((getAlnNSite() % 2) == 0) ? getAlnNSite() : (getAlnNSite() + 1);
     // extra #numStates for ascertainment bias correction
@@ -922,7 +978,7 @@ void PhyloTree::initializeAllPartialLh() {
         ptn_invar = aligned_alloc<double>(mem_size);
     initializeAllPartialLh(index, indexlh);
     if (params->lh_mem_save == LM_MEM_SAVE)
-        mem_slots.init(this, max_lh_slots);
+        mem_slots.init(this, max_lh_slots, max_float_lh_slots);
         
     ASSERT(index == (nodeNum - 1) * 2);
     if (params->lh_mem_save == LM_PER_NODE) {
@@ -936,8 +992,8 @@ void PhyloTree::initializeAllPartialLh() {
 void PhyloTree::deleteAllPartialLh() {
     //Note: aligned_free now sets the pointer to nullptr
     //      (so there's no need to do that explicitly any more)
-    aligned_free(central_partial_lh);
-    aligned_free(central_scale_num);
+    lh_storage_free(central_partial_lh);
+    lh_storage_free(central_scale_num);
     aligned_free(central_partial_pars);
     aligned_free(nni_scale_num);
     aligned_free(nni_partial_lh);
@@ -950,6 +1006,9 @@ void PhyloTree::deleteAllPartialLh() {
     aligned_free(_pattern_lh_cat);
     aligned_free(_pattern_lh);
     aligned_free(_site_lh);
+    aligned_free(trans_cache);
+    trans_cache_slots.clear();
+    trans_cache_slot_size = 0;
 
     ptn_freq_computed = false;
     tip_partial_lh    = nullptr;
@@ -988,6 +1047,11 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
     if (model)
         mem_size += model->getMemoryRequired();
 
+    // memory for transition terms cache
+    if (model && site_rate && model_factory && params->trans_cache_size > 0 && nodeNum > 1)
+        mem_size += min((int64_t)params->trans_cache_size << 20,
+                        (int64_t)(getTransCacheSlotSize() * sizeof(double)) * (nodeNum-1) * 2);
+
     int64_t lh_scale_size = block_size * sizeof(double) + scale_block_size * sizeof(UBYTE);
 
     max_lh_slots = leafNum-2;
@@ -1014,6 +1078,16 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
         }
     }
 
+    max_float_lh_slots = 0;
+    if (!full_mem && params->lh_mem_save == LM_MEM_SAVE && params->lh_float && max_lh_slots < leafNum-2) {
+        // spend half of the slots on single-precision copies of evicted vectors
+        int64_t float_lh_scale_size = block_size * sizeof(float) + scale_block_size * (sizeof(int16_t) + sizeof(UBYTE));
+        int64_t double_slots = max(max_lh_slots/2, (int64_t)(log2(leafNum)+LH_MIN_CONST));
+        max_float_lh_slots = (max_lh_slots - double_slots) * lh_scale_size / float_lh_scale_size;
+        max_float_lh_slots = min(max_float_lh_slots, (int64_t)(2*leafNum));
+        max_lh_slots = double_slots;
+        mem_size += max_float_lh_slots * float_lh_scale_size;
+    }
 
     // also count MEM for nni_partial_lh
     mem_size += (max_lh_slots+2) * lh_scale_size;
@@ -1082,7 +1156,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
             if (verbose_mode >= VB_MAX)
                 cout << "Allocating " << mem_size * sizeof(double) << " bytes for partial likelihood vectors" << endl;
             try {
-                central_partial_lh = aligned_alloc<double>(mem_size);
+                central_partial_lh = lh_storage_alloc<double>(mem_size);
             } catch (std::bad_alloc &ba) {
                 outError("Not enough memory for partial likelihood vectors (bad_alloc)");
             }
@@ -1103,7 +1177,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
             if (verbose_mode >= VB_MAX)
                 cout << "Allocating " << mem_size * sizeof(UBYTE) << " bytes for scale num vectors" << endl;
             try {
-                central_scale_num = aligned_alloc<UBYTE>(mem_size);
+                central_scale_num = lh_storage_alloc<UBYTE>(mem_size);
             } catch (std::bad_alloc &ba) {
                 outError("Not enough memory for scale num vectors (bad_alloc)");
             }
@@ -4318,80 +4392,201 @@ NNIMove PhyloTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NNIMove
 double PhyloTree::optimizeSPR_old(double cur_score, PhyloNode *node, PhyloNode *dad) {
     if (!node)
         node = (PhyloNode*) root;
+
+    if (dad && !dad->isLeaf()) {
+        double score = optimizeSPRSubtree(cur_score, node, dad);
+        // if likelihood score improves, return
+        if (score > cur_score)
+            return score;
+    }
+
+    FOR_NEIGHBOR_IT(node, dad, it){
+    double score = optimizeSPR_old(cur_score, (PhyloNode*) (*it)->node, node);
+
+    if (score > cur_score) return score;
+}
+    return cur_score;
+}
+
+double PhyloTree::optimizeSPRSubtree(double cur_score, PhyloNode *node, PhyloNode *dad) {
     PhyloNeighbor * dad1_nei = NULL;
     PhyloNeighbor * dad2_nei = NULL;
     PhyloNode * sibling1 = NULL;
     PhyloNode * sibling2 = NULL;
     double sibling1_len = 0.0, sibling2_len = 0.0;
 
-    if (dad && !dad->isLeaf()) {
-
-        ASSERT(dad->degree() == 3);
-        // assign the sibling of node, with respect to dad
+    ASSERT(dad->degree() == 3);
+    // assign the sibling of node, with respect to dad
 
-        FOR_NEIGHBOR_DECLARE(dad, node, it) {
-            if (!sibling1) {
-                dad1_nei = (PhyloNeighbor*) (*it);
-                sibling1 = (PhyloNode*) (*it)->node;
-                sibling1_len = (*it)->length;
-            } else {
+    FOR_NEIGHBOR_DECLARE(dad, node, it) {
+        if (!sibling1) {
+            dad1_nei = (PhyloNeighbor*) (*it);
+            sibling1 = (PhyloNode*) (*it)->node;
+            sibling1_len = (*it)->length;
+        } else {
 
-                dad2_nei = (PhyloNeighbor*) (*it);
-                sibling2 = (PhyloNode*) (*it)->node;
-                sibling2_len = (*it)->length;
-            }
+            dad2_nei = (PhyloNeighbor*) (*it);
+            sibling2 = (PhyloNode*) (*it)->node;
+            sibling2_len = (*it)->length;
         }
-        // remove the subtree leading to node
-        double sum_len = sibling1_len + sibling2_len;
-        sibling1->updateNeighbor(dad, sibling2, sum_len);
-        sibling2->updateNeighbor(dad, sibling1, sum_len);
-        PhyloNeighbor* sibling1_nei = (PhyloNeighbor*) sibling1->findNeighbor(sibling2);
-        PhyloNeighbor* sibling2_nei = (PhyloNeighbor*) sibling2->findNeighbor(sibling1);
-        sibling1_nei->clearPartialLh();
-        sibling2_nei->clearPartialLh();
+    }
+    // remove the subtree leading to node
+    double sum_len = sibling1_len + sibling2_len;
+    sibling1->updateNeighbor(dad, sibling2, sum_len);
+    sibling2->updateNeighbor(dad, sibling1, sum_len);
+    PhyloNeighbor* sibling1_nei = (PhyloNeighbor*) sibling1->findNeighbor(sibling2);
+    PhyloNeighbor* sibling2_nei = (PhyloNeighbor*) sibling2->findNeighbor(sibling1);
+    sibling1_nei->clearPartialLh();
+    sibling2_nei->clearPartialLh();
 
-        // now try to move the subtree to somewhere else
-        vector<PhyloNeighbor*> spr_path;
+    // now try to move the subtree to somewhere else
+    vector<PhyloNeighbor*> spr_path;
 
-        FOR_NEIGHBOR(sibling1, sibling2, it)
-        {
-            spr_path.push_back(sibling1_nei);
-            double score = swapSPR_old(cur_score, 1, node, dad, sibling1, sibling2, (PhyloNode*) (*it)->node, sibling1,
-                    spr_path);
-            // if likelihood score improves, return
-            if (score > cur_score)
+    FOR_NEIGHBOR(sibling1, sibling2, it)
+    {
+        spr_path.push_back(sibling1_nei);
+        double score = swapSPR_old(cur_score, 1, node, dad, sibling1, sibling2, (PhyloNode*) (*it)->node, sibling1,
+                spr_path);
+        // if likelihood score improves, return
+        if (score > cur_score)
 
-                return score;
-            spr_path.pop_back();
-        }
+            return score;
+        spr_path.pop_back();
+    }
 
-        FOR_NEIGHBOR(sibling2, sibling1, it)
-        {
-            spr_path.push_back(sibling2_nei);
-            double score = swapSPR_old(cur_score, 1, node, dad, sibling1, sibling2, (PhyloNode*) (*it)->node, sibling2,
-                    spr_path);
-            // if likelihood score improves, return
-            if (score > cur_score)
+    FOR_NEIGHBOR(sibling2, sibling1, it)
+    {
+        spr_path.push_back(sibling2_nei);
+        double score = swapSPR_old(cur_score, 1, node, dad, sibling1, sibling2, (PhyloNode*) (*it)->node, sibling2,
+                spr_path);
+        // if likelihood score improves, return
+        if (score > cur_score)
 
-                return score;
-            spr_path.pop_back();
-        }
-        // if likelihood does not imporve, swap back
-        sibling1->updateNeighbor(sibling2, dad, sibling1_len);
-        sibling2->updateNeighbor(sibling1, dad, sibling2_len);
-        dad1_nei->node = sibling1;
-        dad1_nei->length = sibling1_len;
-        dad2_nei->node = sibling2;
-        dad2_nei->length = sibling2_len;
-        clearAllPartialLH();
+            return score;
+        spr_path.pop_back();
     }
+    // if likelihood does not imporve, swap back
+    sibling1->updateNeighbor(sibling2, dad, sibling1_len);
+    sibling2->updateNeighbor(sibling1, dad, sibling2_len);
+    dad1_nei->node = sibling1;
+    dad1_nei->length = sibling1_len;
+    dad2_nei->node = sibling2;
+    dad2_nei->length = sibling2_len;
+    clearAllPartialLH();
+    return cur_score;
+}
 
-    FOR_NEIGHBOR_IT(node, dad, it){
-    double score = optimizeSPR_old(cur_score, (PhyloNode*) (*it)->node, node);
+int PhyloTree::getSPRParallelThreads() {
+    // each copy allocates all partial likelihoods, which -mem does not allow
+    if (params->lh_mem_save == LM_MEM_SAVE)
+        return 1;
+    // getMemoryRequired() also sets the number of slots, which this tree already uses
+    int64_t saved_lh_slots = max_lh_slots, saved_float_lh_slots = max_float_lh_slots;
+    uint64_t mem_per_copy = getMemoryRequired();
+    max_lh_slots = saved_lh_slots;
+    max_float_lh_slots = saved_float_lh_slots;
+    // this tree is already allocated, leave some RAM to the rest of the program
+    int64_t free_mem = (int64_t)(getMemorySize() * 0.9) - (int64_t)mem_per_copy;
+    int64_t max_copies = (free_mem > 0 && mem_per_copy > 0) ? free_mem / mem_per_copy : 0;
+    return max((int)min((int64_t)num_threads, max_copies), 1);
+}
+
+int PhyloTree::optimizeSPRParallel(double cur_score, int spr_threads) {
+    // all nodes of this tree indexed by ID
+    NodeVector all_nodes, id_nodes(nodeNum, NULL);
+    getAllNodesInSubtree(root->neighbors[0]->node, NULL, all_nodes);
+    for (auto node : all_nodes)
+        id_nodes[node->id] = node;
+
+    // prune points (node, dad) as pairs of node IDs, for both directions of every branch
+    NodeVector nodes1, nodes2;
+    getBranches(nodes1, nodes2);
+    vector<pair<int, int> > prune_points;
+    for (size_t i = 0; i < nodes1.size(); i++) {
+        if (!nodes1[i]->isLeaf())
+            prune_points.push_back(make_pair(nodes2[i]->id, nodes1[i]->id));
+        if (!nodes2[i]->isLeaf())
+            prune_points.push_back(make_pair(nodes1[i]->id, nodes2[i]->id));
+    }
 
-    if (score > cur_score) return score;
-}
-    return cur_score;
+    // internal node IDs are written as node names to map the thread-private copies back
+    stringstream tree_stream;
+    printTree(tree_stream, WT_BR_LEN + WT_INT_NODE);
+    string tree_string = tree_stream.str();
+
+    // best moves found by each thread, only touched by its owner
+    vector<SPRMoves> thread_moves(spr_threads);
+    // set once any thread found an improving move, the others then skip remaining prune points
+    std::atomic<bool> improved(false);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(spr_threads)
+#endif
+    {
+#ifdef _OPENMP
+        int thread_id = omp_get_thread_num();
+#else
+        int thread_id = 0;
+#endif
+        PhyloTree *tree = new PhyloTree;
+        tree->setParams(params);
+        stringstream ss(tree_string);
+        // readTree() may change the flag, so each thread reads with its own copy
+        bool tree_rooted = rooted;
+        tree->readTree(ss, tree_rooted);
+        tree->setAlignment(aln);
+        // give internal nodes the IDs of this tree
+        NodeVector tree_nodes;
+        tree->getAllNodesInSubtree(tree->root->neighbors[0]->node, NULL, tree_nodes);
+        NodeVector tree_id_nodes(nodeNum, NULL);
+        for (auto node : tree_nodes) {
+            if (!node->isLeaf()) {
+                node->id = convert_int(node->name.c_str());
+                node->name = "";
+            }
+            tree_id_nodes[node->id] = node;
+        }
+        tree->sse = sse;
+        tree->setNumThreads(1);
+        tree->setModelFactory(model_factory);
+        tree->initializeAllPartialLh();
+        tree->spr_radius = spr_radius;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int i = 0; i < prune_points.size(); i++) {
+            if (improved)
+                continue;
+            PhyloNode *node = (PhyloNode*)tree_id_nodes[prune_points[i].first];
+            PhyloNode *dad = (PhyloNode*)tree_id_nodes[prune_points[i].second];
+            // every regrafting is undone and recorded in tree->spr_moves
+            tree->optimizeSPRSubtree(DBL_MAX, node, dad);
+            if (!tree->spr_moves.empty() && tree->spr_moves.begin()->score > cur_score)
+                improved = true;
+        }
+
+        for (auto move : tree->spr_moves)
+            thread_moves[thread_id].add(
+                (PhyloNode*)id_nodes[move.prune_node->id], (PhyloNode*)id_nodes[move.prune_dad->id],
+                (PhyloNode*)id_nodes[move.regraft_node->id], (PhyloNode*)id_nodes[move.regraft_dad->id],
+                move.score);
+
+        tree->setModelFactory(NULL);
+        tree->setModel(NULL);
+        tree->setRate(NULL);
+        delete tree;
+    }
+
+    // merge the best moves of all threads
+    int num_improved = 0;
+    for (auto &moves : thread_moves)
+        for (auto move : moves) {
+            spr_moves.add(move.prune_node, move.prune_dad, move.regraft_node, move.regraft_dad, move.score);
+            if (move.score > cur_score)
+                num_improved++;
+        }
+    return num_improved;
 }
 
 /**
@@ -4792,7 +4987,13 @@ double PhyloTree::optimizeSPR() {
     for (int i = 0; i < 100; i++) {
         cout << "i = " << i << endl;
         spr_moves.clear();
-        double score = optimizeSPR_old(cur_score, (PhyloNode*) root->neighbors[0]->node);
+        double score = cur_score;
+        int spr_threads = (num_threads > 1 && !isSuperTree() && !rooted) ? getSPRParallelThreads() : 1;
+        if (spr_threads > 1)
+            // moves are only collected, the best ones are applied below
+            optimizeSPRParallel(cur_score, spr_threads);
+        else
+            score = optimizeSPR_old(cur_score, (PhyloNode*) root->neighbors[0]->node);
         clearAllPartialLH();
         // why this?
         if (score <= cur_score) {
@@ -5904,15 +6105,129 @@ void PhyloTree::reorientPartialLh(PhyloNeighbor* dad_branch, Node *dad) {
         helper functions for computing tree traversal
  ****************************************************************************/
 
+size_t PhyloTree::getTraversalTileSize(size_t vector_size) {
+    if (params->lh_tile_size >= 0)
+        return roundUpToMultiple((size_t)params->lh_tile_size, vector_size);
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures();
+    size_t ptn_bytes = ncat_mix * (aln->num_states * sizeof(double) + sizeof(UBYTE));
+    size_t tile = getCacheSize() / 2 / (3 * ptn_bytes);
+    tile -= tile % vector_size;
+    return max(tile, vector_size);
+}
+
+size_t PhyloTree::getTransCacheSlotSize() {
+    size_t nstates = aln->num_states;
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures();
+    size_t block = nstates * ncat_mix;
+    return block * nstates + (aln->STATE_UNKNOWN+1) * block;
+}
+
+void PhyloTree::assignTransCache() {
+    if (params->trans_cache_size <= 0 || isMixlen() || !model_factory)
+        return;
+    size_t slot_size = getTransCacheSlotSize();
+    if (slot_size != trans_cache_slot_size) {
+        // number of states or categories changed, start over
+        aligned_free(trans_cache);
+        trans_cache_slots.clear();
+        trans_cache_slot_size = slot_size;
+        trans_cache_next = 0;
+        // no more slots than directed branches
+        size_t num_slots = ((size_t)params->trans_cache_size << 20) / (slot_size * sizeof(double));
+        num_slots = min(num_slots, (size_t)(nodeNum-1)*2);
+        if (num_slots == 0)
+            return;
+        trans_cache = aligned_alloc<double>(num_slots * slot_size);
+        TransCacheSlot empty_slot = {NULL, NULL, 0.0, UNDEFINED_DIRECTION, -1};
+        trans_cache_slots.resize(num_slots, empty_slot);
+    }
+    if (trans_cache_slots.empty())
+        return;
+    for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
+        if (it->float_id >= 0)
+            continue;
+        FOR_NEIGHBOR_IT(it->dad_branch->node, it->dad, nit) {
+            PhyloNeighbor *child = (PhyloNeighbor*)*nit;
+            if (child->trans_slot >= 0 && child->trans_slot < trans_cache_slots.size() &&
+                trans_cache_slots[child->trans_slot].nei == child)
+                continue;
+            // take over the least recently assigned slot
+            TransCacheSlot &slot = trans_cache_slots[trans_cache_next];
+            slot.nei = child;
+            slot.epoch = -1;
+            child->trans_slot = trans_cache_next;
+            trans_cache_next = (trans_cache_next + 1) % trans_cache_slots.size();
+        }
+    }
+}
+
+bool PhyloTree::loadTransCache(PhyloNeighbor *child, double *echild, size_t echild_size,
+                               double *partial_lh_leaf, size_t leaf_size) {
+    if (child->trans_slot < 0 || child->trans_slot >= trans_cache_slots.size())
+        return false;
+    TransCacheSlot &slot = trans_cache_slots[child->trans_slot];
+    if (slot.nei != child || slot.epoch != getModelEpoch() || slot.node != child->node ||
+        slot.length != child->length || slot.direction != child->direction)
+        return false;
+    double *entry = trans_cache + child->trans_slot * trans_cache_slot_size;
+    memcpy(echild, entry, echild_size * sizeof(double));
+    if (child->node->isLeaf())
+        memcpy(partial_lh_leaf, entry + echild_size, leaf_size * sizeof(double));
+    return true;
+}
+
+void PhyloTree::saveTransCache(PhyloNeighbor *child, double *echild, size_t echild_size,
+                               double *partial_lh_leaf, size_t leaf_size) {
+    if (child->trans_slot < 0 || child->trans_slot >= trans_cache_slots.size())
+        return;
+    TransCacheSlot &slot = trans_cache_slots[child->trans_slot];
+    if (slot.nei != child)
+        return;
+    double *entry = trans_cache + child->trans_slot * trans_cache_slot_size;
+    memcpy(entry, echild, echild_size * sizeof(double));
+    if (child->node->isLeaf())
+        memcpy(entry + echild_size, partial_lh_leaf, leaf_size * sizeof(double));
+    slot.node = child->node;
+    slot.length = child->length;
+    slot.direction = child->direction;
+    slot.epoch = getModelEpoch();
+}
+
+void PhyloTree::prefetchTraversalInfo() {
+    if (!params->lh_mmap_dir)
+        return;
+    size_t lh_bytes = getPartialLhBytes();
+    size_t scale_bytes = getScaleNumBytes();
+    for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
+        PhyloNeighbor *dad_branch = it->dad_branch;
+        // the output vector is read back as well, as the scratch file is a shared mapping
+        ScratchMemory::prefetch(dad_branch->partial_lh, lh_bytes);
+        ScratchMemory::prefetch(dad_branch->scale_num, scale_bytes);
+        FOR_NEIGHBOR_IT(dad_branch->node, it->dad, nit) {
+            PhyloNeighbor *child = (PhyloNeighbor*)*nit;
+            if (child->node->isLeaf())
+                continue;
+            ScratchMemory::prefetch(child->partial_lh, lh_bytes);
+            ScratchMemory::prefetch(child->scale_num, scale_bytes);
+        }
+    }
+}
+
 bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad, double* &buffer) {
 
     size_t nstates = aln->num_states;
     PhyloNode *node = (PhyloNode*)dad_branch->node;
 
     if ((dad_branch->partial_lh_computed & 1) || node->isLeaf()) {
+        mem_slots.hit(dad_branch);
         return mem_slots.lock(dad_branch);
     }
 
+    // restore partial_lh from its single-precision copy instead of recomputing the subtree
+    int float_id = -1;
+    if (dad_branch->partial_lh_computed & PARTIAL_LH_FLOAT)
+        float_id = mem_slots.loadFloat(dad_branch);
+
     size_t num_leaves = 0;
     bool locked[node->degree()];
     memset(locked, 0, node->degree());
@@ -5932,7 +6247,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
 
     // recursive
     for (it = neivec.begin(); it != neivec.end(); it++) {
-        if ((*it)->node != dad) {
+        if ((*it)->node != dad && float_id < 0) {
             locked[it - neivec.begin()] = computeTraversalInfo((PhyloNeighbor*)(*it), node, buffer);
             if ((*it)->node->isLeaf()) {
                 num_leaves++;
@@ -5944,6 +6259,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
     // prepare information for this branch
     TraversalInfo info(dad_branch, dad);
     info.echildren = info.partial_lh_leaves = NULL;
+    info.float_id = float_id;
 
     // re-orient partial_lh
     reorientPartialLh(dad_branch, dad);
@@ -6000,7 +6316,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
         }
     }
 
-    if (!model->isSiteSpecificModel() && !Params::getInstance().buffer_mem_save) {
+    if (!model->isSiteSpecificModel() && !Params::getInstance().buffer_mem_save && float_id < 0) {
         //------- normal model -----
         info.echildren = buffer;
         size_t block = nstates * ((model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures());
@@ -46,7 +46,9 @@
 #include "utils/checkpoint.h"
 #include "constrainttree.h"
 #include "memslot.h"
+#include "blockscheduler.h"
 #include "utils/progress.h"
+#include "utils/scratchmemory.h"
 
 class AlignmentPairwise;
 
@@ -143,6 +145,24 @@ template <class T> T* ensure_aligned_allocated(T* & ptr, long long int size) {
     mem = nullptr;
 }
 
+/**
+ * allocate memory for partial likelihood vectors,
+ * in a memory-mapped scratch file if --lh-mmap is given
+ */
+template <class T> T *lh_storage_alloc(size_t size) {
+    if (Params::getInstance().lh_mmap_dir)
+        return (T*)ScratchMemory::allocate(Params::getInstance().lh_mmap_dir, size*sizeof(T));
+    return aligned_alloc<T>(size);
+}
+
+/** free memory allocated by lh_storage_alloc */
+template <class T> void lh_storage_free(T* &mem) {
+    if (ScratchMemory::release(mem))
+        mem = nullptr;
+    else
+        aligned_free(mem);
+}
+
 /**
  *  Row Major Array For Eigen
  */
@@ -230,6 +250,18 @@ struct PruningInfo {
 
 };
 
+/**
+    transition terms of one child branch cached for computePartialInfo,
+    valid while the branch and the model are unchanged
+ */
+struct TransCacheSlot {
+    PhyloNeighbor *nei; // neighbor owning this slot
+    Node *node; // nei->node when the terms were computed
+    double length; // nei->length when the terms were computed
+    RootDirection direction; // nei->direction when the terms were computed
+    int64_t epoch; // model epoch when the terms were computed, -1 if not computed
+};
+
 /**
  * This Structure is used in PhyloSuperTreePlen.
  */
@@ -323,10 +355,12 @@ public:
     PhyloNode *dad;
     double *echildren;
     double *partial_lh_leaves;
+    int float_id; // ID of single-precision copy to restore partial_lh from, -1 to compute it
 
     TraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad) {
         this->dad = dad;
         this->dad_branch = dad_branch;
+        this->float_id = -1;
     }
 };
 
@@ -835,6 +869,9 @@ public:
     /** number of packets used for likelihood kernel (typically more) */
     int num_packets;
 
+    /** work-stealing distribution of pattern blocks for partial likelihood traversal */
+    BlockScheduler block_scheduler;
+
     /****************************************************************************
             helper functions for computing tree traversal
      ****************************************************************************/
@@ -845,6 +882,47 @@ public:
     */
     bool computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad, double* &buffer);
 
+    /**
+        number of patterns per tile of the partial likelihood traversal (--lh-tile),
+        by default the partial_lh of a node and its two children for one tile fit into half of the L2 cache
+        @param vector_size SIMD vector size, the tile size is a multiple of it
+        @return tile size, 0 for no tiling
+    */
+    size_t getTraversalTileSize(size_t vector_size);
+
+    /**
+        number of doubles of one transition terms cache slot: echild and partial_lh_leaf of a child branch
+    */
+    size_t getTransCacheSlotSize();
+
+    /**
+        assign transition terms cache slots to the child branches of traversal_info,
+        must be called before computePartialInfo is run in parallel
+    */
+    void assignTransCache();
+
+    /**
+        copy the cached transition terms of child if they are still valid
+        @param echild (OUT) transition terms of child, echild_size doubles
+        @param partial_lh_leaf (OUT) precomputed tip terms if child is a leaf, leaf_size doubles
+        @return TRUE if copied, FALSE if they must be computed
+    */
+    bool loadTransCache(PhyloNeighbor *child, double *echild, size_t echild_size,
+                        double *partial_lh_leaf, size_t leaf_size);
+
+    /**
+        store the computed transition terms of child into its cache slot, if any,
+        parameters as for loadTransCache
+    */
+    void saveTransCache(PhyloNeighbor *child, double *echild, size_t echild_size,
+                        double *partial_lh_leaf, size_t leaf_size);
+
+    /**
+        with --lh-mmap, ask the OS to read the partial_lh vectors used by traversal_info from
+        the scratch file before they are computed
+    */
+    void prefetchTraversalInfo();
+
 
     /**
         compute traversal_info of both subtrees
@@ -1246,6 +1324,19 @@ public:
      */
     virtual string getTreeString();
 
+    /**
+     * Append the tree in the binary form of MTree::encodeTree, with taxon IDs and branch lengths,
+     * rooted the same way as getTreeString
+     * @param[out] out buffer to append to
+     */
+    void getTreeBinary(string &out);
+
+    /**
+     * compare size, encoding and decoding time of the current tree in newick and in binary form
+     * @param num_reps number of times each tree is encoded and decoded
+     */
+    void benchmarkTreeEncoding(int num_reps);
+
     /**
      * Assign branch lengths for branch that has no or negative length
      * With single model branch lengths are assigned using parsimony. With partition model
@@ -1540,6 +1631,32 @@ public:
     /** buffer used when computing partial_lh, to avoid repeated mem allocation */
     double *buffer_partial_lh;
 
+    /**
+        cache of transition terms of child branches (--trans-cache), to skip recomputing
+        echild and partial_lh_leaf in computePartialInfo if neither branch nor model changed
+    */
+    double *trans_cache;
+
+    /** owners and keys of the trans_cache slots */
+    vector<TransCacheSlot> trans_cache_slots;
+
+    /** number of doubles per trans_cache slot */
+    size_t trans_cache_slot_size;
+
+    /** next trans_cache slot to reassign, round robin */
+    size_t trans_cache_next;
+
+    /** increased by clearAllPartialLH(), see getModelEpoch() */
+    int64_t model_epoch;
+
+    /**
+        @return epoch of the model of this tree. It changes with clearAllPartialLH() and whenever
+                parameters of any substitution or rate heterogeneity model change
+    */
+    int64_t getModelEpoch() {
+        return model_epoch + ModelSubst::getParamEpoch() + RateHeterogeneity::getParamEpoch();
+    }
+
     /**
      * frequencies of alignment patterns, used as buffer for likelihood computation
      */
@@ -1685,6 +1802,16 @@ public:
     virtual size_t getConvertedSequenceLength() const;
     
     virtual const char* getConvertedSequenceByNumber(int seq1) const;
+
+    /**
+        @param seq sequence ID
+        @return states of a tip at all patterns, from the converted sequences if available,
+        otherwise from the sequence-state matrix of the alignment, NULL if neither is built
+    */
+    inline const char* getTipStateRow(int seq) const {
+        const char *row = getConvertedSequenceByNumber(seq);
+        return row ? row : aln->getSequenceStates(seq);
+    }
     
     virtual const int* getConvertedSequenceFrequencies() const;
     
@@ -1858,6 +1985,32 @@ public:
             PhyloNode *orig_node1, PhyloNode *orig_node2,
             PhyloNode *node2, PhyloNode *dad2, vector<PhyloNeighbor*> &spr_path);
 
+    /**
+            try to regraft the subtree (dad-node) to all branches within spr_radius
+            @param cur_score current likelihood score
+            @param node the root of the pruned subtree
+            @param dad the node where the subtree is pruned, must be internal
+            @return score of the first improving regrafting, which is kept in the tree,
+                    cur_score if none improves and the tree is restored
+     */
+    double optimizeSPRSubtree(double cur_score, PhyloNode *node, PhyloNode *dad);
+
+    /**
+            evaluate the regraftings of all prune points concurrently, each thread
+            working on a private copy of the tree. The best moves of all threads
+            are merged into spr_moves, referring to the nodes of this tree.
+            @param cur_score current likelihood score
+            @param spr_threads number of threads, see getSPRParallelThreads()
+            @return number of merged moves improving cur_score
+     */
+    int optimizeSPRParallel(double cur_score, int spr_threads);
+
+    /**
+            @return number of private tree copies for optimizeSPRParallel() that fit into RAM,
+                    at most num_threads. 1 if the memory of the tree is limited by -mem
+     */
+    int getSPRParallelThreads();
+
     /**
             move the subtree (dad1-node1) to the branch (dad2-node2)
      */
@@ -2040,6 +2193,21 @@ public:
     void setLikelihoodKernelAVX512();
 #endif
     virtual void setLikelihoodKernelSSE();
+
+    /**
+            time full likelihood traversals with the fixed-state and the generic likelihood kernel
+            of the current instruction set and print the comparison, then benchmark all kernel families
+            @param num_reps number of traversals per kernel
+     */
+    void benchmarkLikelihoodKernels(int num_reps);
+
+    /**
+            time computePartialLikelihood, computeLikelihoodBranch, computeLikelihoodDerv and the
+            parsimony kernel for every instruction set up to the one of the CPU and for a thread-scaling
+            curve, print a table and write it as JSON into <prefix>.kernels.json
+            @param num_reps number of calls per kernel
+     */
+    void benchmarkKernelFamilies(int num_reps);
     
     /****************************************************************************
             Public variables
@@ -2160,6 +2328,11 @@ public:
     
     void getMemoryRequired(uint64_t &partial_lh_entries, uint64_t &scale_num_entries, uint64_t &partial_pars_entries);
 
+    /**
+     * print hit/miss/recomputation statistics of the memory saving technique (-mem)
+     */
+    void printMemSaveStats(ostream &out) { mem_slots.printStats(out); }
+
     /****** following variables are for ultra-fast bootstrap *******/
     /** 2 to save all trees, 1 to save intermediate trees */
     int save_all_trees;
@@ -2395,6 +2568,9 @@ protected:
     /** maximum number of partial_lh_slots */
     int64_t max_lh_slots;
 
+    /** maximum number of single-precision copies of evicted partial_lh vectors (--lh-float) */
+    int64_t max_float_lh_slots;
+
     /** mapping from */
     MemSlotVector mem_slots;
 
@@ -203,6 +203,277 @@ void PhyloTree::changeLikelihoodKernel(LikelihoodKernel lk) {
     setLikelihoodKernel(lk);
 }
 
+void PhyloTree::benchmarkLikelihoodKernels(int num_reps) {
+    bool orig_kernel_generic = params->kernel_generic;
+    bool orig_lk_safe_scaling = params->lk_safe_scaling;
+    // use the same scaling for both kernels, so that only the kernel code differs
+    params->lk_safe_scaling = true;
+
+    cout << "Benchmarking likelihood kernels with " << num_reps << " full traversals ("
+        << aln->num_states << " states, " << getAlnNPattern() << " patterns, "
+        << num_threads << " threads)" << endl;
+
+    double fixed_time = 0.0;
+    for (int generic = 0; generic <= 1; generic++) {
+        params->kernel_generic = generic;
+        setLikelihoodKernel(sse);
+        clearAllPartialLH();
+        // warm-up traversal
+        double tree_lh = computeLikelihood();
+        double start_time = getRealTime();
+        for (int rep = 0; rep < num_reps; rep++) {
+            clearAllPartialLH();
+            tree_lh = computeLikelihood();
+        }
+        double bench_time = getRealTime() - start_time;
+        cout << (generic ? "Generic kernel:     " : "Fixed-state kernel: ")
+            << bench_time << " sec (" << bench_time * 1000.0 / max(num_reps, 1) << " ms per traversal)"
+            << ", log-likelihood: " << tree_lh;
+        if (generic && fixed_time > 0.0)
+            cout << ", speedup of fixed-state kernel: " << bench_time / fixed_time << "x";
+        cout << endl;
+        if (!generic)
+            fixed_time = bench_time;
+    }
+
+    params->kernel_generic = orig_kernel_generic;
+    params->lk_safe_scaling = orig_lk_safe_scaling;
+    setLikelihoodKernel(sse);
+
+    // traversal with and without cache tiling of the pattern blocks
+    int orig_lh_tile_size = params->lh_tile_size;
+    double untiled_time = 0.0;
+    for (int tiled = 0; tiled <= 1; tiled++) {
+        params->lh_tile_size = tiled ? orig_lh_tile_size : 0;
+        if (tiled && params->lh_tile_size == 0)
+            params->lh_tile_size = -1;
+        clearAllPartialLH();
+        double tree_lh = computeLikelihood();
+        double start_time = getRealTime();
+        for (int rep = 0; rep < num_reps; rep++) {
+            clearAllPartialLH();
+            tree_lh = computeLikelihood();
+        }
+        double bench_time = getRealTime() - start_time;
+        if (tiled)
+            cout << "Tiled traversal (" << getTraversalTileSize(vector_size) << " patterns per tile): ";
+        else
+            cout << "Untiled traversal: ";
+        cout << bench_time << " sec (" << bench_time * 1000.0 / max(num_reps, 1) << " ms per traversal)"
+            << ", log-likelihood: " << tree_lh;
+        if (tiled && bench_time > 0.0)
+            cout << ", speedup of tiling: " << untiled_time / bench_time << "x";
+        cout << endl;
+        if (!tiled)
+            untiled_time = bench_time;
+    }
+    params->lh_tile_size = orig_lh_tile_size;
+    clearAllPartialLH();
+
+    benchmarkKernelFamilies(num_reps);
+}
+
+/**
+    timing of one kernel family for one instruction set and thread count
+ */
+struct KernelTiming {
+    string isa;
+    string kernel;
+    int threads;
+    double seconds;
+    /** number of pattern x node operations */
+    double work;
+    /** nominal floating point operations, 0 for parsimony */
+    double flops;
+};
+
+/**
+    @param str any string
+    @return str as a quoted JSON string
+ */
+static string quoteJSON(const string &str) {
+    string res = "\"";
+    for (unsigned char c : str) {
+        switch (c) {
+        case '"': res += "\\\""; break;
+        case '\\': res += "\\\\"; break;
+        case '\n': res += "\\n"; break;
+        case '\r': res += "\\r"; break;
+        case '\t': res += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                res += buf;
+            } else
+                res += c;
+        }
+    }
+    return res + "\"";
+}
+
+void PhyloTree::benchmarkKernelFamilies(int num_reps) {
+    LikelihoodKernel orig_sse = sse;
+    int orig_num_threads = num_threads;
+
+    // instruction sets up to the one of this CPU
+    vector<LikelihoodKernel> isa_kernels;
+    vector<string> isa_names;
+    isa_kernels.push_back(LK_SSE2);
+    isa_names.push_back("SSE");
+#if !defined(BINARY32) && !defined(__NOAVX__)
+    if (orig_sse >= LK_AVX) {
+        isa_kernels.push_back(LK_AVX);
+        isa_names.push_back("AVX");
+    }
+    if (orig_sse >= LK_AVX_FMA) {
+        isa_kernels.push_back(LK_AVX_FMA);
+        isa_names.push_back("FMA");
+    }
+#endif
+#ifdef __AVX512KNL
+    if (orig_sse >= LK_AVX512) {
+        isa_kernels.push_back(LK_AVX512);
+        isa_names.push_back("AVX512");
+    }
+#endif
+    // thread-scaling curve, powers of two up to the current number of threads
+    IntVector thread_counts;
+    for (int threads = 1; threads < orig_num_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(orig_num_threads);
+
+    // nominal flops per pattern of each kernel, counting a multiply-add as 2 flops:
+    // partial_lh multiplies 2 children by the transition terms, the branch likelihood
+    // does it once, the derivatives take 3 dot products with theta_all
+    double nptn = getAlnNPattern();
+    size_t nstates = aln->num_states;
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures();
+    double block = nstates * ncat_mix;
+    double partial_flops = nptn * block * (4.0*nstates + 1.0);
+    double branch_flops = nptn * block * (2.0*nstates + 1.0);
+    double derv_flops = nptn * block * 6.0;
+    // one partial_lh vector per internal node in a full traversal
+    double num_internal = max((int)leafNum - 2, 1);
+
+    cout << "Benchmarking kernel families for " << isa_names.size() << " instruction sets and "
+        << thread_counts.size() << " thread counts" << endl;
+
+    vector<KernelTiming> timings;
+    for (size_t k = 0; k < isa_kernels.size(); k++) {
+        setLikelihoodKernel(isa_kernels[k]);
+        for (auto threads : thread_counts) {
+            setNumThreads(threads);
+            KernelTiming timing;
+            timing.isa = isa_names[k];
+            timing.threads = num_threads;
+
+            // full traversals of partial likelihoods
+            clearAllPartialLH();
+            double tree_lh = computeLikelihood();
+            double start_time = getRealTime();
+            for (int rep = 0; rep < num_reps; rep++) {
+                clearAllPartialLH();
+                tree_lh = computeLikelihood();
+            }
+            timing.kernel = "computePartialLikelihood";
+            timing.seconds = getRealTime() - start_time;
+            timing.work = nptn * num_internal * num_reps;
+            timing.flops = partial_flops * num_internal * num_reps;
+            timings.push_back(timing);
+
+            // likelihood of one branch, with the partial_lh of both ends computed
+            PhyloNode *branch_node = (PhyloNode*)current_it_back->node;
+            start_time = getRealTime();
+            for (int rep = 0; rep < num_reps; rep++)
+                tree_lh = computeLikelihoodBranch(current_it, branch_node);
+            timing.kernel = "computeLikelihoodBranch";
+            timing.seconds = getRealTime() - start_time;
+            timing.work = nptn * num_reps;
+            timing.flops = branch_flops * num_reps;
+            timings.push_back(timing);
+
+            // derivatives of one branch, theta_all is computed once as in a Newton-Raphson run
+            double df, ddf;
+            theta_computed = false;
+            computeLikelihoodDerv(current_it, branch_node, &df, &ddf);
+            start_time = getRealTime();
+            for (int rep = 0; rep < num_reps; rep++)
+                computeLikelihoodDerv(current_it, branch_node, &df, &ddf);
+            timing.kernel = "computeLikelihoodDerv";
+            timing.seconds = getRealTime() - start_time;
+            timing.work = nptn * num_reps;
+            timing.flops = derv_flops * num_reps;
+            timings.push_back(timing);
+            theta_computed = false;
+
+            cout << timing.isa << " " << timing.threads << " threads: log-likelihood " << tree_lh << endl;
+        }
+
+        // the parsimony kernels are single-threaded
+        setNumThreads(1);
+        KernelTiming timing;
+        timing.isa = isa_names[k];
+        timing.threads = 1;
+        clearAllPartialLH();
+        int tree_pars = computeParsimony();
+        double start_time = getRealTime();
+        for (int rep = 0; rep < num_reps; rep++) {
+            clearAllPartialLH();
+            tree_pars = computeParsimony();
+        }
+        timing.kernel = "computeParsimony";
+        timing.seconds = getRealTime() - start_time;
+        timing.work = nptn * num_internal * num_reps;
+        timing.flops = 0.0;
+        timings.push_back(timing);
+        cout << timing.isa << " parsimony score " << tree_pars << endl;
+    }
+
+    setNumThreads(orig_num_threads);
+    setLikelihoodKernel(orig_sse);
+    clearAllPartialLH();
+
+    cout << endl << "ISA     Kernel                    Threads  Time(s)  Mpattern-nodes/s  GFLOP/s" << endl;
+    for (auto &timing : timings) {
+        double seconds = max(timing.seconds, 1e-9);
+        cout << setw(8) << left << timing.isa << setw(26) << timing.kernel << right
+            << setw(7) << timing.threads << setw(9) << fixed << setprecision(3) << timing.seconds
+            << setw(18) << timing.work / seconds / 1e6 << setw(9) << timing.flops / seconds / 1e9 << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+    string json_file = string(params->out_prefix) + ".kernels.json";
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(json_file.c_str());
+        out << "{" << endl
+            << "  \"states\": " << nstates << "," << endl
+            << "  \"patterns\": " << getAlnNPattern() << "," << endl
+            << "  \"taxa\": " << leafNum << "," << endl
+            << "  \"categories\": " << ncat_mix << "," << endl
+            << "  \"model\": " << quoteJSON(getModelName()) << "," << endl
+            << "  \"reps\": " << num_reps << "," << endl
+            << "  \"results\": [" << endl;
+        for (size_t i = 0; i < timings.size(); i++) {
+            KernelTiming &timing = timings[i];
+            double seconds = max(timing.seconds, 1e-9);
+            out << "    {\"isa\": " << quoteJSON(timing.isa) << ", \"kernel\": " << quoteJSON(timing.kernel)
+                << ", \"threads\": " << timing.threads << ", \"seconds\": " << timing.seconds
+                << ", \"pattern_nodes_per_second\": " << timing.work / seconds
+                << ", \"gflops\": " << timing.flops / seconds / 1e9 << "}"
+                << ((i+1 < timings.size()) ? "," : "") << endl;
+        }
+        out << "  ]" << endl << "}" << endl;
+        out.close();
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, json_file);
+    }
+    cout << "Kernel benchmark written to " << json_file << endl;
+}
+
 /*******************************************************
  *
  * master function: wrapper for other optimized functions
@@ -210,6 +481,10 @@ void PhyloTree::changeLikelihoodKernel(LikelihoodKernel lk) {
  ******************************************************/
 
 void PhyloTree::computePartialLikelihood(TraversalInfo &info, size_t ptn_left, size_t ptn_right, int packet_id) {
+    if (info.float_id >= 0) {
+        mem_slots.unpackFloat(info.float_id, info.dad_branch, ptn_left, ptn_right, safe_numeric);
+        return;
+    }
 	(this->*computePartialLikelihoodPointer)(info, ptn_left, ptn_right, packet_id);
 }
 
@@ -267,7 +542,7 @@ void PhyloTree::computeTipPartialLikelihood() {
         #pragma omp parallel for schedule(static)
 #endif
         for (int nodeid = 0; nodeid < nseq; nodeid++) {
-            auto stateRow = getConvertedSequenceByNumber(nodeid);
+            auto stateRow = getTipStateRow(nodeid);
             double *partial_lh = tip_partial_lh + tip_block_size*nodeid;
             for (size_t ptn = 0; ptn < nptn; ptn+=vector_size, partial_lh += nstates*vector_size) {
                 double *inv_evec = &model->getInverseEigenvectors()[ptn*nstates*nstates];
@@ -0,0 +1,258 @@
+/*
+ * replicateweights.cpp
+ * Compact pattern counts of bootstrap replicates for the RELL kernel
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "replicateweights.h"
+
+ReplicateWeights::ReplicateWeights() {
+    nrep = 0;
+    nptn = 0;
+    row_size = 0;
+    weight_size = 1;
+    weights = NULL;
+}
+
+ReplicateWeights::~ReplicateWeights() {
+    clear();
+}
+
+void ReplicateWeights::init(size_t num_replicates, size_t num_patterns) {
+    clear();
+    nrep = num_replicates;
+    nptn = num_patterns;
+    // whole cache lines per row, so that any SIMD width reads zeros past the last pattern
+    row_size = ((nptn + 63) / 64) * 64;
+    weight_size = 1;
+    weights = aligned_alloc<unsigned char>(nrep * row_size);
+    memset(weights, 0, nrep * row_size);
+}
+
+void ReplicateWeights::clear() {
+    if (weights)
+        aligned_free(weights);
+    weights = NULL;
+    nrep = nptn = row_size = 0;
+    weight_size = 1;
+}
+
+void ReplicateWeights::widen(int new_size) {
+    unsigned char *new_weights = aligned_alloc<unsigned char>(nrep * row_size * new_size);
+    for (size_t rep = 0; rep < nrep; rep++) {
+        size_t offset = rep * row_size;
+        for (size_t ptn = 0; ptn < row_size; ptn++) {
+            int count = getCount(rep, ptn);
+            if (new_size == 2)
+                ((unsigned short*)new_weights)[offset + ptn] = count;
+            else
+                ((unsigned int*)new_weights)[offset + ptn] = count;
+        }
+    }
+    aligned_free(weights);
+    weights = new_weights;
+    weight_size = new_size;
+}
+
+void ReplicateWeights::setReplicate(size_t rep, const int *counts) {
+    ASSERT(rep < nrep);
+    int max_count = 0;
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        ASSERT(counts[ptn] >= 0);
+        max_count = max(max_count, counts[ptn]);
+    }
+    if (max_count > USHRT_MAX && weight_size < 4)
+        widen(4);
+    else if (max_count > UCHAR_MAX && weight_size < 2)
+        widen(2);
+    size_t offset = rep * row_size;
+    switch (weight_size) {
+    case 1:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            weights[offset + ptn] = counts[ptn];
+        break;
+    case 2:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            ((unsigned short*)weights)[offset + ptn] = counts[ptn];
+        break;
+    default:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            ((unsigned int*)weights)[offset + ptn] = counts[ptn];
+        break;
+    }
+}
+
+int ReplicateWeights::getCount(size_t rep, size_t ptn) const {
+    size_t offset = rep * row_size + ptn;
+    switch (weight_size) {
+    case 1: return weights[offset];
+    case 2: return ((unsigned short*)weights)[offset];
+    default: return ((unsigned int*)weights)[offset];
+    }
+}
+
+template <class Numeric, class Weight>
+void ReplicateWeights::computeRELLBlocked(PhyloTree *tree, Numeric (PhyloTree::*dot)(Numeric*, Numeric*, int),
+    Numeric *pattern_lhs, size_t lh_stride, size_t ntrees,
+    size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const
+{
+    ASSERT(rep_end <= nrep);
+    for (size_t tid = 0; tid < ntrees; tid++)
+        for (size_t rep = rep_start; rep < rep_end; rep++)
+            rell[tid*rell_stride + rep - rep_start] = 0.0;
+    // counts of the current tile converted to Numeric for the dot product
+    Numeric *tile = aligned_alloc<Numeric>(RELL_PATTERN_BLOCK);
+    for (size_t start = 0; start < nptn; start += RELL_PATTERN_BLOCK) {
+        size_t block = min((size_t)RELL_PATTERN_BLOCK, nptn - start);
+        // padding up to a multiple of 16 covers every vector size and stays within row_size
+        size_t padded_block = ((block + 15) / 16) * 16;
+        for (size_t tree_start = 0; tree_start < ntrees; tree_start += RELL_TREE_BLOCK) {
+            size_t tree_end = min(tree_start + RELL_TREE_BLOCK, ntrees);
+            for (size_t rep = rep_start; rep < rep_end; rep++) {
+                Weight *row = (Weight*)weights + rep * row_size + start;
+                for (size_t ptn = 0; ptn < padded_block; ptn++)
+                    tile[ptn] = row[ptn];
+                for (size_t tid = tree_start; tid < tree_end; tid++) {
+                    Numeric *lh = pattern_lhs + tid*lh_stride + start;
+                    double *tree_rell = rell + tid*rell_stride + rep - rep_start;
+                    if (dot) {
+                        *tree_rell += (tree->*dot)(lh, tile, block);
+                    } else {
+                        double sum = 0.0;
+                        for (size_t ptn = 0; ptn < block; ptn++)
+                            sum += lh[ptn] * tile[ptn];
+                        *tree_rell += sum;
+                    }
+                }
+            }
+        }
+    }
+    aligned_free(tile);
+}
+
+template <class Numeric>
+void ReplicateWeights::computeRELLWeight(PhyloTree *tree, Numeric (PhyloTree::*dot)(Numeric*, Numeric*, int),
+    Numeric *pattern_lhs, size_t lh_stride, size_t ntrees,
+    size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const
+{
+    switch (weight_size) {
+    case 1:
+        computeRELLBlocked<Numeric, unsigned char>(tree, dot, pattern_lhs, lh_stride, ntrees,
+            rep_start, rep_end, rell, rell_stride);
+        break;
+    case 2:
+        computeRELLBlocked<Numeric, unsigned short>(tree, dot, pattern_lhs, lh_stride, ntrees,
+            rep_start, rep_end, rell, rell_stride);
+        break;
+    default:
+        computeRELLBlocked<Numeric, unsigned int>(tree, dot, pattern_lhs, lh_stride, ntrees,
+            rep_start, rep_end, rell, rell_stride);
+        break;
+    }
+}
+
+void ReplicateWeights::computeRELL(PhyloTree *tree, double *pattern_lhs, size_t lh_stride, size_t ntrees,
+    size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const
+{
+    // the SIMD dot product is only set up for SSE2 and above
+    if (Params::getInstance().SSE >= LK_SSE2)
+        computeRELLWeight<double>(tree, tree->dotProductDouble, pattern_lhs, lh_stride, ntrees,
+            rep_start, rep_end, rell, rell_stride);
+    else
+        computeRELLWeight<double>(tree, NULL, pattern_lhs, lh_stride, ntrees,
+            rep_start, rep_end, rell, rell_stride);
+}
+
+#ifdef BOOT_VAL_FLOAT
+void ReplicateWeights::computeRELL(PhyloTree *tree, float *pattern_lh, size_t rep_start, size_t rep_end, double *rell) const {
+    if (Params::getInstance().SSE >= LK_SSE2)
+        computeRELLWeight<float>(tree, tree->dotProduct, pattern_lh, 0, 1, rep_start, rep_end, rell, 0);
+    else
+        computeRELLWeight<float>(tree, NULL, pattern_lh, 0, 1, rep_start, rep_end, rell, 0);
+}
+#endif
+
+/****************************************************************************
+        BootstrapResampler
+ ****************************************************************************/
+
+BootstrapResampler::BootstrapResampler(Alignment *aln, size_t num_replicates, int seed) {
+    this->aln = aln;
+    nrep = num_replicates;
+    this->seed = seed;
+    num_generated = 0;
+}
+
+BootstrapResampler::~BootstrapResampler() {
+    for (auto it = replicates.begin(); it != replicates.end(); it++)
+        delete it->second;
+    replicates.clear();
+}
+
+ReplicateWeights &BootstrapResampler::getReplicates(const char *spec) {
+    string key = spec ? spec : "";
+    auto it = replicates.find(key);
+    if (it != replicates.end())
+        return *it->second;
+
+    ReplicateWeights *weights = new ReplicateWeights;
+    replicates[key] = weights;
+    size_t nptn = aln->getNPattern();
+    weights->init(nrep, nptn);
+    bool scaled = spec && strncmp(spec, "SCALE=", 6) == 0 && convert_double(spec+6) != 1.0;
+    // each block of replicates has its own random stream, so the matrix does not depend on the number of threads
+    size_t nblocks = (nrep + RELL_REPLICATE_BLOCK - 1) / RELL_REPLICATE_BLOCK;
+    int first_seed = seed + num_generated * nblocks;
+    num_generated++;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+    int *boot_sample = aligned_alloc<int>(get_safe_upper_limit(nptn));
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (size_t block = 0; block < nblocks; block++) {
+        int *rstream;
+        init_random(first_seed + block, false, &rstream);
+        size_t end = min((block+1) * RELL_REPLICATE_BLOCK, nrep);
+        for (size_t boot = block * RELL_REPLICATE_BLOCK; boot < end; boot++) {
+            if (boot == 0 && !scaled)
+                aln->getPatternFreq(boot_sample);
+            else
+                aln->createBootstrapAlignment(boot_sample, spec, rstream);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            weights->setReplicate(boot, boot_sample);
+        }
+        finish_random(rstream);
+    }
+    aligned_free(boot_sample);
+    }
+    return *weights;
+}
+
+ReplicateWeights &BootstrapResampler::getScaledReplicates(double scale) {
+    if (scale == 1.0 && Params::getInstance().jackknife_prop == 0.0)
+        return getReplicates(NULL);
+    string spec = "SCALE=" + convertDoubleToString(scale);
+    return getReplicates(spec.c_str());
+}
+
+void BootstrapResampler::release(const char *spec) {
+    auto it = replicates.find(spec ? spec : "");
+    if (it == replicates.end())
+        return;
+    delete it->second;
+    replicates.erase(it);
+}
+
+void BootstrapResampler::releaseScaled(double scale) {
+    if (scale == 1.0 && Params::getInstance().jackknife_prop == 0.0)
+        return;
+    string spec = "SCALE=" + convertDoubleToString(scale);
+    release(spec.c_str());
+}
@@ -0,0 +1,220 @@
+/*
+ * replicateweights.h
+ * Compact pattern counts of bootstrap replicates for the RELL kernel
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef REPLICATEWEIGHTS_H
+#define REPLICATEWEIGHTS_H
+
+#include "phylotree.h"
+
+/** number of patterns per tile of the RELL kernel, a multiple of the widest SIMD vector */
+#define RELL_PATTERN_BLOCK 1024
+
+/** suggested number of replicates per call of the RELL kernel when splitting work among threads */
+#define RELL_REPLICATE_BLOCK 32
+
+/** number of trees whose pattern tiles are kept in cache together by the RELL kernel */
+#define RELL_TREE_BLOCK 8
+
+/**
+    pattern counts of bootstrap replicates as a #replicates x #patterns matrix.
+    Counts are stored with the smallest of 1, 2 or 4 bytes that fits all of them,
+    so that the matrix streams through memory several times faster than float weights.
+*/
+class ReplicateWeights {
+public:
+
+    ReplicateWeights();
+
+    ~ReplicateWeights();
+
+    /**
+        allocate a zero matrix, removing all previous replicates
+        @param num_replicates number of replicates
+        @param num_patterns number of patterns
+    */
+    void init(size_t num_replicates, size_t num_patterns);
+
+    /** free the matrix */
+    void clear();
+
+    /** @return number of replicates */
+    size_t size() const { return nrep; }
+
+    /** @return TRUE if there is no replicate */
+    bool empty() const { return nrep == 0; }
+
+    /** @return number of patterns */
+    size_t getNPattern() const { return nptn; }
+
+    /** @return number of bytes per count */
+    int getWeightSize() const { return weight_size; }
+
+    /**
+        store the pattern counts of a replicate, widening the matrix if a count does not fit.
+        Different replicates can be set from several threads only if calls are serialized.
+        @param rep replicate ID
+        @param counts pattern counts of size getNPattern()
+    */
+    void setReplicate(size_t rep, const int *counts);
+
+    /**
+        @param rep replicate ID
+        @param ptn pattern ID
+        @return count of a pattern in a replicate
+    */
+    int getCount(size_t rep, size_t ptn) const;
+
+    /**
+        RELL log-likelihoods of replicates [rep_start, rep_end) for one tree.
+        Patterns are processed in tiles of RELL_PATTERN_BLOCK, so that each tile of
+        pattern_lh stays in cache while the counts of all replicates stream past it.
+        @param tree tree providing the SIMD dot product
+        @param pattern_lh pattern log-likelihoods, padded with zeros to get_safe_upper_limit()
+        @param rep_start first replicate
+        @param rep_end replicate after the last one
+        @param[out] rell RELL log-likelihoods, rell[rep-rep_start] for replicate rep
+    */
+    void computeRELL(PhyloTree *tree, double *pattern_lh, size_t rep_start, size_t rep_end, double *rell) const {
+        computeRELL(tree, pattern_lh, 0, 1, rep_start, rep_end, rell, 0);
+    }
+
+    /**
+        RELL log-likelihoods of replicates [rep_start, rep_end) for several trees, i.e. the product
+        of a #trees x #patterns matrix with the transposed count matrix. Trees are processed in
+        blocks of RELL_TREE_BLOCK, so that each tile of counts is converted once per tree block
+        and the pattern tiles of the block stay in cache over all replicates.
+        @param tree tree providing the SIMD dot product
+        @param pattern_lhs pattern log-likelihoods of all trees, padded with zeros to get_safe_upper_limit()
+        @param lh_stride distance between the pattern log-likelihoods of consecutive trees
+        @param ntrees number of trees
+        @param rep_start first replicate
+        @param rep_end replicate after the last one
+        @param[out] rell RELL log-likelihoods, rell[tid*rell_stride + rep-rep_start] for tree tid and replicate rep
+        @param rell_stride distance between the RELL log-likelihoods of consecutive trees
+    */
+    void computeRELL(PhyloTree *tree, double *pattern_lhs, size_t lh_stride, size_t ntrees,
+        size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const;
+
+#ifdef BOOT_VAL_FLOAT
+    /**
+        RELL log-likelihoods from float pattern log-likelihoods, padded to get_safe_upper_limit_float()
+        @see computeRELL(PhyloTree*, double*, size_t, size_t, double*)
+    */
+    void computeRELL(PhyloTree *tree, float *pattern_lh, size_t rep_start, size_t rep_end, double *rell) const;
+#endif
+
+protected:
+
+    /**
+        convert the matrix to a wider count type
+        @param new_size number of bytes per count
+    */
+    void widen(int new_size);
+
+    /**
+        blocked RELL kernel for one count type
+        @param dot SIMD dot product, NULL for the naive loop
+    */
+    template <class Numeric, class Weight>
+    void computeRELLBlocked(PhyloTree *tree, Numeric (PhyloTree::*dot)(Numeric*, Numeric*, int),
+        Numeric *pattern_lhs, size_t lh_stride, size_t ntrees,
+        size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const;
+
+    /** dispatch computeRELLBlocked() on the count type */
+    template <class Numeric>
+    void computeRELLWeight(PhyloTree *tree, Numeric (PhyloTree::*dot)(Numeric*, Numeric*, int),
+        Numeric *pattern_lhs, size_t lh_stride, size_t ntrees,
+        size_t rep_start, size_t rep_end, double *rell, size_t rell_stride) const;
+
+    /** number of replicates */
+    size_t nrep;
+
+    /** number of patterns */
+    size_t nptn;
+
+    /** number of counts per row, padded with zeros for SIMD */
+    size_t row_size;
+
+    /** number of bytes per count: 1, 2 or 4 */
+    int weight_size;
+
+    /** the count matrix, row-major by replicate */
+    unsigned char *weights;
+
+};
+
+/**
+    resampling engine of the tree topology tests. The replicate matrix of each
+    bootstrap specification is generated once, in parallel, and then shared by
+    all tests using it: RELL, KH, SH and ELW use the standard bootstrap, which is
+    also the scale 1.0 of the multiscale bootstrap of the AU test.
+    Replicates are drawn from one random stream per block of replicates, so for
+    the same -seed the p-values differ from versions up to 2.2.2.3, which used
+    one stream per thread.
+*/
+class BootstrapResampler {
+public:
+
+    /**
+        @param aln alignment to resample
+        @param num_replicates number of replicates of each matrix
+        @param seed random number seed
+    */
+    BootstrapResampler(Alignment *aln, size_t num_replicates, int seed);
+
+    ~BootstrapResampler();
+
+    /** @return number of replicates of each matrix */
+    size_t getNReplicates() const { return nrep; }
+
+    /**
+        get the replicate matrix of a bootstrap specification, generating it on first use.
+        The first replicate is the original alignment, except for scales other than 1.0
+        @param spec bootstrap specification (see Alignment::createBootstrapAlignment()), NULL for the standard bootstrap
+        @return replicate matrix
+    */
+    ReplicateWeights &getReplicates(const char *spec);
+
+    /**
+        get the replicate matrix of a multiscale bootstrap for the AU test
+        @param scale ratio of replicate length to alignment length
+        @return replicate matrix
+    */
+    ReplicateWeights &getScaledReplicates(double scale);
+
+    /**
+        free the replicate matrix of a bootstrap specification if it is not needed anymore
+        @param spec bootstrap specification as given to getReplicates()
+    */
+    void release(const char *spec);
+
+    /**
+        free the replicate matrix of a multiscale bootstrap, except the standard bootstrap
+        @param scale ratio of replicate length to alignment length
+    */
+    void releaseScaled(double scale);
+
+protected:
+
+    /** alignment to resample */
+    Alignment *aln;
+
+    /** number of replicates of each matrix */
+    size_t nrep;
+
+    /** random number seed */
+    int seed;
+
+    /** number of matrices generated so far, each gets its own range of random streams */
+    int num_generated;
+
+    /** replicate matrices by bootstrap specification, empty string for the standard bootstrap */
+    map<string, ReplicateWeights*> replicates;
+
+};
+
+#endif // REPLICATEWEIGHTS_H
@@ -0,0 +1,77 @@
+/*
+ * ufboottrees.cpp
+ * Reference-counted storage of the best trees of UFBoot replicates
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "ufboottrees.h"
+#include "utils/tools.h"
+
+/** empty tree for replicates without a tree */
+static const string no_tree;
+
+void UFBootTrees::resize(size_t num) {
+    for (size_t sample = num; sample < tree_ids.size(); sample++)
+        setTreeID(sample, -1);
+    tree_ids.resize(num, -1);
+}
+
+void UFBootTrees::clear() {
+    trees.clear();
+    ref_counts.clear();
+    free_ids.clear();
+    tree_hash.clear();
+    tree_ids.clear();
+}
+
+const string &UFBootTrees::operator[](size_t sample) const {
+    int id = tree_ids[sample];
+    if (id < 0)
+        return no_tree;
+    return trees[id];
+}
+
+int UFBootTrees::intern(const string &tree) {
+    size_t hash = std::hash<string>()(tree);
+    auto range = tree_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++)
+        if (trees[it->second] == tree)
+            return it->second;
+    int id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+        trees[id] = tree;
+    } else {
+        id = trees.size();
+        trees.push_back(tree);
+        ref_counts.push_back(0);
+    }
+    tree_hash.insert(make_pair(hash, id));
+    return id;
+}
+
+void UFBootTrees::setTreeID(size_t sample, int id) {
+    int old_id = tree_ids[sample];
+    if (id >= 0)
+        ref_counts[id]++;
+    tree_ids[sample] = id;
+    if (old_id >= 0)
+        release(old_id);
+}
+
+void UFBootTrees::release(int id) {
+    ASSERT(ref_counts[id] > 0);
+    if (--ref_counts[id] > 0)
+        return;
+    size_t hash = std::hash<string>()(trees[id]);
+    auto range = tree_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++)
+        if (it->second == id) {
+            tree_hash.erase(it);
+            break;
+        }
+    string().swap(trees[id]);
+    free_ids.push_back(id);
+}
@@ -0,0 +1,113 @@
+/*
+ * ufboottrees.h
+ * Reference-counted storage of the best trees of UFBoot replicates
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef UFBOOTTREES_H
+#define UFBOOTTREES_H
+
+#include "utils/tools.h"
+
+/**
+    best trees of all UFBoot replicates. Most replicates share a few topologies,
+    so each distinct tree string is stored once with a reference count and
+    a replicate only keeps the ID of its tree.
+*/
+class UFBootTrees {
+public:
+
+    /** number of replicates */
+    size_t size() const { return tree_ids.size(); }
+
+    /** @return TRUE if there is no replicate */
+    bool empty() const { return tree_ids.empty(); }
+
+    /**
+        set the number of replicates, new replicates have no tree
+        @param num number of replicates
+    */
+    void resize(size_t num);
+
+    /** remove all replicates and trees */
+    void clear();
+
+    /**
+        @param sample replicate ID
+        @return tree string of a replicate, empty if the replicate has no tree yet
+    */
+    const string &operator[](size_t sample) const;
+
+    /** @return tree string of the first replicate */
+    const string &front() const { return (*this)[0]; }
+
+    /**
+        look up a tree string, adding it if not yet stored.
+        A new tree is only referenced once it is assigned to a replicate with setTreeID()
+        @param tree tree string
+        @return tree ID
+    */
+    int intern(const string &tree);
+
+    /**
+        assign a stored tree to a replicate, releasing its previous tree
+        @param sample replicate ID
+        @param id tree ID returned by intern(), -1 to remove the tree of the replicate
+    */
+    void setTreeID(size_t sample, int id);
+
+    /**
+        assign a tree string to a replicate
+        @param sample replicate ID
+        @param tree tree string
+    */
+    void set(size_t sample, const string &tree) { setTreeID(sample, intern(tree)); }
+
+    /**
+        @param sample replicate ID
+        @return tree ID of a replicate, -1 if it has no tree
+    */
+    int getTreeID(size_t sample) const { return tree_ids[sample]; }
+
+    /** @return upper bound of tree IDs */
+    int getMaxTreeID() const { return trees.size(); }
+
+    /**
+        @param id tree ID
+        @return tree string, empty if the ID is not in use
+    */
+    const string &getTree(int id) const { return trees[id]; }
+
+    /**
+        @param id tree ID
+        @return number of replicates having this tree
+    */
+    int getTreeCount(int id) const { return ref_counts[id]; }
+
+    /** @return number of distinct trees over all replicates */
+    int getNumTrees() const { return trees.size() - free_ids.size(); }
+
+protected:
+
+    /** release a reference to a tree, removing it when no replicate has it */
+    void release(int id);
+
+    /** distinct tree strings indexed by tree ID, empty for free IDs */
+    vector<string> trees;
+
+    /** number of replicates having each tree */
+    vector<int> ref_counts;
+
+    /** tree IDs available for reuse */
+    vector<int> free_ids;
+
+    /** map from hash of a tree string to tree IDs, trees are not copied as keys */
+    unordered_multimap<size_t, int> tree_hash;
+
+    /** tree ID of each replicate, -1 for no tree */
+    vector<int> tree_ids;
+
+};
+
+#endif // UFBOOTTREES_H
@@ -107,15 +107,44 @@ void MPIHelper::sendString(string &str, int dest, int tag) {
     MPI_Send(buf, str.length()+1, MPI_CHAR, dest, tag, MPI_COMM_WORLD);
 }
 
-void MPIHelper::sendCheckpoint(Checkpoint *ckp, int dest) {
+void MPIHelper::sendCheckpoint(Checkpoint *ckp, int dest, int tag, const string &payload) {
     stringstream ss;
     ckp->dump(ss);
     string str = ss.str();
-    sendString(str, dest, TREE_TAG);
+    if (!payload.empty()) {
+        // the text of Checkpoint never contains '\0', so the payload starts after the first one
+        str.push_back('\0');
+        str.append(payload);
+    }
+    sendString(str, dest, tag);
+}
+
+void MPIHelper::isendCheckpoint(Checkpoint *ckp, int dest, const string &payload) {
+    cleanUpMessages();
+    stringstream ss;
+    ckp->dump(ss);
+    string *str = new string(ss.str());
+    if (!payload.empty()) {
+        str->push_back('\0');
+        str->append(payload);
+    }
+    MPI_Request request;
+    MPI_Isend((char*)str->c_str(), str->length()+1, MPI_CHAR, dest, TREE_TAG, MPI_COMM_WORLD, &request);
+    sentRequests.push_back(request);
+    sentBuffers.push_back(str);
+    sentDests.push_back(dest);
+}
+
+bool MPIHelper::isSendPending(int dest) {
+    cleanUpMessages();
+    for (auto d : sentDests)
+        if (d == dest)
+            return true;
+    return false;
 }
 
 
-int MPIHelper::recvString(string &str, int src, int tag) {
+int MPIHelper::recvString(string &str, int src, int tag, string *payload) {
     MPI_Status status;
     MPI_Probe(src, tag, MPI_COMM_WORLD, &status);
     int msgCount;
@@ -124,18 +153,42 @@ int MPIHelper::recvString(string &str, int src, int tag) {
     char *recvBuffer = new char[msgCount];
     MPI_Recv(recvBuffer, msgCount, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, &status);
     str = recvBuffer;
+    if (payload) {
+        // sendString adds a '\0' after the payload
+        size_t start = str.length() + 1;
+        if ((size_t)msgCount > start + 1)
+            payload->assign(recvBuffer + start, msgCount - start - 1);
+        else
+            payload->clear();
+    }
     delete [] recvBuffer;
     return status.MPI_SOURCE;
 }
 
-int MPIHelper::recvCheckpoint(Checkpoint *ckp, int src) {
+int MPIHelper::recvCheckpoint(Checkpoint *ckp, int src, int tag, string *payload) {
     string str;
-    int proc = recvString(str, src, TREE_TAG);
+    int proc = recvString(str, src, tag, payload);
     stringstream ss(str);
     ckp->load(ss);
     return proc;
 }
 
+int MPIHelper::tryRecvCheckpoint(Checkpoint *ckp, int src, string *payload) {
+    int flag = 0;
+    MPI_Status status;
+    MPI_Iprobe(src, TREE_TAG, MPI_COMM_WORLD, &flag, &status);
+    if (!flag)
+        return -1;
+    // the message is there, so this does not block
+    return recvCheckpoint(ckp, status.MPI_SOURCE, TREE_TAG, payload);
+}
+
+void MPIHelper::waitAllMessages() {
+    if (!sentRequests.empty())
+        MPI_Waitall(sentRequests.size(), &sentRequests[0], MPI_STATUSES_IGNORE);
+    cleanUpMessages();
+}
+
 void MPIHelper::broadcastCheckpoint(Checkpoint *ckp) {
     int msgCount = 0;
     stringstream ss;
@@ -207,6 +260,58 @@ void MPIHelper::gatherCheckpoint(Checkpoint *ckp) {
 
 #endif
 
+int MPIHelper::cleanUpMessages() {
+#ifdef _IQTREE_MPI
+    size_t unfinished = 0;
+    for (size_t i = 0; i < sentRequests.size(); i++) {
+        int flag = 0;
+        // MPI_Test sets finished requests to MPI_REQUEST_NULL
+        if (sentRequests[i] != MPI_REQUEST_NULL)
+            MPI_Test(&sentRequests[i], &flag, MPI_STATUS_IGNORE);
+        if (sentRequests[i] == MPI_REQUEST_NULL) {
+            delete sentBuffers[i];
+        } else {
+            sentRequests[unfinished] = sentRequests[i];
+            sentBuffers[unfinished] = sentBuffers[i];
+            sentDests[unfinished] = sentDests[i];
+            unfinished++;
+        }
+    }
+    sentRequests.resize(unfinished);
+    sentBuffers.resize(unfinished);
+    sentDests.resize(unfinished);
+    return unfinished;
+#else
+    return 0;
+#endif
+}
+
+#ifdef _IQTREE_MPI
+void MPIHelper::startJobCounter() {
+    MPI_Aint size = isMaster() ? sizeof(int64_t) : 0;
+    MPI_Win_allocate(size, sizeof(int64_t), MPI_INFO_NULL, MPI_COMM_WORLD, &jobCounter, &jobWindow);
+    if (isMaster()) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, PROC_MASTER, 0, jobWindow);
+        *jobCounter = 0;
+        MPI_Win_unlock(PROC_MASTER, jobWindow);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int64_t MPIHelper::takeJobs(int64_t num) {
+    int64_t first;
+    MPI_Win_lock(MPI_LOCK_SHARED, PROC_MASTER, 0, jobWindow);
+    MPI_Fetch_and_op(&num, &first, MPI_INT64_T, PROC_MASTER, 0, MPI_SUM, jobWindow);
+    MPI_Win_unlock(PROC_MASTER, jobWindow);
+    return first;
+}
+
+void MPIHelper::stopJobCounter() {
+    MPI_Win_free(&jobWindow);
+    jobCounter = NULL;
+}
+#endif
+
 MPIHelper::~MPIHelper() {
 //    cleanUpMessages();
 }
@@ -37,6 +37,7 @@
 #define BOOT_TAG 3 // Message to please send bootstrap trees
 #define BOOT_TREE_TAG 4 // bootstrap tree tag
 #define LOGL_CUTOFF_TAG 5 // send logl_cutoff for ultrafast bootstrap
+#define CAND_TAG 6 // candidate trees gathered up the process tree
 
 using namespace std;
 
@@ -111,23 +112,53 @@ public:
         @param[out] str string received
         @param src source process
         @param tag message tag
+        @param[out] payload if not NULL, binary data sent after the string (see sendCheckpoint)
         @return the source process that sent the message
     */
-    int recvString(string &str, int src = MPI_ANY_SOURCE, int tag = MPI_ANY_TAG);
+    int recvString(string &str, int src = MPI_ANY_SOURCE, int tag = MPI_ANY_TAG, string *payload = NULL);
 
     /** wrapper for MPI_Send an entire Checkpoint object
         @param ckp Checkpoint object to send
         @param dest destination process
+        @param tag message tag
+        @param payload binary data sent after the Checkpoint in the same message, e.g. a tree
+               from PhyloTree::getTreeBinary that would not survive the text form of Checkpoint
+    */
+    void sendCheckpoint(Checkpoint *ckp, int dest, int tag = TREE_TAG, const string &payload = "");
+
+    /** wrapper for MPI_Isend an entire Checkpoint object, returns without waiting for the receiver.
+        The message buffer is kept until the send is finished, see cleanUpMessages()
+        @param ckp Checkpoint object to send
+        @param dest destination process
+        @param payload binary data sent after the Checkpoint, see sendCheckpoint
     */
-    void sendCheckpoint(Checkpoint *ckp, int dest);
+    void isendCheckpoint(Checkpoint *ckp, int dest, const string &payload = "");
 
     /** wrapper for MPI_Recv an entire Checkpoint object
         @param[out] ckp Checkpoint object received
         @param src source process
         @param tag message tag
+        @param[out] payload if not NULL, binary data sent after the Checkpoint
         @return the source process that sent the message
     */
-    int recvCheckpoint(Checkpoint *ckp, int src = MPI_ANY_SOURCE);
+    int recvCheckpoint(Checkpoint *ckp, int src = MPI_ANY_SOURCE, int tag = TREE_TAG, string *payload = NULL);
+
+    /** receive a Checkpoint object only if a message has already arrived
+        @param[out] ckp Checkpoint object received
+        @param src source process
+        @param[out] payload if not NULL, binary data sent after the Checkpoint
+        @return the source process that sent the message, -1 if there is no message
+    */
+    int tryRecvCheckpoint(Checkpoint *ckp, int src = MPI_ANY_SOURCE, string *payload = NULL);
+
+    /** wait until all messages sent by isendCheckpoint are finished */
+    void waitAllMessages();
+
+    /**
+        @param dest destination process
+        @return TRUE if a message sent to dest by isendCheckpoint is not yet finished (MPI_Test)
+    */
+    bool isSendPending(int dest);
 
     /**
         wrapper for MPI_Bcast to broadcast checkpoint from Master to all Workers
@@ -140,6 +171,22 @@ public:
         @param ckp Checkpoint object
     */
     void gatherCheckpoint(Checkpoint *ckp);
+
+    /**
+        create a job counter at the master that all processes take jobs from with MPI_Fetch_and_op,
+        so no process has to serve job requests, collective call
+    */
+    void startJobCounter();
+
+    /**
+        take the next jobs from the job counter, does not wait for the master
+        @param num number of jobs to take
+        @return ID of the first job taken, may be beyond the number of jobs
+    */
+    int64_t takeJobs(int64_t num);
+
+    /** free the job counter, collective call that returns when all processes are done with their jobs */
+    void stopJobCounter();
 #endif
 
     void increaseTreeSent(int inc = 1) {
@@ -150,12 +197,30 @@ public:
         numTreeReceived += inc;
     }
 
-private:
     /**
     *  Remove the buffers for finished messages
+    *  @return number of messages not yet finished
     */
     int cleanUpMessages();
 
+private:
+#ifdef _IQTREE_MPI
+    /** requests of unfinished messages sent by isendCheckpoint */
+    vector<MPI_Request> sentRequests;
+
+    /** buffers of unfinished messages, in the same order as sentRequests */
+    vector<string*> sentBuffers;
+
+    /** destinations of unfinished messages, in the same order as sentRequests */
+    vector<int> sentDests;
+
+    /** window exposing the job counter of the master */
+    MPI_Win jobWindow;
+
+    /** the job counter, only allocated at the master */
+    int64_t *jobCounter;
+#endif
+
 private:
     MPIHelper() { }; // Disable constructor
     MPIHelper(MPIHelper const &) { }; // Disable copy constructor
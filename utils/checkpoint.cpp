@@ -10,10 +10,75 @@
 #include "timeutil.h"
 #include "gzstream.h"
 #include <cstdio>
+#include <cstring>
+
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__ && !defined WIN64
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define CKP_MMAP
+#endif
 
 const char* CKP_HEADER =     "--- # IQ-TREE Checkpoint ver >= 1.6";
 const char* CKP_HEADER_OLD = "--- # IQ-TREE Checkpoint";
 
+/*
+    Journal file (filename.journal): first line is CKP_JOURNAL_TAG with the generation
+    of the checkpoint file it belongs to, followed by batches of changed keys in the
+    format of dump(ostream), each terminated by CKP_JOURNAL_COMMIT. The checkpoint file
+    records its generation in a CKP_JOURNAL_TAG comment after the header.
+    CKP_JOURNAL_SNAPSHOT marks where a background compaction copied the map.
+*/
+const char* CKP_JOURNAL_TAG =      "# journal ";
+const char* CKP_JOURNAL_COMMIT =   "# commit";
+const char* CKP_JOURNAL_SNAPSHOT = "# snapshot ";
+
+/*
+    Binary checkpoint file (--ckp-binary): CKP_BINARY_MAGIC, header line (uint32 length + bytes),
+    int32 journal generation, uint64 number of entries, the index of all entries in key order
+    (uint32 key length, uint64 value length, key bytes), then all values in the same order.
+    Values are stored verbatim without line formatting, so loading needs no parsing.
+*/
+const char CKP_BINARY_MAGIC[8] = {'I', 'Q', 'C', 'K', 'P', 'B', 'I', 'N'};
+
+/** compact the journal only once it is larger than this or than the checkpoint file */
+const int64_t CKP_JOURNAL_MIN_BYTES = 1 << 20;
+
+/**
+    @return generation in a CKP_JOURNAL_TAG line, -1 if line is not a tag
+*/
+static int getJournalGeneration(const string &line) {
+    size_t len = strlen(CKP_JOURNAL_TAG);
+    if (line.compare(0, len, CKP_JOURNAL_TAG) != 0 || line.length() == len)
+        return -1;
+    return atoi(line.c_str() + len);
+}
+
+/**
+    write one entry in the format of Checkpoint::dump(ostream)
+    @param[in,out] struct_name struct of the previous entry
+*/
+static void dumpEntry(ostream &out, const string &key, const string &value, string &struct_name) {
+    size_t pos;
+    if ((pos = key.find(CKP_SEP)) != string::npos) {
+        if (struct_name.compare(0, string::npos, key, 0, pos) != 0) {
+            struct_name = key.substr(0, pos);
+            out << struct_name << ':' << endl;
+        }
+        out << ' ' << key.substr(pos+1) << ": " << value << endl;
+    } else
+        out << key << ": " << value << endl;
+}
+
+/** @return approximate size of a map dumped as text */
+static int64_t estimateDumpSize(const map<string, string> &ckp) {
+    int64_t bytes = 0;
+    for (auto it = ckp.begin(); it != ckp.end(); it++)
+        bytes += it->first.length() + it->second.length() + 3;
+    return bytes;
+}
+
 Checkpoint::Checkpoint() {
 	filename = "";
     prev_dump_time = 0;
@@ -22,15 +87,64 @@ Checkpoint::Checkpoint() {
     struct_name = "";
     compression = true;
     header = CKP_HEADER;
+    journal_generation = 0;
+    journal_size = 0;
+    journal_bytes = 0;
+    snapshot_bytes = 0;
+    need_compact = true;
+    compact_thread = NULL;
+    compact_map = NULL;
+    compact_generation = 0;
+    compact_done = false;
+    compact_ok = true;
+}
+
+
+Checkpoint::Checkpoint(const Checkpoint &ckp) : Checkpoint() {
+    *this = ckp;
+}
+
+Checkpoint &Checkpoint::operator=(const Checkpoint &ckp) {
+    if (this == &ckp)
+        return *this;
+    // the compaction thread writes a copy of the old map with the old file settings
+    finishCompaction(true);
+    map<string, string>::operator=(ckp);
+    // a copy is a scratch checkpoint: it must never write to the file or journal of the original
+    filename = "";
+    compression = ckp.compression;
+    header = ckp.header;
+    dump_interval = ckp.dump_interval;
+    struct_name = ckp.struct_name;
+    list_element = ckp.list_element;
+    list_element_precision = ckp.list_element_precision;
+    // the journal of this checkpoint does not describe the new map
+    journal_keys.clear();
+    compact_keys.clear();
+    journal_size = size();
+    need_compact = true;
+    return *this;
 }
 
-
 Checkpoint::~Checkpoint() {
+    finishCompaction(true);
+}
+
+void Checkpoint::foldJournal() {
+    finishCompaction(true);
+    if (isJournaled() && journal_bytes > 0 && !need_compact) {
+        compact();
+        std::remove(getJournalName().c_str());
+    }
 }
 
 
 void Checkpoint::setFileName(string filename) {
+    finishCompaction(true);
 	this->filename = filename;
+    journal_keys.clear();
+    journal_bytes = 0;
+    need_compact = true;
 }
 
 
@@ -41,6 +155,10 @@ void Checkpoint::load(istream &in) {
     int listid = 0;
     while (!in.eof()) {
         safeGetline(in, line);
+        if (line.compare(0, strlen(CKP_JOURNAL_TAG), CKP_JOURNAL_TAG) == 0) {
+            journal_generation = getJournalGeneration(line);
+            continue;
+        }
         pos = line.find('#');
         if (pos != string::npos)
             line.erase(pos);
@@ -56,7 +174,7 @@ void Checkpoint::load(istream &in) {
         pos = line.find(": ");
         if (pos != string::npos) {
             // mapping
-            (*this)[struct_name + line.substr(0, pos)] = line.substr(pos+2);
+            setValue(struct_name + line.substr(0, pos), line.substr(pos+2));
         } else if (line[line.length()-1] == ':') {
             // start a new struct
             line.erase(line.length()-1);
@@ -66,7 +184,7 @@ void Checkpoint::load(istream &in) {
             continue;
         } else {
             // collection
-            (*this)[struct_name + convertIntToString(listid)] = line;
+            setValue(struct_name + convertIntToString(listid), line);
             listid++;
         }
     }
@@ -76,6 +194,101 @@ void Checkpoint::load(istream &in) {
 bool Checkpoint::load() {
 	ASSERT(filename != "");
     if (!fileExists(filename)) return false;
+    journal_generation = 0;
+    if (isBinaryFile(filename))
+        loadBinary();
+    else if (!loadText())
+        return false;
+    need_compact = false;
+    replayJournal();
+    journal_keys.clear();
+    journal_size = size();
+    snapshot_bytes = estimateDumpSize(*this);
+    return true;
+}
+
+bool Checkpoint::isBinaryFile(string filename) {
+    char magic[sizeof(CKP_BINARY_MAGIC)] = {0};
+    ifstream in(filename.c_str(), ios::in | ios::binary);
+    in.read(magic, sizeof(magic));
+    return in && memcmp(magic, CKP_BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+/** read a fixed-size integer from the binary checkpoint format, advancing pos */
+template <class T>
+static T readBinary(const char *data, size_t size, size_t &pos, const string &filename) {
+    T value;
+    if (pos + sizeof(T) > size)
+        outError("Truncated checkpoint file " + filename);
+    memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+void Checkpoint::loadBinary() {
+    size_t size;
+    const char *data;
+#ifdef CKP_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        outError(ERR_READ_INPUT, filename);
+    size = st.st_size;
+    void *mem = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mem == MAP_FAILED)
+        outError(ERR_READ_INPUT, filename);
+    // values are copied front to back exactly once
+    madvise(mem, size, MADV_SEQUENTIAL);
+    data = (const char*)mem;
+#else
+    string content;
+    try {
+        ifstream in;
+        in.exceptions(ios::failbit | ios::badbit);
+        in.open(filename.c_str(), ios::in | ios::binary);
+        in.seekg(0, ios::end);
+        content.resize(in.tellg());
+        in.seekg(0, ios::beg);
+        in.read(&content[0], content.size());
+        in.close();
+    } catch (ios::failure &) {
+        outError(ERR_READ_INPUT, filename);
+    }
+    size = content.size();
+    data = content.data();
+#endif
+    size_t pos = sizeof(CKP_BINARY_MAGIC);
+    uint32_t header_len = readBinary<uint32_t>(data, size, pos, filename);
+    if (pos + header_len > size || header.compare(0, string::npos, data + pos, header_len) != 0)
+        outError("Invalid checkpoint file " + filename);
+    pos += header_len;
+    journal_generation = readBinary<int32_t>(data, size, pos, filename);
+    uint64_t num = readBinary<uint64_t>(data, size, pos, filename);
+    // values follow the index in the same order
+    size_t index_pos = pos;
+    size_t value_pos = pos;
+    for (uint64_t i = 0; i < num; i++) {
+        uint32_t key_len = readBinary<uint32_t>(data, size, value_pos, filename);
+        value_pos += sizeof(uint64_t) + key_len;
+    }
+    for (uint64_t i = 0; i < num; i++) {
+        uint32_t key_len = readBinary<uint32_t>(data, size, index_pos, filename);
+        uint64_t value_len = readBinary<uint64_t>(data, size, index_pos, filename);
+        if (index_pos + key_len > size || value_pos + value_len > size)
+            outError("Truncated checkpoint file " + filename);
+        // keys are sorted, so inserting before end() takes constant time
+        iterator it = insert(end(), value_type(string(data + index_pos, key_len), string()));
+        it->second.assign(data + value_pos, value_len);
+        index_pos += key_len;
+        value_pos += value_len;
+    }
+#ifdef CKP_MMAP
+    munmap(mem, size);
+#endif
+}
+
+bool Checkpoint::loadText() {
     try {
         igzstream in;
         // set the failbit and badbit
@@ -127,65 +340,295 @@ void Checkpoint::setDumpInterval(double interval) {
 
 void Checkpoint::dump(ostream &out) {
     string struct_name;
-    size_t pos;
-    int listid = 0;
-    for (iterator i = begin(); i != end(); i++) {
-        if ((pos = i->first.find(CKP_SEP)) != string::npos) {
-            if (struct_name != i->first.substr(0, pos)) {
-                struct_name = i->first.substr(0, pos);
-                out << struct_name << ':' << endl;
-                listid = 0;
+    for (iterator i = begin(); i != end(); i++)
+        dumpEntry(out, i->first, i->second, struct_name);
+}
+
+bool Checkpoint::writeFile(const map<string, string> &ckp, string filename, string header, int gen, bool compression,
+                           bool binary) {
+    string filename_tmp = filename + ".tmp";
+    try {
+        if (binary) {
+            ofstream out;
+            out.exceptions(ios::failbit | ios::badbit);
+            out.open(filename_tmp.c_str(), ios::out | ios::binary);
+            out.write(CKP_BINARY_MAGIC, sizeof(CKP_BINARY_MAGIC));
+            uint32_t header_len = header.length();
+            int32_t generation = gen;
+            uint64_t num = ckp.size();
+            out.write((char*)&header_len, sizeof(header_len));
+            out.write(header.c_str(), header_len);
+            out.write((char*)&generation, sizeof(generation));
+            out.write((char*)&num, sizeof(num));
+            for (auto i = ckp.begin(); i != ckp.end(); i++) {
+                uint32_t key_len = i->first.length();
+                uint64_t value_len = i->second.length();
+                out.write((char*)&key_len, sizeof(key_len));
+                out.write((char*)&value_len, sizeof(value_len));
+                out.write(i->first.c_str(), key_len);
             }
-            // check if key is a collection
-            out << ' ' << i->first.substr(pos+1) << ": " << i->second << endl;
-        } else
-            out << i->first << ": " << i->second << endl;
+            for (auto i = ckp.begin(); i != ckp.end(); i++)
+                out.write(i->second.c_str(), i->second.length());
+            out.close();
+        } else {
+            ostream *out;
+            if (compression) 
+                out = new ogzstream(filename_tmp.c_str());
+            else
+                out = new ofstream(filename_tmp.c_str());
+            out->exceptions(ios::failbit | ios::badbit);
+            *out << header << endl;
+            if (gen > 0)
+                *out << CKP_JOURNAL_TAG << gen << endl;
+            string struct_name;
+            for (auto i = ckp.begin(); i != ckp.end(); i++)
+                dumpEntry(*out, i->first, i->second, struct_name);
+            if (compression)
+                ((ogzstream*)out)->close();
+            else
+                ((ofstream*)out)->close();
+            delete out;
+        }
+    } catch (ios::failure &) {
+        return false;
+    }
+    if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0) {
+        // rename does not replace an existing file on all platforms
+        if (std::remove(filename.c_str()) != 0)
+            return false;
+        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+            return false;
     }
+    return true;
 }
 
-void Checkpoint::dump(bool force) {
-    if (filename == "")
+bool Checkpoint::isJournaled() {
+    return !filename.empty() && header == CKP_HEADER && Params::getInstance().checkpoint_journal;
+}
+
+bool Checkpoint::isBinary() {
+    return header == CKP_HEADER && Params::getInstance().checkpoint_binary;
+}
+
+void Checkpoint::replayJournal() {
+    string journal_name = getJournalName();
+    journal_bytes = 0;
+    if (!fileExists(journal_name))
         return;
-        
-    if (!force && getRealTime() < prev_dump_time + dump_interval) {
+    ifstream in(journal_name.c_str());
+    string line, batch;
+    int gen = -1;
+    if (safeGetline(in, line))
+        gen = getJournalGeneration(line);
+    if (gen != journal_generation && gen != journal_generation-1) {
+        outWarning("Ignore checkpoint journal " + journal_name + " not matching " + filename);
+        need_compact = true;
         return;
     }
-    prev_dump_time = getRealTime();
+    // journal of the previous generation if killed before it was rotated after a compaction:
+    // only the batches after the snapshot marker are newer than the checkpoint file
+    bool replay = (gen == journal_generation);
+    string marker = CKP_JOURNAL_SNAPSHOT + convertIntToString(journal_generation);
+    while (safeGetline(in, line)) {
+        if (line.empty()) continue;
+        if (line == CKP_JOURNAL_COMMIT) {
+            if (replay) {
+                istringstream ss(batch);
+                load(ss);
+                journal_bytes += batch.length();
+            }
+            batch.clear();
+        } else if (line == marker) {
+            replay = true;
+            batch.clear();
+        } else {
+            batch += line;
+            batch += '\n';
+        }
+    }
+    in.close();
+    if (!batch.empty()) {
+        // killed while appending, new batches must not be appended to the incomplete one
+        outWarning("Ignore incomplete last entry of checkpoint journal " + journal_name);
+        need_compact = true;
+    }
+    if (gen != journal_generation)
+        need_compact = true;
+}
+
+void Checkpoint::appendJournal() {
+    if (journal_keys.empty())
+        return;
+    string journal_name = getJournalName();
+    ostringstream batch;
+    string struct_name;
+    for (auto it = journal_keys.begin(); it != journal_keys.end(); it++) {
+        iterator i = find(*it);
+        if (i != end())
+            dumpEntry(batch, i->first, i->second, struct_name);
+    }
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        if (fileExists(journal_name))
+            out.open(journal_name.c_str(), ios::app);
+        else {
+            out.open(journal_name.c_str());
+            out << CKP_JOURNAL_TAG << journal_generation << endl;
+        }
+        out << batch.str() << CKP_JOURNAL_COMMIT << endl;
+        out.close();
+    } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, journal_name.c_str());
+    }
+    journal_bytes += batch.tellp();
+    if (compact_thread)
+        compact_keys.insert(journal_keys.begin(), journal_keys.end());
+    journal_keys.clear();
+}
+
+void Checkpoint::writeJournal(int gen, set<string> &keys) {
+    string journal_name = getJournalName();
+    string journal_tmp = journal_name + ".tmp";
+    ostringstream batch;
+    string struct_name;
+    for (auto it = keys.begin(); it != keys.end(); it++) {
+        iterator i = find(*it);
+        if (i != end())
+            dumpEntry(batch, i->first, i->second, struct_name);
+    }
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(journal_tmp.c_str());
+        out << CKP_JOURNAL_TAG << gen << endl;
+        if (!keys.empty())
+            out << batch.str() << CKP_JOURNAL_COMMIT << endl;
+        out.close();
+    } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, journal_tmp.c_str());
+    }
+    if (std::rename(journal_tmp.c_str(), journal_name.c_str()) != 0) {
+        if (std::remove(journal_name.c_str()) != 0 || std::rename(journal_tmp.c_str(), journal_name.c_str()) != 0)
+            outError("Cannot rename file ", journal_tmp);
+    }
+    journal_bytes = batch.tellp();
+}
+
+void Checkpoint::compact() {
+    finishCompaction(true);
+    // the new generation must differ from a journal left by a previous run
+    int gen = journal_generation;
+    string journal_name = getJournalName();
+    if (fileExists(journal_name)) {
+        ifstream in(journal_name.c_str());
+        string line;
+        if (safeGetline(in, line))
+            gen = max(gen, getJournalGeneration(line));
+        in.close();
+    }
+    gen++;
     string filename_tmp = filename + ".tmp";
     if (fileExists(filename_tmp)) {
         outWarning("IQ-TREE was killed while writing temporary checkpoint file " + filename_tmp);
         outWarning("You should increase checkpoint interval from the default 60 seconds");
         outWarning("via -cptime option to avoid too frequent checkpoint for large datasets");
     }
+    if (!writeFile(*this, filename, header, gen, compression, isBinary()))
+        outError(ERR_WRITE_OUTPUT, filename.c_str());
+    // if killed before the new journal is in place, the old one is ignored as it has no snapshot marker for gen
+    journal_generation = gen;
+    set<string> no_keys;
+    writeJournal(gen, no_keys);
+    journal_keys.clear();
+    journal_size = size();
+    snapshot_bytes = estimateDumpSize(*this);
+    need_compact = false;
+}
+
+void Checkpoint::runCompaction(Checkpoint *ckp) {
+    ckp->compact_ok = writeFile(*ckp->compact_map, ckp->filename, ckp->header, ckp->compact_generation,
+                               ckp->compression, ckp->isBinary());
+    ckp->compact_done = true;
+}
+
+void Checkpoint::startCompaction() {
+    ASSERT(!compact_thread);
+    // old checkpoint file and journal must stay complete until the new file replaces the old one
+    appendJournal();
+    compact_generation = journal_generation + 1;
+    string journal_name = getJournalName();
     try {
-        ostream *out;
-        if (compression) 
-            out = new ogzstream(filename_tmp.c_str());
-        else
-            out = new ofstream(filename_tmp.c_str());
-        out->exceptions(ios::failbit | ios::badbit);
-        *out << header << endl;
-        // call dump stream
-        dump(*out);
-        if (compression)
-            ((ogzstream*)out)->close();
-        else
-            ((ofstream*)out)->close();
-        delete out;
-//        cout << "Checkpoint dumped" << endl;
-        if (fileExists(filename)) {
-            if (std::remove(filename.c_str()) != 0)
-                outError("Cannot remove file ", filename);
-        }
-        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
-            outError("Cannot rename file ", filename_tmp);
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(journal_name.c_str(), ios::app);
+        out << CKP_JOURNAL_SNAPSHOT << compact_generation << endl;
+        out.close();
     } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, journal_name.c_str());
+    }
+    compact_map = new map<string, string>(*this);
+    snapshot_bytes = estimateDumpSize(*compact_map);
+    compact_keys.clear();
+    compact_done = false;
+    compact_ok = true;
+    compact_thread = new std::thread(runCompaction, this);
+}
+
+void Checkpoint::finishCompaction(bool wait) {
+    if (!compact_thread)
+        return;
+    if (!wait && !compact_done)
+        return;
+    compact_thread->join();
+    delete compact_thread;
+    compact_thread = NULL;
+    delete compact_map;
+    compact_map = NULL;
+    if (!compact_ok)
         outError(ERR_WRITE_OUTPUT, filename.c_str());
+    // changes after the map was copied are only in the old journal
+    journal_generation = compact_generation;
+    writeJournal(journal_generation, compact_keys);
+    compact_keys.clear();
+}
+
+void Checkpoint::dump(bool force) {
+    if (filename == "")
+        return;
+        
+    if (!force && getRealTime() < prev_dump_time + dump_interval) {
+        return;
+    }
+    prev_dump_time = getRealTime();
+    if (isJournaled()) {
+        finishCompaction(false);
+        if (need_compact || size() != journal_size) {
+            // first dump or keys were erased, which the journal cannot record;
+            // erasing sets need_compact, the size check also catches erasing via the map interface
+            compact();
+        } else {
+            appendJournal();
+            if (!compact_thread && journal_bytes > max(snapshot_bytes, CKP_JOURNAL_MIN_BYTES))
+                startCompaction();
+        }
+    } else {
+        string filename_tmp = filename + ".tmp";
+        if (fileExists(filename_tmp)) {
+            outWarning("IQ-TREE was killed while writing temporary checkpoint file " + filename_tmp);
+            outWarning("You should increase checkpoint interval from the default 60 seconds");
+            outWarning("via -cptime option to avoid too frequent checkpoint for large datasets");
+        }
+        if (!writeFile(*this, filename, header, 0, compression, isBinary()))
+            outError(ERR_WRITE_OUTPUT, filename.c_str());
+        // the journal was replayed by load() and is now contained in the file
+        if (fileExists(getJournalName()))
+            std::remove(getJournalName().c_str());
     }
     if (Params::getInstance().print_all_checkpoints) {
         // Feature request by Nick Goldman
         dump_count++;
-        filename_tmp = (string)Params::getInstance().out_prefix + "." + convertIntToString(dump_count) + ".ckp.gz";
+        string filename_tmp = (string)Params::getInstance().out_prefix + "." + convertIntToString(dump_count) + ".ckp.gz";
         try {
             ostream *out;
             if (compression)
@@ -243,14 +686,27 @@ int Checkpoint::eraseKeyPrefix(string key_prefix) {
             break;
 
     }
-    if (count)
+    if (count) {
         erase(first_it, i);
+        // erased keys cannot be recorded in the journal
+        need_compact = true;
+    }
     return count;
 }
 
+bool Checkpoint::eraseKey(string key) {
+    if (erase(struct_name + key) == 0)
+        return false;
+    // erased keys cannot be recorded in the journal
+    need_compact = true;
+    return true;
+}
+
 int Checkpoint::keepKeyPrefix(string key_prefix) {
     map<string,string> newckp;
     int count = 0;
+    // erased keys cannot be recorded in the journal
+    need_compact = true;
     erase(begin(), lower_bound(key_prefix));
     
     for (iterator i = begin(); i != end(); i++) {
@@ -265,6 +721,12 @@ int Checkpoint::keepKeyPrefix(string key_prefix) {
     return count;
 }
 
+void Checkpoint::clear() {
+    map<string, string>::clear();
+    // erased keys cannot be recorded in the journal
+    need_compact = true;
+}
+
 /*-------------------------------------------------------------
  * series of get function to get value of a key
  *-------------------------------------------------------------*/
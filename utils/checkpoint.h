@@ -14,7 +14,10 @@
 #include <sstream>
 #include <cassert>
 #include <vector>
+#include <set>
 #include <typeinfo>
+#include <thread>
+#include <atomic>
 #include "tools.h"
 
 using namespace std;
@@ -68,9 +71,30 @@ public:
     /** constructor */
 	Checkpoint();
 
+    /**
+        copy constructor, copies the map and the dump settings, see operator=
+        @param ckp checkpoint to copy
+    */
+    Checkpoint(const Checkpoint &ckp);
+
+    /**
+        copy the map, the dump settings and the current nested key, but not the file name, the
+        journal or the state of the background compaction. The copy is not attached to any file
+        until setFileName() is called. A compaction running on this checkpoint is finished first
+        @param ckp checkpoint to copy
+        @return this checkpoint
+    */
+    Checkpoint &operator=(const Checkpoint &ckp);
+
     /** destructor */
 	virtual ~Checkpoint();
 
+    /**
+        fold the journal into the checkpoint file and remove it, so that a finished run
+        leaves a single file. Only called on the checkpoint of the run when it ends normally
+    */
+    void foldJournal();
+
 	/**
 	 * @param filename file name
 	 */
@@ -109,7 +133,9 @@ public:
 	void dump(ostream &out);
 
 	/**
-	 * dump checkpoint information into file
+	 * dump checkpoint information into file. If journaling is enabled, only the keys
+	 * changed since the previous dump are appended to filename.journal and the
+	 * file itself is rewritten (compacted) in the background once the journal grows large
 	 * @param force TRUE to dump no matter if time interval exceeded or not
 	 */
 	void dump(bool force = false);
@@ -133,19 +159,29 @@ public:
 	bool hasKeyPrefix(string key_prefix);
 
     /**
-        erase all entries with a key prefix
+        erase all entries with a key prefix, the next dump() then rewrites the whole file
         @param key_prefix key prefix
         @return number of entries removed
     */
     int eraseKeyPrefix(string key_prefix);
 
     /**
-     erase all entries without a key prefix
+     erase all entries without a key prefix, the next dump() then rewrites the whole file
      @param key_prefix key prefix
      @return number of entries kept
      */
     int keepKeyPrefix(string key_prefix);
 
+    /**
+        erase one entry, the next dump() then rewrites the whole file
+        @param key key name
+        @return TRUE if the key existed
+    */
+    bool eraseKey(string key);
+
+    /** erase all entries, the next dump() then rewrites the whole file */
+    void clear();
+
     /*-------------------------------------------------------------
      * series of get function to get value of a key
      *-------------------------------------------------------------*/
@@ -323,7 +359,7 @@ public:
         CkpStream ss;
         ss.precision(10);
         ss << value;
-        (*this)[key] = ss.str();
+        setValue(key, ss.str());
     }
     
     /** 
@@ -350,7 +386,7 @@ public:
             if (i > 0) ss << ", ";
             ss << value[i];
         }
-        (*this)[key] = ss.str();
+        setValue(key, ss.str());
     }
 
     /**
@@ -371,7 +407,7 @@ public:
             if (i > 0) ss << ", ";
             ss << value[i];
         }
-        (*this)[key] = ss.str();
+        setValue(key, ss.str());
     }
     
     /*-------------------------------------------------------------
@@ -439,6 +475,87 @@ public:
 
 protected:
 
+    /**
+        set the value of a full key, recording the key for the journal
+        @param key full key name including struct prefix
+        @param value value string
+    */
+    void setValue(const string &key, const string &value) {
+        iterator it = lower_bound(key);
+        if (it == end() || it->first != key) {
+            insert(it, value_type(key, value));
+            journal_size++;
+        } else
+            it->second = value;
+        if (!filename.empty())
+            journal_keys.insert(key);
+    }
+
+    /** @return TRUE if dump() appends to a journal instead of rewriting the file */
+    bool isJournaled();
+
+    /** @return name of the journal file */
+    string getJournalName() { return filename + ".journal"; }
+
+    /**
+        replay committed batches of the journal after loading the file,
+        an incomplete batch at the end (killed while appending) is ignored
+    */
+    void replayJournal();
+
+    /** append the keys changed since the previous dump to the journal */
+    void appendJournal();
+
+    /**
+        write the journal of a new generation
+        @param gen journal generation, must be the generation of the checkpoint file
+        @param keys keys whose current values start the journal
+    */
+    void writeJournal(int gen, set<string> &keys);
+
+    /** rewrite the checkpoint file from the current map and start an empty journal */
+    void compact();
+
+    /** start rewriting the checkpoint file from a copy of the map in a background thread */
+    void startCompaction();
+
+    /**
+        switch to the journal of the new generation once background compaction is done
+        @param wait TRUE to wait for the compaction thread, FALSE to return if it is still running
+    */
+    void finishCompaction(bool wait);
+
+    /**
+        write a checkpoint file via filename.tmp
+        @param ckp key/value map to write
+        @param filename file name
+        @param header header line
+        @param gen journal generation recorded in the file, 0 to omit
+        @param compression TRUE to gzip the file
+        @param binary TRUE to write the binary indexed format instead of text, compression is then ignored
+        @return TRUE if successful, FALSE if an I/O error occurred
+    */
+    static bool writeFile(const map<string, string> &ckp, string filename, string header, int gen, bool compression,
+                          bool binary);
+
+    /** @return TRUE if the checkpoint file is written in the binary indexed format */
+    bool isBinary();
+
+    /** @return TRUE if filename is a binary checkpoint file */
+    static bool isBinaryFile(string filename);
+
+    /** load the binary indexed checkpoint file, which is memory-mapped if supported */
+    void loadBinary();
+
+    /**
+        load the text checkpoint file, optionally gzip-compressed
+        @return TRUE if loaded successfully, FALSE if the file is empty
+    */
+    bool loadText();
+
+    /** body of compact_thread, writes ckp->compact_map into the checkpoint file */
+    static void runCompaction(Checkpoint *ckp);
+
     /** filename to write checkpoint */
 	string filename;
     
@@ -456,7 +573,43 @@ protected:
     
     /** header line of checkpoint file */
     string header;
-    
+
+    /** generation of the checkpoint file, a journal is only replayed onto the file of the same generation */
+    int journal_generation;
+
+    /** keys changed since the previous dump */
+    set<string> journal_keys;
+
+    /** keys appended to the old journal while the background compaction is running */
+    set<string> compact_keys;
+
+    /** expected map size if no key was erased since the last compaction */
+    size_t journal_size;
+
+    /** size of the journal file in bytes */
+    int64_t journal_bytes;
+
+    /** estimated size of the uncompressed checkpoint file in bytes */
+    int64_t snapshot_bytes;
+
+    /** TRUE if the next dump must rewrite the whole file */
+    bool need_compact;
+
+    /** background compaction thread, NULL if not running */
+    std::thread *compact_thread;
+
+    /** copy of the map being written by compact_thread */
+    map<string, string> *compact_map;
+
+    /** generation of the file being written by compact_thread */
+    int compact_generation;
+
+    /** set by compact_thread when it is finished */
+    std::atomic<bool> compact_done;
+
+    /** set by compact_thread, FALSE if writing failed */
+    bool compact_ok;
+
 private:
 
     /** name of the current nested key */
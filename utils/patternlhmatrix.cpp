@@ -0,0 +1,102 @@
+/*
+ * patternlhmatrix.cpp
+ * Streamed storage of pattern log-likelihoods for tree topology tests
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "patternlhmatrix.h"
+
+/** magic bytes at the beginning of a pattern log-likelihood matrix */
+static const char PTNLH_MAGIC[] = "IQPTNLH1";
+static const size_t PTNLH_MAGIC_SIZE = 8;
+
+PatternLhMatrix::PatternLhMatrix() {
+    nptn = 0;
+    ntrees = 0;
+    out = NULL;
+    in = NULL;
+}
+
+PatternLhMatrix::~PatternLhMatrix() {
+    close();
+}
+
+void PatternLhMatrix::create(string file_name, size_t num_patterns) {
+    close();
+    filename = file_name;
+    nptn = num_patterns;
+    ntrees = 0;
+    out = new ogzstream(filename.c_str());
+    if (out->fail())
+        outError(ERR_WRITE_OUTPUT, filename);
+    uint64_t header = nptn;
+    out->write(PTNLH_MAGIC, PTNLH_MAGIC_SIZE);
+    out->write((char*)&header, sizeof(header));
+}
+
+void PatternLhMatrix::addTree(int tree_id, double logl, double *pattern_lh) {
+    ASSERT(out);
+    int32_t id = tree_id;
+    out->write((char*)&id, sizeof(id));
+    out->write((char*)&logl, sizeof(logl));
+    out->write((char*)pattern_lh, nptn * sizeof(double));
+    if (out->fail())
+        outError(ERR_WRITE_OUTPUT, filename);
+    ntrees++;
+}
+
+void PatternLhMatrix::open(string file_name) {
+    close();
+    filename = file_name;
+    in = new igzstream(filename.c_str());
+    char magic[PTNLH_MAGIC_SIZE];
+    uint64_t header = 0;
+    if (!in->fail())
+        in->read(magic, PTNLH_MAGIC_SIZE);
+    if (!in->fail())
+        in->read((char*)&header, sizeof(header));
+    if (in->fail() || memcmp(magic, PTNLH_MAGIC, PTNLH_MAGIC_SIZE) != 0)
+        outError(ERR_READ_INPUT, filename);
+    nptn = header;
+}
+
+size_t PatternLhMatrix::readTrees(size_t max_trees, double *pattern_lhs, size_t lh_stride, int *tree_ids, double *logls) {
+    ASSERT(in && lh_stride >= nptn);
+    size_t num = 0;
+    for (; num < max_trees; num++) {
+        int32_t id;
+        double logl;
+        double *pattern_lh = pattern_lhs + num*lh_stride;
+        in->read((char*)&id, sizeof(id));
+        if (in->eof() && in->gcount() == 0)
+            break;
+        in->read((char*)&logl, sizeof(logl));
+        in->read((char*)pattern_lh, nptn * sizeof(double));
+        if (in->fail())
+            outError("Truncated pattern log-likelihood file ", filename);
+        memset(pattern_lh + nptn, 0, (lh_stride - nptn) * sizeof(double));
+        tree_ids[num] = id;
+        if (logls)
+            logls[num] = logl;
+    }
+    return num;
+}
+
+void PatternLhMatrix::rewind() {
+    ASSERT(in);
+    open(filename);
+}
+
+void PatternLhMatrix::close() {
+    if (out) {
+        out->close();
+        delete out;
+        out = NULL;
+    }
+    if (in) {
+        in->close();
+        delete in;
+        in = NULL;
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * patternlhmatrix.h
+ * Streamed storage of pattern log-likelihoods for tree topology tests
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef PATTERNLHMATRIX_H
+#define PATTERNLHMATRIX_H
+
+#include "tools.h"
+#include "gzstream.h"
+
+/**
+    pattern log-likelihoods of many trees in a gzip-compressed binary file (--test-stream).
+    Trees are appended one after another and read back in blocks, so that the tree
+    topology tests never keep the whole #trees x #patterns matrix in memory.
+    Layout: magic "IQPTNLH1", uint64 #patterns, then for every tree
+    int32 tree ID, double log-likelihood and #patterns doubles.
+*/
+class PatternLhMatrix {
+public:
+
+    PatternLhMatrix();
+
+    ~PatternLhMatrix();
+
+    /**
+        create the file for writing
+        @param file_name file name
+        @param num_patterns number of patterns per tree
+    */
+    void create(string file_name, size_t num_patterns);
+
+    /**
+        append the pattern log-likelihoods of a tree
+        @param tree_id tree ID
+        @param logl log-likelihood of the tree
+        @param pattern_lh pattern log-likelihoods of size getNPattern()
+    */
+    void addTree(int tree_id, double logl, double *pattern_lh);
+
+    /**
+        open an existing file for reading
+        @param file_name file name
+    */
+    void open(string file_name);
+
+    /**
+        read the next trees
+        @param max_trees maximal number of trees to read
+        @param[out] pattern_lhs pattern log-likelihoods, padded with zeros up to lh_stride
+        @param lh_stride distance between the pattern log-likelihoods of consecutive trees
+        @param[out] tree_ids tree IDs
+        @param[out] logls log-likelihoods of the trees, may be NULL
+        @return number of trees read, 0 at the end of the file
+    */
+    size_t readTrees(size_t max_trees, double *pattern_lhs, size_t lh_stride, int *tree_ids, double *logls);
+
+    /** start reading from the first tree again */
+    void rewind();
+
+    /** close the file */
+    void close();
+
+    /** @return number of patterns per tree */
+    size_t getNPattern() const { return nptn; }
+
+    /** @return number of trees written */
+    size_t getNTrees() const { return ntrees; }
+
+protected:
+
+    /** file name */
+    string filename;
+
+    /** number of patterns per tree */
+    size_t nptn;
+
+    /** number of trees written */
+    size_t ntrees;
+
+    /** output stream when writing */
+    ogzstream *out;
+
+    /** input stream when reading */
+    igzstream *in;
+
+};
+
+#endif // PATTERNLHMATRIX_H
@@ -0,0 +1,92 @@
+/*
+ * scratchmemory.cpp
+ * Memory backed by a memory-mapped scratch file
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "scratchmemory.h"
+#include "tools.h"
+
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__ && !defined WIN64
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SCRATCH_MMAP
+#endif
+
+namespace ScratchMemory {
+
+/** start address and size of all mapped regions */
+static std::map<const char*, size_t> mapped;
+static std::mutex mapped_mutex;
+
+void *allocate(const std::string &dir, size_t bytes) {
+#ifdef SCRATCH_MMAP
+    if (bytes == 0)
+        bytes = 1;
+    std::string templ = dir + "/iqtree_scratch_XXXXXX";
+    std::vector<char> name(templ.begin(), templ.end());
+    name.push_back(0);
+    int fd = mkstemp(name.data());
+    if (fd < 0)
+        outError("Cannot create scratch file in " + dir + ": " + strerror(errno));
+    // file is removed as soon as it is unmapped
+    unlink(name.data());
+    if (ftruncate(fd, bytes) != 0) {
+        int err = errno;
+        close(fd);
+        outError("Cannot resize scratch file to " + convertInt64ToString(bytes) + " bytes: " + strerror(err));
+    }
+    void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (mem == MAP_FAILED)
+        outError("Cannot map scratch file of " + convertInt64ToString(bytes) + " bytes: " + strerror(err));
+    std::lock_guard<std::mutex> guard(mapped_mutex);
+    mapped[(const char*)mem] = bytes;
+    return mem;
+#else
+    outError("--lh-mmap is not supported on this platform");
+    return NULL;
+#endif
+}
+
+bool release(void *mem) {
+#ifdef SCRATCH_MMAP
+    if (!mem)
+        return false;
+    size_t bytes;
+    {
+        std::lock_guard<std::mutex> guard(mapped_mutex);
+        auto it = mapped.find((const char*)mem);
+        if (it == mapped.end())
+            return false;
+        bytes = it->second;
+        mapped.erase(it);
+    }
+    munmap(mem, bytes);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void prefetch(const void *mem, size_t bytes) {
+#ifdef SCRATCH_MMAP
+    if (!mem || bytes == 0)
+        return;
+    // madvise requires a page-aligned start address
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t start = (size_t)mem & ~(page_size-1);
+    size_t end = (size_t)mem + bytes;
+    madvise((void*)start, end - start, MADV_WILLNEED);
+#endif
+}
+
+}
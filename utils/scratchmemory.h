@@ -0,0 +1,41 @@
+/*
+ * scratchmemory.h
+ * Memory backed by a memory-mapped scratch file
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef SCRATCHMEMORY_H
+#define SCRATCHMEMORY_H
+
+#include <cstddef>
+#include <string>
+
+/**
+    memory backed by a memory-mapped scratch file (--lh-mmap).
+    The operating system keeps recently used pages in RAM and writes cold
+    pages back to the file, so buffers larger than RAM can be allocated.
+    The file is unlinked right after creation and disappears when unmapped.
+*/
+namespace ScratchMemory {
+
+    /**
+        map a new scratch file
+        @param dir directory for the scratch file, should be on a fast local disk
+        @param bytes size in bytes
+        @return page-aligned memory, outError() on failure
+    */
+    void *allocate(const std::string &dir, size_t bytes);
+
+    /**
+        unmap memory returned by allocate()
+        @return false if mem was not allocated by allocate()
+    */
+    bool release(void *mem);
+
+    /** ask the operating system to read a range of mapped memory in advance */
+    void prefetch(const void *mem, size_t bytes);
+
+}
+
+#endif // SCRATCHMEMORY_H
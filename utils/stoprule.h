@@ -114,6 +114,11 @@ public:
         should_stop = true;
     }
 
+    /** @return TRUE if shouldStop() was called */
+    bool isStopped() const {
+        return should_stop;
+    }
+
 private:
 
     /**
@@ -284,6 +284,26 @@ __inline uint64_t getMemorySize( )
 #endif
 }
 
+/**
+ * Returns the size of the L2 cache of one core in bytes, 256 KB if it cannot be detected.
+ */
+__inline uint64_t getCacheSize( )
+{
+	int64_t size = 0;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+	/* Linux. --------------------------------------------------- */
+	size = sysconf( _SC_LEVEL2_CACHE_SIZE );
+#elif defined(__APPLE__) && defined(__MACH__) && defined(CTL_HW)
+	/* OSX. ----------------------------------------------------- */
+	size_t len = sizeof( size );
+	if ( sysctlbyname( "hw.l2cachesize", &size, &len, NULL, 0 ) != 0 )
+		size = 0;
+#endif
+	if ( size <= 0 )
+		size = 262144;
+	return (uint64_t)size;
+}
+
 
 #define HOW_LONG(x) \
 { std::cout.precision(6); double startTime = getRealTime(); \
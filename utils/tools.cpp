@@ -1097,6 +1097,7 @@ void parseArg(int argc, char *argv[], Params &params) {
 
     params.aln_file = NULL;
     params.phylip_sequential_format = false;
+    params.aln_cache = false;
     params.symtest = SYMTEST_NONE;
     params.symtest_only = false;
     params.symtest_remove = 0;
@@ -1110,6 +1111,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.topotest_optimize_model = false;
     params.do_weighted_test = false;
     params.do_au_test = false;
+    params.topotest_stream = false;
     params.siteLL_file = NULL; //added by MA
     params.partition_file = NULL;
     params.partition_type = BRLEN_OPTIMIZE;
@@ -1140,6 +1142,9 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.numSmoothTree = 1;
     params.nni5 = true;
     params.nni5_num_eval = 1;
+    params.nni_num_threads = 0;
+    params.init_tree_workers = 0;
+    params.mpi_async = false;
     params.brlen_num_traversal = 1;
     params.leastSquareBranch = false;
     params.pars_branch_length = false;
@@ -1221,6 +1226,11 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.lk_safe_scaling = false;
     params.numseq_safe_scaling = 2000;
     params.kernel_nonrev = false;
+    params.kernel_generic = false;
+    params.bench_kernels = false;
+    params.bench_trees = false;
+    params.bench_aln = false;
+    params.bench_kernel_reps = 100;
     params.print_site_lh = WSL_NONE;
     params.print_partition_lh = false;
     params.print_site_prob = WSL_NONE;
@@ -1344,6 +1354,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 	params.print_branch_lengths = false;
 	params.lh_mem_save = LM_PER_NODE; // auto detect
     params.buffer_mem_save = false;
+    params.lh_float = false;
+    params.lh_mmap_dir = NULL;
+    params.lh_tile_size = -1;
+    params.trans_cache_size = 0;
 	params.start_tree = STT_PLL_PARSIMONY;
     params.start_tree_subtype_name = StartTree::Factory::getNameOfDefaultTreeBuilder();
 
@@ -1370,6 +1384,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.checkpoint_dump_interval = 60;
     params.force_unfinished = false;
     params.print_all_checkpoints = false;
+    params.checkpoint_journal = true;
+    params.checkpoint_binary = false;
     params.suppress_output_flags = 0;
     params.ufboot2corr = false;
     params.u2c_nni5 = false;
@@ -2254,6 +2270,10 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.phylip_sequential_format = true;
                 continue;
             }
+            if (strcmp(argv[cnt], "--aln-cache") == 0) {
+                params.aln_cache = true;
+                continue;
+            }
             if (strcmp(argv[cnt], "--symtest") == 0) {
                 params.symtest = SYMTEST_MAXDIV;
                 continue;
@@ -2366,6 +2386,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.do_au_test = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "--test-stream") == 0) {
+				params.topotest_stream = true;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-sp") == 0 || strcmp(argv[cnt], "-Q") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -3292,6 +3316,38 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--kernel-generic") == 0) {
+                params.kernel_generic = true;
+                // generic kernels are only available with safe scaling
+                params.lk_safe_scaling = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--bench-kernels") == 0) {
+                params.bench_kernels = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--bench-trees") == 0) {
+                params.bench_trees = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--bench-aln") == 0) {
+                params.bench_aln = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--bench-reps") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --bench-reps <number of traversals>";
+                params.bench_kernel_reps = convert_int(argv[cnt]);
+                if (params.bench_kernel_reps < 1)
+                    throw "--bench-reps must be positive";
+                continue;
+            }
+
 			if (strcmp(argv[cnt], "-f") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -4190,6 +4246,39 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.buffer_mem_save = false;
                 continue;
             }
+            if (strcmp(argv[cnt], "--lh-float") == 0) {
+                params.lh_float = true;
+                continue;
+            }
+            if (strcmp(argv[cnt], "--lh-mmap") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --lh-mmap <scratch_directory>";
+                params.lh_mmap_dir = argv[cnt];
+                continue;
+            }
+            if (strcmp(argv[cnt], "--lh-tile") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --lh-tile AUTO|<number of patterns>";
+                if (strcmp(argv[cnt], "AUTO") == 0)
+                    params.lh_tile_size = -1;
+                else {
+                    params.lh_tile_size = convert_int(argv[cnt]);
+                    if (params.lh_tile_size < 0)
+                        throw "--lh-tile must be AUTO or non-negative";
+                }
+                continue;
+            }
+            if (strcmp(argv[cnt], "--trans-cache") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --trans-cache <memory in MB>";
+                params.trans_cache_size = convert_int(argv[cnt]);
+                if (params.trans_cache_size < 0)
+                    throw "--trans-cache must be non-negative";
+                continue;
+            }
 //			if (strcmp(argv[cnt], "-storetrees") == 0) {
 //				params.store_candidate_trees = true;
 //				continue;
@@ -4496,6 +4585,35 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--nni-threads") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use --nni-threads <num_threads|AUTO>";
+                if (strcmp(argv[cnt], "AUTO") == 0)
+                    params.nni_num_threads = -1;
+                else {
+                    params.nni_num_threads = convert_int(argv[cnt]);
+                    if (params.nni_num_threads < 1)
+                        throw "Positive --nni-threads expected";
+                }
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--init-workers") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use --init-workers <num_workers>";
+                params.init_tree_workers = convert_int(argv[cnt]);
+                if (params.init_tree_workers < 0)
+                    throw "Non-negative --init-workers expected";
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--mpi-async") == 0) {
+                params.mpi_async = true;
+                continue;
+            }
+
             if (strcmp(argv[cnt], "-bl-eval") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -5061,6 +5179,16 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.print_all_checkpoints = true;
                 continue;
             }
+
+            if (strcmp(argv[cnt], "--no-ckp-journal") == 0) {
+                params.checkpoint_journal = false;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--ckp-binary") == 0) {
+                params.checkpoint_binary = true;
+                continue;
+            }
             
 			if (strcmp(argv[cnt], "--no-log") == 0) {
 				params.suppress_output_flags |= OUT_LOG;
@@ -5409,6 +5537,9 @@ void parseArg(int argc, char *argv[], Params &params) {
     
     if (params.do_au_test && params.topotest_replicates == 0)
         outError("For AU test please specify number of bootstrap replicates via -zb option");
+
+    if (params.do_weighted_test && params.topotest_stream)
+        outError("Weighted KH and SH tests (-zw) need variances of all tree pairs and are not supported with --test-stream");
     
     if (params.lh_mem_save == LM_MEM_SAVE && params.partition_file)
         outError("-mem option does not work with partition models yet");
@@ -5650,12 +5781,17 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  -s FILE[,...,FILE]   PHYLIP/FASTA/NEXUS/CLUSTAL/MSF alignment file(s)" << endl
     << "  -s DIR               Directory of alignment files" << endl
     << "  --seqtype STRING     BIN, DNA, AA, NT2AA, CODON, MORPH (default: auto-detect)" << endl
+    << "  --aln-cache          Load alignment from binary cache FILE.alncache, create it if needed" << endl
     << "  -t FILE|PARS|RAND    Starting tree (default: 99 parsimony and BIONJ)" << endl
     << "  -o TAX[,...,TAX]     Outgroup taxon (list) for writing .treefile" << endl
     << "  --prefix STRING      Prefix for all output files (default: aln/partition)" << endl
     << "  --seed NUM           Random seed number, normally used for debugging purpose" << endl
     << "  --safe               Safe likelihood kernel to avoid numerical underflow" << endl
     << "  --mem NUM[G|M|%]     Maximal RAM usage in GB | MB | %" << endl
+    << "  --lh-float           Cache evicted likelihood vectors in single precision to save RAM (with --mem)" << endl
+    << "  --lh-mmap DIR        Store likelihood vectors in a memory-mapped scratch file in DIR" << endl
+    << "  --lh-tile AUTO|NUM   Patterns per cache tile of likelihood traversal, 0 to disable (default: AUTO)" << endl
+    << "  --trans-cache NUM    MB per tree to cache transition terms of unchanged branches (default: 0, off)" << endl
     << "  --runs NUM           Number of indepedent runs (default: 1)" << endl
     << "  -v, --verbose        Verbose mode, printing more messages to screen" << endl
     << "  -V, --version        Display version number" << endl
@@ -5665,12 +5801,20 @@ void usage_iqtree(char* argv[], bool full_command) {
 #ifdef _OPENMP
     << "  -T NUM|AUTO          No. cores/threads or AUTO-detect (default: 1)" << endl
     << "  --threads-max NUM    Max number of threads for -T AUTO (default: all cores)" << endl
+    << "  --nni-threads NUM    No. threads for NNI evaluation or AUTO to measure (default: -T)" << endl
+    << "  --init-workers NUM   No. trees scored and NNI-polished concurrently in the" << endl
+    << "                       initial phase, each with one thread (default: 0, off)" << endl
+#endif
+#ifdef _IQTREE_MPI
+    << "  --mpi-async          Exchange trees between MPI processes without blocking" << endl
 #endif
     << endl << "CHECKPOINT:" << endl
     << "  --redo               Redo both ModelFinder and tree search" << endl
     << "  --redo-tree          Restore ModelFinder and only redo tree search" << endl
     << "  --undo               Revoke finished run, used when changing some options" << endl
     << "  --cptime NUM         Minimum checkpoint interval (default: 60 sec and adapt)" << endl
+    << "  --no-ckp-journal     Rewrite checkpoint file on every dump instead of journaling" << endl
+    << "  --ckp-binary         Write checkpoint in binary format for faster restart" << endl
     << endl << "PARTITION MODEL:" << endl
     << "  -p FILE|DIR          NEXUS/RAxML partition file or directory with alignments" << endl
     << "                       Edge-linked proportional partition model" << endl
@@ -5853,6 +5997,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --test NUM           Replicates for topology test" << endl
     << "  --test-weight        Perform weighted KH and SH tests" << endl
     << "  --test-au            Approximately unbiased (AU) test (Shimodaira 2002)" << endl
+    << "  --test-stream        Evaluate trees in a pipeline, tests run out-of-core (not with -zw)" << endl
     << "  --sitelh             Write site log-likelihoods to .sitelh file" << endl
 
     << endl << "ANCESTRAL STATE RECONSTRUCTION:" << endl
@@ -5966,6 +6111,11 @@ void usage_iqtree(char* argv[], bool full_command) {
         << "  --partlh             Write partition log-likelihoods to .partlh file" << endl
         << "  --no-outfiles        Suppress printing output files" << endl
         << "  --eigenlib           Use Eigen3 library" << endl
+        << "  --kernel-generic     Use generic instead of fixed-state likelihood kernels" << endl
+        << "  --bench-kernels      Benchmark likelihood kernels on the initial tree, write .kernels.json and exit" << endl
+        << "  --bench-trees        Compare newick and binary encoding of the initial tree and exit" << endl
+        << "  --bench-aln          Benchmark loading, bootstrap resampling and tip access of the alignment and exit" << endl
+        << "  --bench-reps NUM     No. calls per kernel, tree or alignment operation (default: 100)" << endl
         << "  -alninfo             Print alignment sites statistics to .alninfo" << endl
     //            << "  -d <file>            Reading genetic distances from file (default: JC)" << endl
     //			<< "  -d <outfile>         Calculate the distance matrix inferred from tree" << endl
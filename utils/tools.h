@@ -776,6 +776,23 @@ public:
 	 */
 	int nni5_num_eval;
 
+	/**
+	 *  Number of threads for evaluating NNIs, 0 to use all threads, -1 to measure the fastest
+	 */
+	int nni_num_threads;
+
+	/**
+	 *  Number of tree-private workers scoring and NNI-polishing the initial trees concurrently,
+	 *  0 to process them one after another with all threads (default)
+	 */
+	int init_tree_workers;
+
+	/**
+	 *  TRUE to exchange candidate trees between MPI processes with non-blocking messages
+	 *  and a hierarchical gather, default: FALSE
+	 */
+	bool mpi_async;
+
 	/**
 	 *  Number of traversal for all branch lengths optimization of the initial tree 
 	 */
@@ -898,6 +915,9 @@ public:
     /** true if sequential phylip format is used, default: false (interleaved format) */
     bool phylip_sequential_format;
 
+    /** TRUE to load the alignment from a binary cache next to the alignment file, writing it if missing or stale */
+    bool aln_cache;
+
     /**
      SYMTEST_NONE to not perform test of symmetry of Jermiin et al. (default)
      SYMTEST_MAXDIV to perform symmetry test on the pair with maximum divergence
@@ -952,6 +972,10 @@ public:
     /** true to do the approximately unbiased (AU) test */
     bool do_au_test;
 
+    /** true to evaluate user trees in a multithreaded pipeline and run the tests
+        out-of-core on the pattern log-likelihood matrix written to disk */
+    bool topotest_stream;
+
     /**
             file specifying partition model
      */
@@ -1840,6 +1864,21 @@ public:
     /** TRUE to force using non-reversible likelihood kernel */
     bool kernel_nonrev;
 
+    /** TRUE to force using the generic likelihood kernel instead of the fixed-state kernels */
+    bool kernel_generic;
+
+    /** TRUE to benchmark the likelihood kernels on the initial tree and exit */
+    bool bench_kernels;
+
+    /** TRUE to compare newick and binary encoding of the initial tree and exit */
+    bool bench_trees;
+
+    /** number of calls per kernel for --bench-kernels or per tree for --bench-trees, default: 100 */
+    int bench_kernel_reps;
+
+    /** TRUE to benchmark loading, bootstrap resampling and tip access of the alignment and exit */
+    bool bench_aln;
+
     /**
      	 	WSL_NONE: do not print anything
             WSL_SITE: print site log-likelihood
@@ -2252,6 +2291,19 @@ public:
     /** true to save buffer, default: false */
     bool buffer_mem_save;
 
+    /** true to cache evicted partial likelihood vectors in single precision with -mem to save memory,
+        the kernels still compute in double, default: false */
+    bool lh_float;
+
+    /** directory of a memory-mapped scratch file for partial likelihood vectors, default: NULL (RAM) */
+    char *lh_mmap_dir;
+
+    /** number of patterns per tile of the partial likelihood traversal, 0 for no tiling, -1 for auto */
+    int lh_tile_size;
+
+    /** memory in MB per tree for caching transition terms of branches, 0 (default) to disable */
+    int trans_cache_size;
+
     /** maximum size of memory allowed to use */
     double max_mem_size;
 
@@ -2303,6 +2355,12 @@ public:
     /** TRUE to print checkpoints to 1.ckp.gz, 2.ckp.gz,... */
     bool print_all_checkpoints;
 
+    /** TRUE (default) to append changed keys to a checkpoint journal instead of rewriting the checkpoint file */
+    bool checkpoint_journal;
+
+    /** TRUE to write checkpoint files in the binary indexed format, which is loaded without parsing */
+    bool checkpoint_binary;
+
     /** control output files to be written
      * OUT_LOG
      * OUT_TREEFILE